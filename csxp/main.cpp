@@ -18,32 +18,43 @@ void dump(csxp::patom a, int indent = 0)
 {
     std::string dent(indent, ' ');
 
-    std::visit(
-            [ indent, &dent ](auto&& val) -> auto {
+    if (a.is_num()) {
+        fmt::print("{} num {}\n", dent, a.num());
+        return;
+    } else if (a.is_char()) {
+        fmt::print("{} char\n", dent);
+        return;
+    } else if (!a.is_heap()) {
+        fmt::print("{} const\n", dent);
+        return;
+    }
+
+    csxp::visit_if(
+            [indent, &dent](auto&& val) {
                 using T = std::decay_t<decltype(val)>;
 
-                if constexpr (std::is_same_v<T, std::monostate>) {
-                    // noop
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Callable>>) {
+                if constexpr (std::is_same_v<T, csxp::ref<csxp::Callable>>) {
                     fmt::print("{} callable\n", dent);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Char>>) {
-                    fmt::print("{} char\n", dent);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Const>>) {
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Const>>) {
                     fmt::print("{} const\n", dent);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Keyword>>) {
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Keyword>>) {
                     fmt::print("{} keyword\n", dent);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Num>>) {
-                    fmt::print("{} num {}\n", dent, val->val);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Str>>) {
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Local>>) {
+                    fmt::print("{} local\n", dent);
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Node>>) {
+                    fmt::print("{} node\n", dent);
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Str>>) {
                     fmt::print("{} str\n", dent);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::SymName>>) {
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::SymName>>) {
                     fmt::print("{} sym\n", dent);
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Seq>>) {
-                    if (auto m = std::dynamic_pointer_cast<csxp::Map>(val)) {
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Var>>) {
+                    fmt::print("{} var\n", dent);
+                } else if constexpr (std::is_same_v<T, csxp::ref<csxp::Seq>>) {
+                    if (csxp::seq_cast<csxp::Map>(val.get())) {
                         fmt::print("{} map\n", dent);
-                    } else if (auto l = std::dynamic_pointer_cast<csxp::List>(val)) {
+                    } else if (csxp::seq_cast<csxp::List>(val.get())) {
                         fmt::print("{} lst\n", dent);
-                    } else if (auto v = std::dynamic_pointer_cast<csxp::Vec>(val)) {
+                    } else if (csxp::seq_cast<csxp::Vec>(val.get())) {
                         fmt::print("{} vec\n", dent);
                     } else {
                         // todo: add type to msg
@@ -60,7 +71,7 @@ void dump(csxp::patom a, int indent = 0)
                     throw std::runtime_error("unexpected type in atom formatter");
                 }
             },
-            a->p);
+            a);
 }
 
 auto usage = R"(
@@ -68,6 +79,7 @@ Usage: csxp [options] [-- args]
   -e, --exec FILE       run specific file
   -h, --help            show help
   -v, --version         show version and exit
+      --vm              run on the bytecode vm
 )"sv;
 
 static void exit_version()
@@ -103,11 +115,13 @@ int main(int argc, char* argv[])
     std::string_view exec_path;
     bool show_version = false;
     bool run_tests = false;
+    bool use_vm = false;
 
     auto p = rw::argparse::parser{};
     p.one_of(false)
         .optional(&exec_path, "exec"sv, "e"sv)
         .optional(&run_tests, "test"sv)
+        .optional(&use_vm, "vm"sv)
         .optional(&show_version, "version"sv, "v"sv);
     p.usage(usage);
     auto o = p.parse(argc, argv);
@@ -125,7 +139,7 @@ int main(int argc, char* argv[])
             try {
                 if (run_tests) {
                     // set up basic env
-                    auto env = csxp::createEnv();
+                    auto env = csxp::createEnv(use_vm ? csxp::Engine::vm : csxp::Engine::tree);
                     csxp::lib::addCore(env.get());
                     csxp::lib::addEnv(env.get());
                     csxp::lib::addMath(env.get());
@@ -138,7 +152,7 @@ int main(int argc, char* argv[])
                     }
                 } else {
                     for (auto val : csxp::reader(*str, exec_path)) {
-                        fmt::print("{}\n", *val);
+                        fmt::print("{}\n", val);
                         dump(val);
                     }
                 }
@@ -1,7 +1,21 @@
 #ifndef CSXP_ATOM_H
 #define CSXP_ATOM_H
 
-#include "rw/pdata/map.h"
+#include "csxp/phashmap.h"
+#include "csxp/plist.h"
+#include "csxp/pvector.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
 
 namespace csxp {
 
@@ -15,78 +29,443 @@ struct Callable;
 struct Char;
 struct Const;
 struct Keyword;
-struct List; // not in variant_type
-struct Map;  // not in variant_type
+struct List;
+struct Local;
+struct Map;
+struct Node;
 struct Num;
 struct Seq;
 struct Str;
 struct SymName;
-struct Vec; // not in variant_type
+struct Transient;
+struct Var;
+struct Vec;
+
+// reference counts are atomic unless the library is built for
+// envs that are confined to a single thread (see meson_options.txt)
+#ifdef CSXP_NONATOMIC_REFCOUNT
+using refcount_type = std::uint32_t;
+#else
+using refcount_type = std::atomic<std::uint32_t>;
+#endif
+
+// the same goes for the hashes that strs and collections keep once
+// they're worked out (see hash)
+#ifdef CSXP_NONATOMIC_REFCOUNT
+using hash_cache_type = std::size_t;
+#else
+using hash_cache_type = std::atomic<std::size_t>;
+#endif
+
+// base for everything that lives on the heap: strings, symbols,
+// keywords, collections and callables. carries its own reference
+// count, so a patom or ref points straight at the value, with no
+// separate control block. note that list, vec, and map share the
+// seq type; they need to be casted from seq to their specific types.
+struct Object
+{
+    enum class type : std::uint8_t
+    {
+        callable,
+        konst,
+        keyword,
+        local,
+        node,
+        seq,
+        str,
+        symname,
+        transient,
+        var,
+    };
 
-// todo; nest in atom?
-// note that list, vec, and map are not in the variant; they need to be
-// casted from seq to their specific types.
-using variant_type = std::variant<
-        std::monostate,
-        std::shared_ptr<Callable>,
-        std::shared_ptr<Char>,
-        std::shared_ptr<Const>,
-        std::shared_ptr<Keyword>,
-        std::shared_ptr<Num>,
-        std::shared_ptr<Seq>,
-        std::shared_ptr<Str>,
-        std::shared_ptr<SymName>>;
+    explicit Object(type objtype) :
+        objtype(objtype) {}
+    Object(const Object& other) = delete;
+    Object& operator=(const Object& other) = delete;
 
-struct atom
-{
-    // todo: using shared_ptr seems lazy...unique_ptr may be a better fit
+    void retain() const noexcept
+    {
+        if (pinned) {
+            return;
+        }
+#ifdef CSXP_NONATOMIC_REFCOUNT
+        ++refs;
+#else
+        refs.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    // drops a reference, destroying the object if it was the last one
+    void release() const noexcept
+    {
+        if (pinned) {
+            return;
+        }
+#ifdef CSXP_NONATOMIC_REFCOUNT
+        if (--refs == 0) {
+            destroy(this);
+        }
+#else
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            destroy(this);
+        }
+#endif
+    }
 
+    // stops counting references, so the object is never freed. for
+    // interned objects, which live as long as the program and are
+    // shared by every env, whatever thread it's on: their counts would
+    // be contended, and racy if counts aren't atomic. only to be called
+    // before the object is shared.
+    void pin() noexcept { pinned = true; }
 
-    atom() = default;
-    atom(variant_type v);
-    atom(const atom& other);
-    atom(atom&& other) noexcept;
+    // the number of references to it, for tests. only exact while no
+    // other thread is changing it, and 0 once pinned.
+    std::uint32_t use_count() const noexcept { return refs; }
 
-    atom& operator=(const atom& other);
-    atom& operator=(atom&& other) noexcept;
+    const type objtype;
 
-    variant_type p;
-};
+protected:
+    // not virtual; destroy deletes through the concrete type
+    ~Object() = default;
 
-bool operator==(const atom& lhs, const atom& rhs);
-bool operator!=(const atom& lhs, const atom& rhs);
+private:
+    static void destroy(const Object* obj) noexcept;
 
-using patom = std::shared_ptr<atom>;
+    bool pinned = false;
+    mutable refcount_type refs{0};
+};
 
+// intrusive reference to a heap object
 template <typename T>
-bool atom_vals_eq(const T& a, const T& b)
+class ref
 {
-    if (!a != !b) {
-        // one is null, other not null
-        return false;
+public:
+    using element_type = T;
+
+    constexpr ref() noexcept = default;
+    constexpr ref(std::nullptr_t) noexcept {}
+
+    // takes a new reference to p
+    explicit ref(T* p) noexcept :
+        p(p)
+    {
+        if (p) {
+            p->retain();
+        }
     }
 
-    if (a) {
-        // both not null, compare values
-        return *a == *b;
+    ref(const ref& other) noexcept :
+        ref(other.p) {}
+
+    ref(ref&& other) noexcept :
+        p(other.p)
+    {
+        other.p = nullptr;
     }
 
-    // both null
-    return true;
+    template <typename U,
+            typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    ref(const ref<U>& other) noexcept :
+        ref(other.get()) {}
+
+    template <typename U,
+            typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    ref(ref<U>&& other) noexcept :
+        p(other.detach()) {}
+
+    ~ref() { reset(); }
+
+    ref& operator=(ref other) noexcept
+    {
+        std::swap(p, other.p);
+        return *this;
+    }
+
+    void reset() noexcept
+    {
+        if (p) {
+            p->release();
+            p = nullptr;
+        }
+    }
+
+    // gives up the pointer without dropping the reference
+    T* detach() noexcept
+    {
+        auto res = p;
+        p = nullptr;
+        return res;
+    }
+
+    T* get() const noexcept { return p; }
+    T& operator*() const noexcept { return *p; }
+    T* operator->() const noexcept { return p; }
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+private:
+    T* p = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const ref<T>& lhs, const ref<U>& rhs)
+{
+    return lhs.get() == rhs.get();
+}
+
+template <typename T, typename U>
+bool operator!=(const ref<T>& lhs, const ref<U>& rhs)
+{
+    return lhs.get() != rhs.get();
+}
+
+template <typename T, typename... Args>
+ref<T> make_ref(Args&&... args)
+{
+    return ref<T>(new T(std::forward<Args>(args)...));
 }
 
+template <typename T, typename U>
+ref<T> dynamic_ref_cast(const ref<U>& r) noexcept
+{
+    return ref<T>(dynamic_cast<T*>(r.get()));
+}
+
+// tagged atom handle. the low two bits hold the tag; a zero tag is a
+// pointer to a heap object (or empty, if the whole thing is zero). nil,
+// true, false, Num and Char are immediates, with their value stored in
+// the upper 32 bits, so they never allocate or touch a refcount.
+class patom
+{
+public:
+    enum class tag : std::uint64_t
+    {
+        ptr = 0,
+        num = 1,
+        chr = 2,
+        special = 3,
+    };
+
+    constexpr patom() noexcept = default;
+    constexpr patom(std::nullptr_t) noexcept {}
+
+    // takes a new reference to a heap object
+    explicit patom(const Object* obj) noexcept :
+        bits(reinterpret_cast<std::uintptr_t>(obj))
+    {
+        assert((bits & tag_mask) == 0);
+        retain();
+    }
+
+    template <typename T>
+    patom(const ref<T>& r) noexcept :
+        patom(static_cast<const Object*>(r.get())) {}
+
+    patom(const patom& other) noexcept :
+        bits(other.bits)
+    {
+        retain();
+    }
+
+    patom(patom&& other) noexcept :
+        bits(other.bits)
+    {
+        other.bits = 0;
+    }
+
+    ~patom() { release(); }
+
+    patom& operator=(const patom& other) noexcept
+    {
+        patom tmp(other);
+        std::swap(bits, tmp.bits);
+        return *this;
+    }
+
+    patom& operator=(patom&& other) noexcept
+    {
+        std::swap(bits, other.bits);
+        return *this;
+    }
+
+    static patom make_num(int val) noexcept
+    {
+        return patom(imm(tag::num, static_cast<std::uint32_t>(val)));
+    }
+
+    static patom make_char(char32_t val) noexcept
+    {
+        return patom(imm(tag::chr, static_cast<std::uint32_t>(val)));
+    }
+
+    static patom make_nil() noexcept
+    {
+        return patom(special_nil);
+    }
+
+    static patom make_bool(bool val) noexcept
+    {
+        return patom(val ? special_true : special_false);
+    }
+
+    explicit operator bool() const noexcept { return bits != 0; }
+
+    void reset() noexcept
+    {
+        release();
+        bits = 0;
+    }
+
+    tag type() const noexcept { return static_cast<tag>(bits & tag_mask); }
+
+    bool is_heap() const noexcept { return bits && type() == tag::ptr; }
+    bool is_num() const noexcept { return type() == tag::num; }
+    bool is_char() const noexcept { return type() == tag::chr; }
+    bool is_nil() const noexcept { return bits == special_nil; }
+    bool is_true() const noexcept { return bits == special_true; }
+    bool is_false() const noexcept { return bits == special_false; }
+
+    // immediate values; only valid if the matching is_ check passes
+    int num() const noexcept
+    {
+        return static_cast<int>(static_cast<std::uint32_t>(bits >> 32));
+    }
+    char32_t chr() const noexcept
+    {
+        return static_cast<char32_t>(bits >> 32);
+    }
+
+    // heap object, or null if empty or an immediate
+    Object* get() const noexcept
+    {
+        return is_heap() ?
+                reinterpret_cast<Object*>(static_cast<std::uintptr_t>(bits)) :
+                nullptr;
+    }
+
+    // raw representation, identical for identical immediates or heap objects
+    std::uint64_t raw() const noexcept { return bits; }
+
+private:
+    static constexpr std::uint64_t tag_mask = 0x3;
+    static constexpr std::uint64_t special_nil =
+            static_cast<std::uint64_t>(tag::special);
+    static constexpr std::uint64_t special_true =
+            (std::uint64_t{1} << 32) | static_cast<std::uint64_t>(tag::special);
+    static constexpr std::uint64_t special_false =
+            (std::uint64_t{2} << 32) | static_cast<std::uint64_t>(tag::special);
+
+    static constexpr std::uint64_t imm(tag t, std::uint32_t val) noexcept
+    {
+        return (static_cast<std::uint64_t>(val) << 32) |
+               static_cast<std::uint64_t>(t);
+    }
+
+    constexpr explicit patom(std::uint64_t bits) noexcept :
+        bits(bits) {}
+
+    void retain() const noexcept
+    {
+        if (auto obj = get()) {
+            obj->retain();
+        }
+    }
+
+    void release() noexcept
+    {
+        if (auto obj = get()) {
+            obj->release();
+        }
+    }
+
+    std::uint64_t bits = 0;
+};
+
+static_assert(sizeof(patom) == sizeof(std::uint64_t));
+static_assert(alignof(Object) > 3, "patom tags need two free pointer bits");
+
+bool operator==(const patom& lhs, const patom& rhs);
+bool operator!=(const patom& lhs, const patom& rhs);
+
+// hash of a value, the same for any two values that are equal. lists
+// and vecs of equal items hash the same, and maps the same whatever
+// order their entries are in. strs and collections keep theirs, so
+// it's only worked out once.
+std::size_t hash(const patom& val);
+// hash of the bytes of a string (wyhash)
+std::size_t hashString(std::string_view str);
+
+struct AtomHash
+{
+    std::size_t operator()(const patom& val) const { return hash(val); }
+};
+
 struct AtomIterator
 {
     virtual ~AtomIterator() = default;
 
     virtual bool next() = 0;
     virtual patom value() const = 0;
+    // whether the values are args already evaluated, as when a callable
+    // is called with values (see Callable::call), rather than code
+    virtual bool evaluated() const { return false; }
+};
+
+// iterates over args in place, without allocating: evaluated args, or
+// code for the callable to evaluate, as for a call of a special
+// callable from analyzed code. like the seq iterators, it stays on the
+// last item once done.
+struct ValuesIterator : public AtomIterator
+{
+    ValuesIterator(const patom* args, std::size_t nargs, bool values = true) :
+        args(args), nargs(nargs), values(values) {}
+
+    bool next()
+    {
+        if (idx + 1 < nargs) {
+            idx++;
+            return true;
+        }
+
+        return false;
+    }
+
+    patom value() const
+    {
+        if (idx < nargs) {
+            return args[idx];
+        }
+
+        return {};
+    }
+
+    bool evaluated() const { return values; }
+
+    const patom* args;
+    std::size_t nargs;
+    bool values;
+    // wraps to 0 on the first next
+    std::size_t idx = static_cast<std::size_t>(-1);
 };
 
 struct SeqIt;
 
-struct Seq
+struct Seq : public Object
 {
+    static constexpr type object_type = type::seq;
+
+    // concrete collection behind the seq, so callers can dispatch
+    // without rtti. lazy and other computed seqs are just seqs.
+    enum class kind : std::uint8_t
+    {
+        seq,
+        list,
+        map,
+        vec,
+    };
+
+    explicit Seq(kind seqkind = kind::seq) :
+        Object(object_type), seqkind(seqkind) {}
     virtual ~Seq() = default;
 
     SeqIt begin();
@@ -96,6 +475,11 @@ struct Seq
     // lazy-seq need to store the result when next is called,
     // and other seqs want to retain the head
     virtual std::shared_ptr<AtomIterator> iterator() const = 0;
+
+    const kind seqkind;
+    // hash of a list, vec or map, which aren't changed once they're
+    // shared; 0 until it's worked out. other seqs don't keep theirs.
+    mutable hash_cache_type hashval{0};
 };
 
 inline bool operator==(const Seq& lhs, const Seq& rhs);
@@ -159,26 +543,99 @@ private:
     patom curr;
 };
 
-struct Callable
+// name shared by the interned types (consts, keywords and symbols).
+// the hash and the namespace split are worked out once, when the
+// name is interned, and never again.
+struct InternedName
+{
+    explicit InternedName(std::string_view name) :
+        name(name),
+        hash(hashString(name)),
+        slash(name.find('/'))
+    {
+        // a lone or trailing slash isn't a namespace separator
+        if (slash == 0 || slash == name.size() - 1) {
+            slash = std::string::npos;
+        }
+    }
+
+    // namespace of a qualified name like ns/name, or empty
+    std::string_view nspart() const noexcept
+    {
+        return slash == std::string::npos ?
+                std::string_view() :
+                std::string_view(name).substr(0, slash);
+    }
+
+    // name without its namespace
+    std::string_view basename() const noexcept
+    {
+        return slash == std::string::npos ?
+                std::string_view(name) :
+                std::string_view(name).substr(slash + 1);
+    }
+
+    std::string name;
+    std::size_t hash;
+    std::size_t slash;
+};
+
+struct Callable : public Object
 {
+    static constexpr type object_type = type::callable;
+
+    explicit Callable(bool special = true) :
+        Object(object_type), special(special) {}
     virtual ~Callable() = default;
 
+    // args are code, for the callable to evaluate (or not) itself
     virtual patom operator()(csxp::Env* env, AtomIterator* args) = 0;
+
+    // args are already evaluated. only for callables that aren't
+    // special; by default, it's operator() over a ValuesIterator.
+    virtual patom call(csxp::Env* env, const patom* args, std::size_t nargs)
+    {
+        ValuesIterator it(args, nargs);
+        return (*this)(env, &it);
+    }
+
+    // the function a builtin made by make_fn or make_callable calls, for
+    // call sites to call directly (see lib/detail/callcache.h); null for
+    // anything else
+    using Builtin = patom (*)(csxp::Env* env, AtomIterator* args);
+    virtual Builtin builtin() const { return nullptr; }
+
+    // drops its code and captured values, for an env being destroyed
+    // (see ~EnvImpl): code refers to vars, and caches the callables it
+    // calls, so a fn is often part of a reference cycle. it's not to be
+    // called after.
+    virtual void clear() {}
+
+    // whether its args must be passed as code, as for if, fn, and the
+    // like. other callables evaluate every arg, so callers may evaluate
+    // them first and use call.
+    const bool special;
+    // whether it gives the same value for the same args, with no side
+    // effects, so analysis may call it on constant args ahead of time
+    bool pure = false;
 };
 
-struct Const
+// consts, keywords and symbols are interned: create them with
+// intern or make_atom, and any two with the same name are the
+// same object, so equality is identity.
+struct Const : public Object, public InternedName
 {
+    static constexpr type object_type = type::konst;
+
     Const(std::string_view name) :
-        name(name) {}
+        Object(object_type), InternedName(name) {}
+
+    static ref<Const> intern(std::string_view name);
 
     // todo: should these makes be const?
     // todo: should this be a common template func?
-    static patom make_atom(std::string_view name)
-    {
-        return std::make_shared<atom>(std::make_shared<Const>(name));
-    }
-
-    std::string name;
+    // note: nil, true, and false give their immediates
+    static patom make_atom(std::string_view name);
 };
 
 bool operator==(const Const& lhs, const Const& rhs);
@@ -191,7 +648,7 @@ struct Char
 
     static patom make_atom(char32_t val)
     {
-        return std::make_shared<atom>(std::make_shared<Char>(val));
+        return patom::make_char(val);
     }
 
     char32_t val;
@@ -200,83 +657,175 @@ struct Char
 bool operator==(const Char& lhs, const Char& rhs);
 bool operator!=(const Char& lhs, const Char& rhs);
 
-struct Keyword
+struct Keyword : public Object, public InternedName
 {
+    static constexpr type object_type = type::keyword;
+
     Keyword(std::string_view name) :
-        name(name) {}
+        Object(object_type), InternedName(name) {}
+
+    static ref<Keyword> intern(std::string_view name);
 
     static patom make_atom(std::string_view name)
     {
-        return std::make_shared<atom>(std::make_shared<Keyword>(name));
+        return patom(intern(name));
     }
-
-    std::string name;
 };
 
 inline bool operator==(const Keyword& lhs, const Keyword& rhs)
 {
-    return lhs.name == rhs.name;
+    return &lhs == &rhs;
 }
 inline bool operator!=(const Keyword& lhs, const Keyword& rhs)
 {
     return !(lhs == rhs);
 }
 
-struct List : public Seq, std::enable_shared_from_this<List>
+struct List : public Seq
 {
-    List() = default;
+    static constexpr kind seq_kind = kind::list;
+
+    List() :
+        Seq(seq_kind) {}
     // todo: bench this vs const ref vs move
     List(const std::vector<patom>& items) :
-        items(items) {}
+        Seq(seq_kind), items(items) {}
     List(std::vector<patom>&& items) :
-        items(items) {}
+        Seq(seq_kind), items(std::move(items)) {}
+    List(plist<patom> items) :
+        Seq(seq_kind), items(std::move(items)) {}
 
     static patom make_atom()
     {
-        return std::make_shared<atom>(std::make_shared<List>());
+        return patom(make_ref<List>());
     }
 
     static patom make_atom(const std::vector<patom>& items)
     {
-        return std::make_shared<atom>(std::make_shared<List>(items));
+        return patom(make_ref<List>(items));
     }
 
     static patom make_atom(std::vector<patom>&& items)
     {
-        return std::make_shared<atom>(std::make_shared<List>(items));
+        return patom(make_ref<List>(std::move(items)));
     }
 
     std::shared_ptr<AtomIterator> iterator() const;
 
-    // cheating, I think
-    std::vector<patom> items;
+    // persistent, so the rest of a list, or a list consed onto it,
+    // shares its cells
+    plist<patom> items;
 };
 
-struct Map : public Seq, std::enable_shared_from_this<Map>
+// a local variable reference, resolved by analysis to its address:
+// slot indexes into the current frame or, if captured, into the values
+// the running fn captured from enclosing fns when it was created. also
+// used as a binding target. sym is kept for printing and error messages.
+struct Local : public Object
 {
-    Map() = default;
-    Map(std::vector<std::pair<patom, patom>>& pairs)
+    static constexpr type object_type = type::local;
+
+    // the type a local is declared with, as ^long. a hinted local is
+    // checked when it's bound, so it always holds a value of that type.
+    enum class hint : std::uint8_t
+    {
+        none,
+        long_,
+    };
+
+    Local(ref<SymName> sym, bool captured, std::uint32_t slot,
+            hint hinted = hint::none) :
+        Object(object_type),
+        sym(std::move(sym)),
+        captured(captured),
+        hinted(hinted),
+        slot(slot)
+    {}
+
+    static patom make_atom(ref<SymName> sym, bool captured, std::uint32_t slot,
+            hint hinted = hint::none)
     {
-        // todo:
-        //for (auto& item : items) {
-        //    items->assoc
-        //}
+        return patom(make_ref<Local>(std::move(sym), captured, slot, hinted));
     }
 
+    ref<SymName> sym;
+    bool captured;
+    hint hinted;
+    std::uint32_t slot;
+};
+
+// compiled code: a node of the tree the analyzer builds from a form.
+// evaluating it runs exec, so nodes can stand in for the forms they
+// were compiled from, e.g. as the (unevaluated) args of a callable.
+// form is the source, kept for printing.
+struct Node : public Object
+{
+    static constexpr type object_type = type::node;
+
+    // the analyzer's node types (see lib/detail/node.h), so compilers
+    // can walk the tree without rtti. node is for any other code.
+    enum class kind : std::uint8_t
+    {
+        node,
+        konst,
+        and_,
+        bind,
+        def,
+        do_,
+        fn,
+        fold,
+        hint,
+        if_,
+        invoke,
+        let,
+        loop,
+        or_,
+        prim,
+        recur,
+        selfcall,
+        map,
+        syntax_quote,
+        vec,
+    };
+
+    Node(kind nodekind, patom form) :
+        Object(object_type), nodekind(nodekind), form(std::move(form)) {}
+    virtual ~Node() = default;
+
+    virtual patom exec(csxp::Env* env) const = 0;
+
+    const kind nodekind;
+    patom form;
+};
+
+struct Map : public Seq
+{
+    static constexpr kind seq_kind = kind::map;
+
+    using items_type = phashmap<patom, patom, AtomHash>;
+
+    Map() :
+        Seq(seq_kind) {}
+    Map(const std::vector<std::pair<patom, patom>>& pairs) :
+        Seq(seq_kind), items(pairs.begin(), pairs.end()) {}
+    Map(items_type items) :
+        Seq(seq_kind), items(std::move(items)) {}
+
     static patom make_atom()
     {
-        return std::make_shared<atom>(std::make_shared<Map>());
+        return patom(make_ref<Map>());
     }
 
-    static patom make_atom(std::vector<std::pair<patom, patom>> items)
+    static patom make_atom(const std::vector<std::pair<patom, patom>>& pairs)
     {
-        return std::make_shared<atom>(std::make_shared<Map>(items));
+        return patom(make_ref<Map>(pairs));
     }
 
+    // iterates over the entries, each as a vec of key and value
     std::shared_ptr<AtomIterator> iterator() const;
 
-    std::shared_ptr<rw::pdata::map_base<patom, patom>> items =
-            std::make_shared<rw::pdata::persistent_map<patom, patom>>();
+    // persistent, so a changed copy shares most of its nodes
+    items_type items;
 };
 
 struct Num
@@ -286,7 +835,7 @@ struct Num
 
     static patom make_atom(int val)
     {
-        return std::make_shared<atom>(std::make_shared<Num>(val));
+        return patom::make_num(val);
     }
 
     int val;
@@ -295,223 +844,409 @@ struct Num
 bool operator==(const Num& lhs, const Num& rhs);
 bool operator!=(const Num& lhs, const Num& rhs);
 
-struct Str
+struct Str : public Object
 {
+    static constexpr type object_type = type::str;
+
     Str(std::string_view val) :
-        val(val) {}
+        Object(object_type), val(val) {}
 
     static patom make_atom(std::string_view val)
     {
-        return std::make_shared<atom>(std::make_shared<Str>(val));
+        return patom(make_ref<Str>(val));
     }
 
     std::string val;
+    // 0 until worked out, as for seqs
+    mutable hash_cache_type hashval{0};
 };
 
 bool operator==(const Str& lhs, const Str& rhs);
 bool operator!=(const Str& lhs, const Str& rhs);
 
-struct SymName
+struct SymName : public Object, public InternedName
 {
+    static constexpr type object_type = type::symname;
+
     SymName(std::string_view name) :
-        name(name) {}
+        Object(object_type), InternedName(name) {}
+
+    static ref<SymName> intern(std::string_view name);
 
     static patom make_atom(std::string_view name)
     {
-        return std::make_shared<atom>(std::make_shared<SymName>(name));
+        return patom(intern(name));
     }
 
-    std::string name;
+    // interned symbols for the namespace and base name, so envs can
+    // key on them. nssym is null for an unqualified symbol, whose
+    // basesym is itself.
+    const SymName* nssym = nullptr;
+    const SymName* basesym = this;
+    // the special form an unqualified symbol names, if any, as a
+    // lib::detail::special::form; set when it's interned
+    std::uint8_t special = 0;
 };
 
 bool operator==(const SymName& lhs, const SymName& rhs);
 bool operator!=(const SymName& lhs, const SymName& rhs);
 
-struct Vec : public Seq, std::enable_shared_from_this<Vec>
+// a vec or map being built in place by conj! and assoc!, until
+// persistent! hands its items over to a new vec or map. it starts out
+// sharing the nodes of the collection it was made from, and copies
+// each of them the first time it writes there; from then on only it
+// holds them, so they're updated in place, without copying. it's for
+// whoever made it, and isn't to be shared.
+struct Transient : public Object
 {
-    Vec() = default;
+    static constexpr type object_type = type::transient;
+
+    Transient(pvector<patom> vec) :
+        Object(object_type), collkind(Seq::kind::vec), vec(std::move(vec)) {}
+    Transient(Map::items_type map) :
+        Object(object_type), collkind(Seq::kind::map), map(std::move(map)) {}
+
+    // vec or map; only that one's items are used
+    const Seq::kind collkind;
+    pvector<patom> vec;
+    Map::items_type map;
+    // cleared by persistent!, after which it can't be used
+    bool editable = true;
+};
+
+// the cell behind a global. def and setInternal update val in place,
+// so code bound to the var sees redefinitions. val is empty while
+// the var is declared but not yet defined.
+struct Var : public Object
+{
+    static constexpr type object_type = type::var;
+
+    Var(ref<SymName> sym) :
+        Object(object_type), sym(std::move(sym)) {}
+
+    ref<SymName> sym;
+    patom val;
+    // set by defmacro: val is a fn called with the forms of a call to
+    // it, as they are, giving the form to use in its place
+    bool macro = false;
+};
+
+struct Vec : public Seq
+{
+    static constexpr kind seq_kind = kind::vec;
+
+    Vec() :
+        Seq(seq_kind) {}
     // todo: do for map
     Vec(const std::vector<patom>& items) :
-        items(items) {}
+        Seq(seq_kind), items(items) {}
     Vec(std::vector<patom>&& items) :
-        items(items) {}
+        Seq(seq_kind), items(std::move(items)) {}
+    Vec(pvector<patom> items) :
+        Seq(seq_kind), items(std::move(items)) {}
 
     static patom make_atom()
     {
-        return std::make_shared<atom>(std::make_shared<Vec>());
+        return patom(make_ref<Vec>());
     }
 
     static patom make_atom(const std::vector<patom>& items)
     {
-        return std::make_shared<atom>(std::make_shared<Vec>(items));
+        return patom(make_ref<Vec>(items));
     }
 
     static patom make_atom(std::vector<patom>&& items)
     {
-        return std::make_shared<atom>(std::make_shared<Vec>(items));
+        return patom(make_ref<Vec>(std::move(items)));
     }
 
     std::shared_ptr<AtomIterator> iterator() const;
 
-    std::vector<patom> items;
+    // persistent, so a changed copy shares most of its nodes
+    pvector<patom> items;
 };
 
-// get a value from a patom; throws bad_variant_access if wrong type or null
+// what get and get_if give back for a T. heap types are handed out as
+// refs, immediates by value.
 template <typename T>
-std::shared_ptr<T> get(patom atom)
+struct atom_traits
 {
-    if (atom) {
-        if (auto p = std::get<std::shared_ptr<T>>(atom->p)) {
-            return p;
-        }
+    using ref_type = ref<T>;
+};
+
+template <>
+struct atom_traits<Num>
+{
+    using ref_type = std::optional<Num>;
+};
+
+template <>
+struct atom_traits<Char>
+{
+    using ref_type = std::optional<Char>;
+};
+
+template <typename T>
+using atom_ref_t = typename atom_traits<T>::ref_type;
+
+// get a value from a patom; returns null if wrong type or null
+template <typename T>
+atom_ref_t<T> get_if(const patom& atom) noexcept
+{
+    if (auto obj = atom.get(); obj && obj->objtype == T::object_type) {
+        return ref<T>(static_cast<T*>(obj));
     }
-    throw std::bad_variant_access();
+    return {};
 }
 
-// get a value from a patom; throws bad_variant_access if wrong type or null.
-template <> std::shared_ptr<Map> get<Map>(patom atom);
-// get a value from a patom; throws bad_variant_access if wrong type or null.
-template <> std::shared_ptr<List> get<List>(patom atom);
-// get a value from a patom; throws bad_variant_access if wrong type or null.
-template <> std::shared_ptr<Vec> get<Vec>(patom atom);
+// get a value from a patom; returns empty if not a num
+template <>
+inline std::optional<Num> get_if<Num>(const patom& atom) noexcept
+{
+    if (atom.is_num()) {
+        return Num(atom.num());
+    }
+    return std::nullopt;
+}
 
-// get a value from a patom; returns null if wrong type or null
+// get a value from a patom; returns empty if not a char
+template <>
+inline std::optional<Char> get_if<Char>(const patom& atom) noexcept
+{
+    if (atom.is_char()) {
+        return Char(atom.chr());
+    }
+    return std::nullopt;
+}
+
+// casts a seq to a concrete collection by checking its kind;
+// returns null if the seq is something else
 template <typename T>
-std::shared_ptr<T> get_if(patom atom) noexcept
+T* seq_cast(Seq* seq) noexcept
 {
-    if (atom) {
-        if (auto p = std::get_if<std::shared_ptr<T>>(&atom->p)) {
-            return *p;
-        }
+    return seq && seq->seqkind == T::seq_kind ? static_cast<T*>(seq) : nullptr;
+}
+
+template <typename T>
+const T* seq_cast(const Seq* seq) noexcept
+{
+    return seq && seq->seqkind == T::seq_kind ? static_cast<const T*>(seq) : nullptr;
+}
+
+namespace detail {
+
+template <typename T>
+ref<T> get_seq_if(const patom& atom) noexcept
+{
+    if (auto obj = atom.get(); obj && obj->objtype == Object::type::seq) {
+        return ref<T>(seq_cast<T>(static_cast<Seq*>(obj)));
     }
     return {};
 }
 
+} // namespace detail
+
 // get a value from a patom; returns null if wrong type or null
-template <> std::shared_ptr<Map> get_if<Map>(patom atom) noexcept;
+template <>
+inline ref<Map> get_if<Map>(const patom& atom) noexcept
+{
+    return detail::get_seq_if<Map>(atom);
+}
+
 // get a value from a patom; returns null if wrong type or null
-template <> std::shared_ptr<List> get_if<List>(patom atom) noexcept;
+template <>
+inline ref<List> get_if<List>(const patom& atom) noexcept
+{
+    return detail::get_seq_if<List>(atom);
+}
+
 // get a value from a patom; returns null if wrong type or null
-template <> std::shared_ptr<Vec> get_if<Vec>(patom atom) noexcept;
+template <>
+inline ref<Vec> get_if<Vec>(const patom& atom) noexcept
+{
+    return detail::get_seq_if<Vec>(atom);
+}
+
+// get a value from a patom; throws bad_variant_access if wrong type or null
+template <typename T>
+atom_ref_t<T> get(const patom& atom)
+{
+    if (auto p = get_if<T>(atom)) {
+        return p;
+    }
+    throw std::bad_variant_access();
+}
 
 struct unexpected_atom_type {};
 
 // visits the supplied visitor if it is callable for whatever
 // type the atom contains. does not throw or error if the atom
 // contains something that cannot be passed to the visitor, unless
-// it contains some type unexpected by visit_if itself. Note that
-// a runtime cost is associated with Map, List, and Vec visitors
-// (as the Seq has to be dynamically casted to check whether
-// that's what the Seq is). to handle the case where the atom
-// contains something other than can be visited, have visitor accept
-// unexpected_atom_type.
+// it contains some type unexpected by visit_if itself. Num and Char
+// are passed by value, and nil, true and false are never visited.
+// Map, List, and Vec visitors are picked by the seq's kind; a seq
+// whose concrete type has no matching visitor is visited as a Seq.
+// to handle the case where the atom contains something other than
+// can be visited, have visitor accept unexpected_atom_type.
 template <typename Visitor>
-inline auto visit_if(Visitor&& vis, patom atom) -> auto {
-    std::visit(
-            [&vis](auto&& val) -> auto {
-                using T = std::decay_t<decltype(val)>;
-                using I = std::is_invocable<Visitor, decltype(val)>;
-                using U = std::is_invocable<Visitor, unexpected_atom_type>;
-
-                if constexpr (std::is_same_v<T, std::monostate>) {
-                    // noop
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Callable>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Char>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Const>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Keyword>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Num>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Str>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<SymName>>) {
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Seq>>) {
-                    if constexpr (std::is_invocable<Visitor, std::shared_ptr<Map>&&>::value) {
-                        if (auto m = std::dynamic_pointer_cast<Map>(val)) {
-                            return vis(std::move(m));
-                        }
-                    }
+inline auto visit_if(Visitor&& vis, const patom& atom) -> auto {
+    using U = std::is_invocable<Visitor, unexpected_atom_type>;
+
+    if (atom.is_num()) {
+        if constexpr (std::is_invocable<Visitor, Num>::value) {
+            vis(Num(atom.num()));
+        } else if constexpr (U::value) {
+            vis(unexpected_atom_type{});
+        }
+        return;
+    } else if (atom.is_char()) {
+        if constexpr (std::is_invocable<Visitor, Char>::value) {
+            vis(Char(atom.chr()));
+        } else if constexpr (U::value) {
+            vis(unexpected_atom_type{});
+        }
+        return;
+    }
 
-                    if constexpr (std::is_invocable<Visitor, std::shared_ptr<List>&&>::value) {
-                        if (auto l = std::dynamic_pointer_cast<List>(val)) {
-                            return vis(std::move(l));
-                        }
-                    }
+    auto obj = atom.get();
+    if (!obj) {
+        // empty, nil, true, or false
+        return;
+    }
 
-                    if constexpr (std::is_invocable<Visitor, std::shared_ptr<Vec>&&>::value) {
-                        if (auto v = std::dynamic_pointer_cast<Vec>(val)) {
-                            return vis(std::move(v));
-                        }
-                    }
+    auto visit = [&vis](auto&& val) {
+        using I = std::is_invocable<Visitor, decltype(val)>;
+        if constexpr (I::value) {
+            vis(std::move(val));
+        } else if constexpr (U::value) {
+            vis(unexpected_atom_type{});
+        }
+    };
 
-                    if constexpr (I::value) {
-                        return vis(val);
-                    } else if constexpr (U::value) {
-                        return vis(unexpected_atom_type{});
+    switch (obj->objtype) {
+        case Object::type::callable:
+            visit(ref<Callable>(static_cast<Callable*>(obj)));
+            break;
+        case Object::type::konst:
+            visit(ref<Const>(static_cast<Const*>(obj)));
+            break;
+        case Object::type::keyword:
+            visit(ref<Keyword>(static_cast<Keyword*>(obj)));
+            break;
+        case Object::type::local:
+            visit(ref<Local>(static_cast<Local*>(obj)));
+            break;
+        case Object::type::node:
+            visit(ref<Node>(static_cast<Node*>(obj)));
+            break;
+        case Object::type::str:
+            visit(ref<Str>(static_cast<Str*>(obj)));
+            break;
+        case Object::type::symname:
+            visit(ref<SymName>(static_cast<SymName*>(obj)));
+            break;
+        case Object::type::transient:
+            visit(ref<Transient>(static_cast<Transient*>(obj)));
+            break;
+        case Object::type::var:
+            visit(ref<Var>(static_cast<Var*>(obj)));
+            break;
+        case Object::type::seq: {
+            auto seq = static_cast<Seq*>(obj);
+            switch (seq->seqkind) {
+                case Seq::kind::map:
+                    if constexpr (std::is_invocable<Visitor, ref<Map>&&>::value) {
+                        vis(ref<Map>(static_cast<Map*>(seq)));
+                        return;
+                    }
+                    break;
+                case Seq::kind::list:
+                    if constexpr (std::is_invocable<Visitor, ref<List>&&>::value) {
+                        vis(ref<List>(static_cast<List*>(seq)));
+                        return;
                     }
-                } else {
-                    // todo: add type to msg
-                    throw std::runtime_error("unexpected type in atom");
-                }
-            },
-            atom->p);
+                    break;
+                case Seq::kind::vec:
+                    if constexpr (std::is_invocable<Visitor, ref<Vec>&&>::value) {
+                        vis(ref<Vec>(static_cast<Vec*>(seq)));
+                        return;
+                    }
+                    break;
+                default:
+                    break;
+            }
+
+            visit(ref<Seq>(seq));
+            break;
+        }
+        default:
+            // todo: add type to msg
+            throw std::runtime_error("unexpected type in atom");
+    }
 }
 
+namespace detail {
+
 template <typename Fn>
-patom make_callable(Fn fn)
+struct Thunk : public Callable
 {
-    struct Thunk : public Callable
+    Thunk(Fn fn, bool special) :
+        Callable(special), fn(fn)
+    {}
+
+    patom operator()(csxp::Env* env, AtomIterator* args)
     {
-        Thunk(Fn fn) :
-            fn(fn)
-        {}
+        return fn(env, args);
+    }
 
-        patom operator()(csxp::Env* env, AtomIterator* args)
-        {
-            return fn(env, args);
+    Builtin builtin() const
+    {
+        if constexpr (std::is_convertible_v<Fn, Builtin>) {
+            return fn;
+        } else {
+            return nullptr;
         }
+    }
 
-        Fn fn;
-    };
+    Fn fn;
+};
+
+} // namespace detail
+
+// a callable that's passed its args as code
+template <typename Fn>
+patom make_callable(Fn fn)
+{
+    return patom(make_ref<detail::Thunk<Fn>>(fn, true));
+}
 
-    return std::make_shared<atom>(
-            std::make_shared<Thunk>(fn));
+// a callable that evaluates every one of its args, through the
+// iterator's evaluated (see lib/detail/util.h), so it can be called
+// with values
+template <typename Fn>
+patom make_fn(Fn fn)
+{
+    return patom(make_ref<detail::Thunk<Fn>>(fn, false));
 }
 
-bool is_nil(patom a);
-bool truthy(patom a);
+// make_fn, for a callable that's pure (see Callable::pure)
+template <typename Fn>
+patom make_pure_fn(Fn fn)
+{
+    auto res = make_ref<detail::Thunk<Fn>>(fn, false);
+    res->pure = true;
+    return patom(std::move(res));
+}
+
+inline bool is_nil(const patom& a)
+{
+    return !a || a.is_nil();
+}
+
+inline bool truthy(const patom& a)
+{
+    return !is_nil(a) && !a.is_false();
+}
 
 // Global nil constant
 extern const patom Nil;
@@ -6,26 +6,9 @@
 
 namespace fmt {
 
+// used by the collection formatters, defined below
 template <>
-struct formatter<csxp::variant_type>
-{
-    template <typename ParseContext>
-    constexpr auto parse(ParseContext& ctx)
-    {
-        return ctx.begin();
-    }
-
-    template <typename FormatContext>
-    auto format(const csxp::variant_type& v, FormatContext& ctx)
-    {
-        if (v.index() == 0) {
-            // handle monostate
-            return format_to(ctx.out(), "<empty>");
-        } else {
-            return format_to(ctx.out(), v);
-        }
-    }
-};
+struct formatter<csxp::patom>;
 
 template <>
 struct formatter<csxp::Callable>
@@ -107,17 +90,55 @@ struct formatter<csxp::List>
     auto format(const csxp::List& l, FormatContext& ctx)
     {
         format_to(ctx.out(), "(");
-        for (std::size_t i = 0; i < l.items.size(); i++) {
-            if (i != 0) {
+        bool first = true;
+        for (auto& item : l.items) {
+            if (!first) {
                 format_to(ctx.out(), " ");
             }
 
-            format_to(ctx.out(), "{}", *l.items[i]);
+            format_to(ctx.out(), "{}", item);
+            first = false;
         }
         return format_to(ctx.out(), ")");
     }
 };
 
+template <>
+struct formatter<csxp::Local>
+{
+    template <typename ParseContext>
+    constexpr auto parse(ParseContext& ctx)
+    {
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const csxp::Local& l, FormatContext& ctx)
+    {
+        return format_to(ctx.out(), "{}", l.sym->name);
+    }
+};
+
+template <>
+struct formatter<csxp::Node>
+{
+    template <typename ParseContext>
+    constexpr auto parse(ParseContext& ctx)
+    {
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const csxp::Node& n, FormatContext& ctx)
+    {
+        // printed as the form it was compiled from
+        if (n.form) {
+            return format_to(ctx.out(), "{}", n.form);
+        }
+        return format_to(ctx.out(), "<code>");
+    }
+};
+
 template <>
 struct formatter<csxp::Map>
 {
@@ -130,19 +151,17 @@ struct formatter<csxp::Map>
     template <typename FormatContext>
     auto format(const csxp::Map& m, FormatContext& ctx)
     {
-        /*
-        format_to(ctx.out(), "(");
-        for (std::size_t i = 0; i < l.items.size(); i++) {
-            if (i != 0) {
-                format_to(ctx.out(), " ");
+        format_to(ctx.out(), "{{");
+        bool first = true;
+        for (auto& [key, val] : m.items) {
+            if (!first) {
+                format_to(ctx.out(), ", ");
             }
 
-            format_to(ctx.out(), "{}", *l.items[i]);
+            format_to(ctx.out(), "{} {}", key, val);
+            first = false;
         }
-        return format_to(ctx.out(), ")");
-        */
-        // todo: map
-        return format_to(ctx.out(), "{???}");
+        return format_to(ctx.out(), "}}");
     }
 };
 
@@ -174,15 +193,16 @@ struct formatter<csxp::Seq>
     template <typename FormatContext>
     auto format(const csxp::Seq& s, FormatContext& ctx)
     {
-        if (auto m = dynamic_cast<const csxp::Map*>(&s)) {
-            return format_to(ctx.out(), "{}", *m);
-        } else if (auto v = dynamic_cast<const csxp::Vec*>(&s)) {
-            return format_to(ctx.out(), "{}", *v);
-        } else if (auto l = dynamic_cast<const csxp::List*>(&s)) {
-            return format_to(ctx.out(), "{}", *l);
-        } else {
-            // todo: add type to msg
-            return format_to(ctx.out(), "<unknown seq>");
+        switch (s.seqkind) {
+            case csxp::Seq::kind::map:
+                return format_to(ctx.out(), "{}", static_cast<const csxp::Map&>(s));
+            case csxp::Seq::kind::vec:
+                return format_to(ctx.out(), "{}", static_cast<const csxp::Vec&>(s));
+            case csxp::Seq::kind::list:
+                return format_to(ctx.out(), "{}", static_cast<const csxp::List&>(s));
+            default:
+                // todo: add type to msg
+                return format_to(ctx.out(), "<unknown seq>");
         }
     }
 };
@@ -220,6 +240,40 @@ struct formatter<csxp::SymName>
     }
 };
 
+template <>
+struct formatter<csxp::Transient>
+{
+    template <typename ParseContext>
+    constexpr auto parse(ParseContext& ctx)
+    {
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const csxp::Transient& t, FormatContext& ctx)
+    {
+        return format_to(ctx.out(), "<transient {}>",
+                t.collkind == csxp::Seq::kind::map ? "map" : "vec");
+    }
+};
+
+template <>
+struct formatter<csxp::Var>
+{
+    template <typename ParseContext>
+    constexpr auto parse(ParseContext& ctx)
+    {
+        return ctx.begin();
+    }
+
+    template <typename FormatContext>
+    auto format(const csxp::Var& v, FormatContext& ctx)
+    {
+        // printed as the symbol it was bound from
+        return format_to(ctx.out(), "{}", v.sym->name);
+    }
+};
+
 template <>
 struct formatter<csxp::Vec>
 {
@@ -238,14 +292,14 @@ struct formatter<csxp::Vec>
                 format_to(ctx.out(), " ");
             }
 
-            format_to(ctx.out(), "{}", *v.items[i]);
+            format_to(ctx.out(), "{}", v.items[i]);
         }
         return format_to(ctx.out(), "]");
     }
 };
 
 template <>
-struct formatter<csxp::atom>
+struct formatter<csxp::patom>
 {
     template <typename ParseContext>
     constexpr auto parse(ParseContext& ctx)
@@ -254,43 +308,47 @@ struct formatter<csxp::atom>
     }
 
     template <typename FormatContext>
-    auto format(const csxp::atom& a, FormatContext& ctx)
-    {
-        return std::visit(
-                [&ctx](auto&& val) -> auto {
-                    using T = std::decay_t<decltype(val)>;
-
-                    if constexpr (std::is_same_v<T, std::monostate>) {
-                        return format_to(ctx.out(), "<empty>");
-                    } else if constexpr (
-                            std::is_same_v<T, std::shared_ptr<csxp::Callable>> ||
-                            std::is_same_v<T, std::shared_ptr<csxp::Char>> ||
-                            std::is_same_v<T, std::shared_ptr<csxp::Const>> ||
-                            std::is_same_v<T, std::shared_ptr<csxp::Keyword>> ||
-                            std::is_same_v<T, std::shared_ptr<csxp::Num>> ||
-                            std::is_same_v<T, std::shared_ptr<csxp::Str>> ||
-                            std::is_same_v<T, std::shared_ptr<csxp::SymName>>) {
-                        return format_to(ctx.out(), "{}", *val);
-                    } else if constexpr (std::is_same_v<T, std::shared_ptr<csxp::Seq>>) {
-                        if (auto m = std::dynamic_pointer_cast<csxp::Map>(val)) {
-                            return format_to(ctx.out(), "{}", *m);
-                        } else if (auto l = std::dynamic_pointer_cast<csxp::List>(val)) {
-                            return format_to(ctx.out(), "{}", *l);
-                        } else if (auto v = std::dynamic_pointer_cast<csxp::Vec>(val)) {
-                            return format_to(ctx.out(), "{}", *v);
-                        } else {
-                            // todo: add type to msg
-                            throw std::runtime_error("unexpected seq type in atom formatter");
-                        }
-                    } else {
-                        return format_to(ctx.out(), "<unknown type>");
-                        // todo: add eval map
-                        // todo: add type to msg
-                        // return format_to(ctx.out(), "huh? {}", typeid(T).name());
-                        //throw std::runtime_error("unexpected type in atom formatter");
-                    }
-                },
-                a.p);
+    auto format(const csxp::patom& a, FormatContext& ctx)
+    {
+        if (auto obj = a.get()) {
+            switch (obj->objtype) {
+                case csxp::Object::type::callable:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Callable*>(obj));
+                case csxp::Object::type::konst:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Const*>(obj));
+                case csxp::Object::type::keyword:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Keyword*>(obj));
+                case csxp::Object::type::local:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Local*>(obj));
+                case csxp::Object::type::node:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Node*>(obj));
+                case csxp::Object::type::seq:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Seq*>(obj));
+                case csxp::Object::type::str:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Str*>(obj));
+                case csxp::Object::type::symname:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::SymName*>(obj));
+                case csxp::Object::type::transient:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Transient*>(obj));
+                case csxp::Object::type::var:
+                    return format_to(ctx.out(), "{}", *static_cast<const csxp::Var*>(obj));
+                default:
+                    // todo: add type to msg
+                    return format_to(ctx.out(), "<unknown type>");
+            }
+        } else if (a.is_num()) {
+            return format_to(ctx.out(), "{}", csxp::Num(a.num()));
+        } else if (a.is_char()) {
+            return format_to(ctx.out(), "{}", csxp::Char(a.chr()));
+        } else if (a.is_nil()) {
+            return format_to(ctx.out(), "nil");
+        } else if (a.is_true()) {
+            return format_to(ctx.out(), "true");
+        } else if (a.is_false()) {
+            return format_to(ctx.out(), "false");
+        } else {
+            return format_to(ctx.out(), "<empty>");
+        }
     }
 };
 
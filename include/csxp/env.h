@@ -4,8 +4,10 @@
 #include "csxp/atom.h"
 
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <string_view>
+#include <vector>
 
 namespace csxp {
 
@@ -36,20 +38,73 @@ struct Module
     virtual void addMembers(const std::vector<ModuleMember>& members) = 0;
 };
 
-using Scope = std::unordered_map<std::string, patom>;
+// locals for one fn call or top level let, as a flat array indexed
+// by the slots analysis assigned. the slots are a region of the env's
+// stack of values, pushed and popped with the frame, and stay put while
+// frames above it come and go. captured is the values the fn closed
+// over, the locals of enclosing fns it uses, held by the fn itself.
+struct Frame
+{
+    patom* slots = nullptr;
+    std::size_t size = 0;
+    const std::vector<patom>* captured = nullptr;
+    // the fn this is a call of, if any, so a self tail call can tell
+    // the fn it calls is still the one running, and a call site that
+    // it's calling the fn it's in
+    const Callable* fn = nullptr;
+    // set by a recur, having rebound the locals of the innermost loop
+    // (or the fn), for it to go round again
+    bool recur = false;
+    // where the stack of values was before the slots were pushed, for
+    // popping the frame to reset it to
+    std::size_t block = 0;
+    std::size_t top = 0;
+};
+
+// how an env runs code. tree is the reference: it evaluates top level
+// forms recursively, and fns as the analyzer's node trees. vm compiles
+// each top level form and fn to bytecode for a register machine. a
+// call from vm code to a vm fn doesn't nest natively: where to return
+// to is kept on a stack on the heap, so recursion among vm fns takes
+// no native stack.
+enum class Engine
+{
+    tree,
+    vm,
+};
 
 struct Env
 {
     virtual ~Env() = default;
 
+    virtual Engine engine() const = 0;
+
     virtual patom resolve(const SymName* name) = 0;
-    virtual patom lexResolve(const SymName* name) = 0;
+    // finds the var a global symbol refers to; null if there isn't one
+    virtual ref<Var> resolveVar(const SymName* name) = 0;
+    // finds or declares the var def would set for name
+    virtual ref<Var> internVar(const SymName* name) = 0;
     virtual patom eval(const patom& val) = 0;
-    virtual void pushFrame(const Scope& scope) = 0;
+    // pushes a frame of size empty slots, which stays valid until it's
+    // popped
+    virtual Frame* pushFrame(std::size_t size,
+            const std::vector<patom>* captured = nullptr) = 0;
     virtual void popFrame() = 0;
+    // the innermost frame; null for top level code
+    virtual Frame* currFrame() const = 0;
+    // how deep evaluation may nest: frames (calls, and top level lets),
+    // plus forms nested in the form being evaluated or analyzed. past
+    // it, an EnvError is thrown, rather than the native stack running
+    // out. as calls among vm fns take no native stack, a vm env may
+    // raise it for deeper recursion. on linux, nesting that comes near
+    // the end of the thread's native stack throws too, whatever it is.
+    virtual std::size_t maxDepth() const = 0;
+    virtual void maxDepth(std::size_t depth) = 0;
+    // enters a level of nesting, throwing past maxDepth, and leaves it;
+    // see EnvDepth. pushing and popping a frame does this too.
+    virtual void enter() = 0;
+    virtual void leave() = 0;
     virtual void destructure(const patom& binding, const patom& val) = 0;
-    virtual void pushScope() = 0;
-    virtual void popScope() = 0;
     virtual void setInternal(std::string_view name, const patom& val) = 0;
     virtual void setInternal(const SymName* name,
             const patom& val) = 0;
@@ -62,31 +117,99 @@ struct Env
     virtual void aliasNs(std::string_view nsname, std::string_view nstarget) = 0;
 };
 
-// todo: drop Env prefix, have returned by pushScope
-class EnvScope
+// todo: drop Env prefix
+class EnvFrame
 {
 public:
-    EnvScope(Env* env) :
-        env(env) { env->pushScope(); }
-    ~EnvScope() { env->popScope(); }
+    EnvFrame(Env* env, std::size_t size,
+            const std::vector<patom>* captured = nullptr) :
+        env(env), frame(env->pushFrame(size, captured)) {}
+    ~EnvFrame() { env->popFrame(); }
+
+    EnvFrame(const EnvFrame&) = delete;
+    EnvFrame& operator=(const EnvFrame&) = delete;
+
+    Frame* get() const { return frame; }
+    Frame* operator->() const { return frame; }
 
 private:
     Env* env;
+    Frame* frame;
 };
 
-// todo: drop Env prefix, have returned by pushFrame
-class EnvFrame
+class EnvDepth
 {
 public:
-    EnvFrame(Env* env, const Scope& scope) :
-        env(env) { env->pushFrame(scope); }
-    ~EnvFrame() { env->popFrame(); }
+    explicit EnvDepth(Env* env) :
+        env(env) { env->enter(); }
+    ~EnvDepth() { env->leave(); }
+
+    EnvDepth(const EnvDepth&) = delete;
+    EnvDepth& operator=(const EnvDepth&) = delete;
 
 private:
     Env* env;
 };
 
-std::shared_ptr<Env> createEnv();
+// the maxDepth of a new env; deep enough for most scripts. how much
+// native stack a level takes depends on the build, so this doesn't
+// keep the tree engine within any given stack by itself; the check of
+// the stack's end does.
+constexpr std::size_t default_max_depth = 4096;
+
+std::shared_ptr<Env> createEnv(Engine engine = Engine::tree);
+
+// whether val evaluates to itself, so it can be shared rather than
+// evaluated: nums, strings, keywords and the like, callables, empty
+// lists, and vecs and maps of literals, nested no more than a few deep
+bool is_literal(const patom& val);
+
+// calls a callable that isn't special with the values of args, which
+// are evaluated into a buffer on the stack for small arities
+patom apply(Env* env, Callable& call, AtomIterator* args);
+
+// evaluates args into a buffer, on the stack for small arities, and
+// calls f with the values
+template <typename It, typename F>
+patom with_values(Env* env, It begin, It end, F&& f)
+{
+    constexpr std::size_t small = 8;
+
+    auto nargs = static_cast<std::size_t>(std::distance(begin, end));
+    if (nargs <= small) {
+        patom vals[small];
+        std::size_t i = 0;
+        for (auto it = begin; it != end; it++) {
+            vals[i++] = env->eval(*it);
+        }
+        return f(static_cast<const patom*>(vals), nargs);
+    }
+
+    std::vector<patom> vals;
+    vals.reserve(nargs);
+    for (auto it = begin; it != end; it++) {
+        vals.push_back(env->eval(*it));
+    }
+    return f(static_cast<const patom*>(vals.data()), nargs);
+}
+
+template <typename It>
+patom apply(Env* env, Callable& call, It begin, It end)
+{
+    return with_values(env, begin, end, [&](const patom* vals, std::size_t nargs) {
+        return call.call(env, vals, nargs);
+    });
+}
+
+// calls a builtin's function directly, with the values of args
+template <typename It>
+patom apply(Env* env, Callable::Builtin fn, It begin, It end)
+{
+    return with_values(env, begin, end, [&](const patom* vals, std::size_t nargs) {
+        ValuesIterator it(vals, nargs);
+        return fn(env, &it);
+    });
+}
 
 } // namespace csxp
 
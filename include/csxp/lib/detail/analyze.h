@@ -0,0 +1,94 @@
+#ifndef CSXP_LIB_DETAIL_ANALYZE_H
+#define CSXP_LIB_DETAIL_ANALYZE_H
+
+#include "csxp/atom.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace csxp {
+struct Env;
+
+namespace lib::detail::analyze {
+
+// a body of a fn, or a top level let, compiled to a tree of nodes (see
+// node.h). every local symbol in it is replaced by a Local holding its
+// slot, in the frame or in the fn's captured values, and every global
+// symbol that has a var by the var.
+struct Analyzed
+{
+    // for a fn, the params: locals, or vecs of them. empty for a let.
+    ref<Vec> binding;
+    // whether the last param (after & in the source) takes the rest of
+    // the args
+    bool variadic = false;
+    // the code to run in the frame
+    patom body;
+    // number of slots the frame needs
+    std::size_t framesize = 0;
+};
+
+// which body of a fn a call runs, from its number of args
+struct Arities
+{
+    static constexpr std::uint8_t none = 0xff;
+
+    // by number of args, the body taking that many: the one with as many
+    // params, or the variadic body, if it has no more
+    std::vector<std::uint8_t> bodies;
+    // the variadic body, for more args than that
+    std::uint8_t rest = none;
+
+    std::uint8_t operator()(std::size_t nargs) const
+    {
+        return nargs < bodies.size() ? bodies[nargs] : rest;
+    }
+};
+
+// a fn, with a body for each arity it has
+struct AnalyzedFn
+{
+    std::vector<Analyzed> bodies;
+    Arities arities;
+    // the locals of the enclosing fn (or let) to copy into it when it's
+    // created, one per captured slot, shared by its bodies. evaluated in
+    // the frame the fn is created in.
+    std::vector<patom> captures;
+};
+
+// counts of what analysis has folded into constants, across all envs:
+// vec literals of constants, calls of pure callables (see
+// Callable::pure) on constants, and ifs with a constant test
+struct FoldStats
+{
+    std::uint64_t vecs = 0;
+    std::uint64_t calls = 0;
+    std::uint64_t branches = 0;
+};
+
+FoldStats foldStats();
+void resetFoldStats();
+
+// compiles a fn, from the forms after fn (or a defn's name): params and
+// a body, or a list of them for each arity. each call gets its own
+// frame. self is the var a defn binds it to, if any, so it can tell
+// calls to itself.
+AnalyzedFn fn(Env* env, const patom& first, AtomIterator* rest,
+        const ref<Var>& self = {});
+
+// compiles a top level form as the body of a fn of no args, so it
+// gets a frame of its own for any locals
+Analyzed toplevel(Env* env, const patom& form);
+
+// compiles a top level let, which gets its own frame. lets nested in a
+// fn or let share the enclosing frame.
+Analyzed let(Env* env, const ref<Vec>& binding, AtomIterator* body);
+
+// compiles a top level loop, like let
+Analyzed loop(Env* env, const ref<Vec>& binding, AtomIterator* body);
+
+} // namespace lib::detail::analyze
+} // namespace csxp
+
+#endif // CSXP_LIB_DETAIL_ANALYZE_H
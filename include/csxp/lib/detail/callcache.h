@@ -0,0 +1,68 @@
+#ifndef CSXP_LIB_DETAIL_CALLCACHE_H
+#define CSXP_LIB_DETAIL_CALLCACHE_H
+
+#include "csxp/atom.h"
+
+#include <cstdint>
+
+namespace csxp {
+
+// inline caches for call sites. each compiled call remembers the callee
+// it last called, and what kind of callable it is, so calling the same
+// one again goes straight to it: a builtin's function is called
+// directly, with no virtual dispatch, and the vm knows a vm fn's body
+// for the site's number of args. calling anything else, as after the
+// var it's bound to is redefined, is a miss, and it replaces the last.
+namespace lib::detail::callcache {
+
+struct CallCache
+{
+    enum class kind : std::uint8_t
+    {
+        // not callable
+        none,
+        // from make_fn; its function is called with the values
+        builtin,
+        // from make_callable, like the special forms; its function is
+        // called with the code
+        form,
+        // any other callable taking values, through call
+        fn,
+        // any other callable taking code, through its call operator
+        special,
+        // a keyword, looking itself up in the map it's called with
+        // (see core::keyword_call)
+        keyword,
+    };
+
+    // whether callee is the one cached. on a miss, it's cached in place
+    // of the last, and the engine fills in body, if it has one. self is
+    // the fn running the site's code, if any (see Frame::fn).
+    bool check(const patom& callee, const Callable* self = nullptr);
+
+    // held, so it isn't freed and its address reused by another. not
+    // for a call of self, which holds the site: it would never be
+    // freed. any fn running the site shares its code, so the kind and
+    // body are the same whichever it is.
+    patom callee;
+    bool selfcall = false;
+    kind callkind = kind::none;
+    Callable::Builtin builtin = nullptr;
+    // the engine's own, for a fn it runs itself
+    const void* body = nullptr;
+};
+
+// hits and misses of call sites on this thread, across all envs
+struct Stats
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+};
+
+Stats stats();
+void resetStats();
+
+} // namespace lib::detail::callcache
+} // namespace csxp
+
+#endif // CSXP_LIB_DETAIL_CALLCACHE_H
@@ -16,6 +16,7 @@ patom quote(Env* env, AtomIterator* args);
 patom def(Env* env, AtomIterator* args);
 patom do_(Env* env, AtomIterator* args);
 patom let(Env* env, AtomIterator* args);
+patom loop(Env* env, AtomIterator* args);
 patom assert_(Env* env, AtomIterator* args);
 patom count(Env* env, AtomIterator* args);
 patom comment(Env* env, AtomIterator* args);
@@ -29,9 +30,37 @@ patom take(Env* env, AtomIterator* args);
 patom iterate(Env* env, AtomIterator* args);
 patom reduce(Env* env, AtomIterator* args);
 patom repeatedly(Env* env, AtomIterator* args);
+// flags a fn as pure, so calls of it on constants are folded
+patom mark_pure(Env* env, AtomIterator* args);
 
+// vecs are persistent (see pvector.h), so these share all but the
+// nodes they change with the vec they're given
 patom conj(Env* env, AtomIterator* args);
 patom assoc(Env* env, AtomIterator* args);
+patom nth(Env* env, AtomIterator* args);
+patom pop(Env* env, AtomIterator* args);
+
+// maps are persistent too (see phashmap.h); nil is an empty one
+patom dissoc(Env* env, AtomIterator* args);
+patom get(Env* env, AtomIterator* args);
+patom contains(Env* env, AtomIterator* args);
+// a keyword called as a fn, with the keyword as the first arg, then
+// the map it looks itself up in, and what to give if it's not there
+patom keyword_get(Env* env, AtomIterator* args);
+// the same, for a keyword that's called, with just the args after it
+patom keyword_call(Env* env, const patom& key, AtomIterator* args);
+// an arg that's called as a fn: a callable, or a keyword, wrapped in one
+ref<Callable> fn_arg(Env* env, AtomIterator* args, int errN, std::string_view errFn);
+// the value of key in a map, or at an index in a vec, else notFound
+// (or nil, if that's empty)
+patom lookup(const patom& coll, const patom& key, const patom& notFound);
+
+// transients: a vec or map updated in place (see Transient), for
+// building one up without copying nodes on each update
+patom transient(Env* env, AtomIterator* args);
+patom conj_transient(Env* env, AtomIterator* args);
+patom assoc_transient(Env* env, AtomIterator* args);
+patom persistent(Env* env, AtomIterator* args);
 
 } // namespace csxp::lib::detail::core
 } // namespace csxp
@@ -2,8 +2,10 @@
 #define CSXP_LIB_DETAIL_FN_H
 
 #include "csxp/atom.h"
+#include "csxp/lib/detail/analyze.h"
 
 #include <memory>
+#include <vector>
 
 namespace csxp {
 struct Env;
@@ -13,9 +15,17 @@ namespace lib::detail::fn {
 patom fn(Env* env, AtomIterator* args);
 patom defn(Env* env, AtomIterator* args);
 
-// for convenience...
-std::shared_ptr<Callable> makefn(Env* env,
-        std::shared_ptr<Vec> binding, AtomIterator* body);
+// for convenience... first and rest are the forms after fn; see
+// analyze::fn. self is the var a defn binds the fn to, if any.
+ref<Callable> makefn(Env* env,
+        const patom& first, AtomIterator* rest, const ref<Var>& self = {});
+
+// creates a fn from a compiled fn form, capturing the locals it uses
+// from the current frame
+patom closure(Env* env, const std::shared_ptr<const analyze::AnalyzedFn>& fn);
+
+// throws for a call with a number of args no arity of a fn takes
+[[noreturn]] void badArity(const analyze::Arities& arities, std::size_t nargs);
 
 } // namespace lib::detail::fn
 } // namespace csxp
@@ -10,6 +10,8 @@ namespace lib::detail::lazy {
 
 patom cons(Env* env, AtomIterator* args);
 patom lazy_seq(Env* env, AtomIterator* args);
+// an analyzed lazy-seq, taking its body as a fn
+patom lazy_seq_fn(Env* env, AtomIterator* args);
 patom repeat(Env* env, AtomIterator* args);
 
 } // namespace lib::detail::lazy
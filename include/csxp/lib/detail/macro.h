@@ -0,0 +1,29 @@
+#ifndef CSXP_LIB_DETAIL_MACRO_H
+#define CSXP_LIB_DETAIL_MACRO_H
+
+#include "csxp/atom.h"
+
+namespace csxp {
+struct Env;
+
+// macros are fns bound to vars flagged as macros. a call to one is
+// expanded where it's analyzed, so code in a fn is expanded once, when
+// the fn is compiled, rather than each time it runs.
+namespace lib::detail::macro {
+
+patom defmacro(Env* env, AtomIterator* args);
+patom syntax_quote(Env* env, AtomIterator* args);
+patom macroexpand(Env* env, AtomIterator* args);
+patom macroexpand_1(Env* env, AtomIterator* args);
+
+// the var of the macro lst calls, if it's a call to one
+ref<Var> macroOf(Env* env, const List& lst);
+
+// calls the macro in var with the rest of lst, as is, giving the form
+// to use in its place
+patom expand(Env* env, const Var& var, const List& lst);
+
+} // namespace lib::detail::macro
+} // namespace csxp
+
+#endif // CSXP_LIB_DETAIL_MACRO_H
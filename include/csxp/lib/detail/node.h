@@ -0,0 +1,407 @@
+#ifndef CSXP_LIB_DETAIL_NODE_H
+#define CSXP_LIB_DETAIL_NODE_H
+
+#include "csxp/atom.h"
+#include "csxp/lib/detail/analyze.h"
+#include "csxp/lib/detail/callcache.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace csxp {
+struct Env;
+
+// the nodes the analyzer compiles forms to. a compiled form is a tree
+// of these, with Local and Var atoms for symbols, and atoms that
+// evaluate to themselves (nums, strings, keywords, and so on) as is.
+// children are run with env->eval, which execs nodes directly.
+namespace lib::detail::node {
+
+// a quoted value
+struct ConstNode : public Node
+{
+    static constexpr kind node_kind = kind::konst;
+
+    ConstNode(patom form, patom val) :
+        Node(node_kind, std::move(form)), val(std::move(val)) {}
+
+    patom exec(Env* env) const;
+
+    patom val;
+};
+
+// a value worked out when compiled, by calling the pure callables some
+// vars held then. it stands while each var still holds what it did;
+// once one is redefined, code (compiled as if it hadn't been folded)
+// runs instead.
+struct FoldNode : public Node
+{
+    static constexpr kind node_kind = kind::fold;
+
+    struct Guard
+    {
+        ref<Var> var;
+        patom held;
+    };
+
+    FoldNode(patom form, patom val, std::vector<Guard> guards, patom code) :
+        Node(node_kind, std::move(form)),
+        val(std::move(val)),
+        guards(std::move(guards)),
+        code(std::move(code))
+    {}
+
+    patom exec(Env* env) const;
+
+    patom val;
+    std::vector<Guard> guards;
+    patom code;
+};
+
+// runs each form, giving the value of the last (or nil)
+struct DoNode : public Node
+{
+    static constexpr kind node_kind = kind::do_;
+
+    DoNode(patom form, std::vector<patom> body) :
+        Node(node_kind, std::move(form)), body(std::move(body)) {}
+
+    patom exec(Env* env) const;
+
+    std::vector<patom> body;
+};
+
+struct IfNode : public Node
+{
+    static constexpr kind node_kind = kind::if_;
+
+    IfNode(patom form, patom test, patom then, patom else_) :
+        Node(node_kind, std::move(form)),
+        test(std::move(test)),
+        then(std::move(then)),
+        else_(std::move(else_))
+    {}
+
+    patom exec(Env* env) const;
+
+    patom test;
+    patom then;
+    // empty if there's no else branch
+    patom else_;
+};
+
+// runs each form until one is falsey, giving its value (or that of
+// the last)
+struct AndNode : public Node
+{
+    static constexpr kind node_kind = kind::and_;
+
+    AndNode(patom form, std::vector<patom> body) :
+        Node(node_kind, std::move(form)), body(std::move(body)) {}
+
+    patom exec(Env* env) const;
+
+    std::vector<patom> body;
+};
+
+// runs each form until one is truthy, giving its value (or that of
+// the last)
+struct OrNode : public Node
+{
+    static constexpr kind node_kind = kind::or_;
+
+    OrNode(patom form, std::vector<patom> body) :
+        Node(node_kind, std::move(form)), body(std::move(body)) {}
+
+    patom exec(Env* env) const;
+
+    std::vector<patom> body;
+};
+
+// a vec binding target, compiled to a flat plan. the value goes in a
+// slot of its own, and each step takes an item (or the rest) of the
+// seq in one slot into another: the slot of a local, or the slot of a
+// nested vec, for the steps after it. :as names the vec's own slot,
+// so it takes no step at all.
+struct BindNode : public Node
+{
+    static constexpr kind node_kind = kind::bind;
+
+    enum class Op : std::uint8_t
+    {
+        nth,  // dst = item idx of src, or nil
+        rest, // dst = vec of the items of src from idx on
+    };
+
+    struct Step
+    {
+        Op op;
+        std::uint32_t dst;
+        std::uint32_t src;
+        std::uint32_t idx;
+    };
+
+    BindNode(patom form, std::uint32_t slot) :
+        Node(node_kind, std::move(form)), slot(slot) {}
+
+    // a binding isn't code; see bind
+    patom exec(Env* env) const;
+
+    // binds val in the current frame
+    void bind(Env* env, const patom& val) const;
+
+    std::uint32_t slot;
+    std::vector<Step> steps;
+};
+
+// binds val to a binding target in the current frame: a local, a
+// BindNode, or anything else, which env->destructure complains about
+void bind(Env* env, const patom& target, const patom& val);
+
+// the value of a variadic fn's last param: a vec of the rest of the
+// args, or nil if there are none
+patom restArgs(const patom* args, std::size_t nargs);
+
+// binds into slots of the current frame, then runs the body
+struct LetNode : public Node
+{
+    static constexpr kind node_kind = kind::let;
+
+    LetNode(patom form) :
+        Node(node_kind, std::move(form)) {}
+
+    patom exec(Env* env) const;
+
+    // targets are locals, or BindNodes; see bind
+    std::vector<patom> targets;
+    std::vector<patom> inits;
+    patom body;
+};
+
+// binds like let, then runs the body for as long as it ends in a recur
+struct LoopNode : public Node
+{
+    static constexpr kind node_kind = kind::loop;
+
+    LoopNode(patom form) :
+        Node(node_kind, std::move(form)) {}
+
+    patom exec(Env* env) const;
+
+    std::vector<patom> targets;
+    std::vector<patom> inits;
+    patom body;
+};
+
+// rebinds the targets of the innermost loop (or the fn's params) in
+// place, and flags the frame for the loop to go round again. args are
+// all evaluated into scratch slots first, so each sees the old values.
+struct RecurNode : public Node
+{
+    static constexpr kind node_kind = kind::recur;
+
+    RecurNode(patom form, std::vector<patom> targets,
+            std::vector<patom> args, std::size_t scratch) :
+        Node(node_kind, std::move(form)),
+        targets(std::move(targets)),
+        args(std::move(args)),
+        scratch(scratch)
+    {}
+
+    patom exec(Env* env) const;
+
+    std::vector<patom> targets;
+    std::vector<patom> args;
+    // the first of args.size() slots the args are evaluated into
+    std::size_t scratch;
+};
+
+// a call in tail position to the var a defn is defining. while the var
+// still holds the fn that's running, it's a recur; otherwise (the var
+// was redefined) it's a plain call.
+struct SelfCallNode : public Node
+{
+    static constexpr kind node_kind = kind::selfcall;
+
+    SelfCallNode(patom form, ref<Var> var, patom recur, patom invoke) :
+        Node(node_kind, std::move(form)),
+        var(std::move(var)),
+        recur(std::move(recur)),
+        invoke(std::move(invoke))
+    {}
+
+    patom exec(Env* env) const;
+
+    ref<Var> var;
+    // a RecurNode and an InvokeNode, sharing their args
+    patom recur;
+    patom invoke;
+};
+
+// sets a var bound at analysis, giving its symbol
+struct DefNode : public Node
+{
+    static constexpr kind node_kind = kind::def;
+
+    DefNode(patom form, ref<Var> var, patom init, bool macro = false) :
+        Node(node_kind, std::move(form)),
+        var(std::move(var)),
+        init(std::move(init)),
+        macro(macro)
+    {}
+
+    patom exec(Env* env) const;
+
+    ref<Var> var;
+    patom init;
+    // for defmacro; a def of anything else clears it
+    bool macro;
+};
+
+// creates a closure, capturing the locals it uses
+struct FnNode : public Node
+{
+    static constexpr kind node_kind = kind::fn;
+
+    FnNode(patom form, analyze::AnalyzedFn fn) :
+        Node(node_kind, std::move(form)),
+        fn(std::make_shared<const analyze::AnalyzedFn>(std::move(fn))) {}
+
+    patom exec(Env* env) const;
+
+    // shared by the closures it creates
+    std::shared_ptr<const analyze::AnalyzedFn> fn;
+};
+
+// builds a list or vec from a syntax-quoted one. each item is code
+// for a value, or, when spliced, for a seq of values to insert.
+struct SyntaxQuoteNode : public Node
+{
+    static constexpr kind node_kind = kind::syntax_quote;
+
+    struct Item
+    {
+        patom code;
+        bool splice;
+    };
+
+    SyntaxQuoteNode(patom form, Seq::kind seqkind, std::vector<Item> items) :
+        Node(node_kind, std::move(form)), seqkind(seqkind), items(std::move(items)) {}
+
+    patom exec(Env* env) const;
+
+    // list or vec
+    Seq::kind seqkind;
+    std::vector<Item> items;
+};
+
+// a vec literal, built fresh each time
+struct VecNode : public Node
+{
+    static constexpr kind node_kind = kind::vec;
+
+    VecNode(patom form, std::vector<patom> items) :
+        Node(node_kind, std::move(form)), items(std::move(items)) {}
+
+    patom exec(Env* env) const;
+
+    std::vector<patom> items;
+};
+
+// a map literal, built fresh each time
+struct MapNode : public Node
+{
+    static constexpr kind node_kind = kind::map;
+
+    MapNode(patom form, std::vector<patom> items) :
+        Node(node_kind, std::move(form)), items(std::move(items)) {}
+
+    patom exec(Env* env) const;
+
+    // keys and vals, in turn
+    std::vector<patom> items;
+};
+
+// checks the value of code, bound to a ^long local, is a num
+struct HintNode : public Node
+{
+    static constexpr kind node_kind = kind::hint;
+
+    HintNode(patom form, patom code, ref<SymName> sym) :
+        Node(node_kind, std::move(form)), code(std::move(code)), sym(std::move(sym)) {}
+
+    patom exec(Env* env) const;
+
+    patom code;
+    // the local's, for the error
+    ref<SymName> sym;
+};
+
+// a call of a math builtin on longs: nums, ^long locals, or other
+// arithmetic PrimNodes. while var still holds the builtin, it runs on
+// the ints as they are, with no call, and no check of its args;
+// otherwise it runs invoke, the call as written.
+struct PrimNode : public Node
+{
+    static constexpr kind node_kind = kind::prim;
+
+    // arithmetic, then comparisons
+    enum class Op : std::uint8_t
+    {
+        add,
+        sub,
+        mul,
+        inc,
+        lt,
+        lteq,
+        gt,
+        gteq,
+    };
+
+    PrimNode(patom form, Op op, ref<Var> var, std::vector<patom> args, patom invoke) :
+        Node(node_kind, std::move(form)),
+        op(op),
+        var(std::move(var)),
+        builtin(this->var->val),
+        args(std::move(args)),
+        invoke(std::move(invoke))
+    {}
+
+    patom exec(Env* env) const;
+
+    // the value of arithmetic, as an int
+    int evalLong(Env* env) const;
+
+    bool arith() const { return op < Op::lt; }
+
+    Op op;
+    ref<Var> var;
+    // what var held when it was analyzed
+    patom builtin;
+    // one for inc, otherwise two
+    std::vector<patom> args;
+    patom invoke;
+};
+
+// evaluates fn, and calls it with args: as code if it's special, so it
+// evaluates them (or not) itself, otherwise with their values.
+struct InvokeNode : public Node
+{
+    static constexpr kind node_kind = kind::invoke;
+
+    InvokeNode(patom form, patom fn, std::vector<patom> args) :
+        Node(node_kind, std::move(form)), fn(std::move(fn)), args(std::move(args)) {}
+
+    patom exec(Env* env) const;
+
+    patom fn;
+    std::vector<patom> args;
+    // of what fn last evaluated to
+    mutable callcache::CallCache cache;
+};
+
+} // namespace lib::detail::node
+} // namespace csxp
+
+#endif // CSXP_LIB_DETAIL_NODE_H
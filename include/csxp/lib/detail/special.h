@@ -0,0 +1,134 @@
+#ifndef CSXP_LIB_DETAIL_SPECIAL_H
+#define CSXP_LIB_DETAIL_SPECIAL_H
+
+#include "csxp/atom.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace csxp {
+struct Env;
+
+// the special forms: a fixed set, known at compile time. the analyzer
+// compiles them to nodes of their own, and a top level form headed by
+// one is run by its implementation here, so neither looks the head up
+// as a global. a local of the same name shadows them; a global doesn't.
+namespace lib::detail::special {
+
+enum class form : std::uint8_t
+{
+    none,
+    and_,
+    comment,
+    def,
+    defmacro,
+    defn,
+    do_,
+    fn,
+    if_,
+    lazy_seq,
+    let,
+    loop,
+    ns,
+    or_,
+    quote,
+    recur,
+    require,
+    syntax_quote,
+    when,
+};
+
+namespace impl {
+
+// in form order
+constexpr std::string_view names[] = {
+        {},
+        "and",
+        "comment",
+        "def",
+        "defmacro",
+        "defn",
+        "do",
+        "fn",
+        "if",
+        "lazy-seq",
+        "let",
+        "loop",
+        "ns",
+        "or",
+        "quote",
+        "recur",
+        "require",
+        "syntax-quote",
+        "when",
+};
+
+constexpr std::size_t table_size = 32;
+
+// perfect over names, from their length and first and last chars
+constexpr std::size_t hash(std::string_view name)
+{
+    return (name.size() * 7 + static_cast<unsigned char>(name.front()) +
+                   static_cast<unsigned char>(name.back()) * 9) &
+           (table_size - 1);
+}
+
+struct Table
+{
+    form slots[table_size] = {};
+};
+
+constexpr Table make_table()
+{
+    Table res;
+    for (std::size_t i = 1; i < std::size(names); i++) {
+        auto& slot = res.slots[hash(names[i])];
+        if (slot != form::none) {
+            throw "special form names collide";
+        }
+        slot = static_cast<form>(i);
+    }
+    return res;
+}
+
+inline constexpr Table table = make_table();
+
+} // namespace impl
+
+// the special form named name, or none
+constexpr form lookup(std::string_view name)
+{
+    if (name.empty()) {
+        return form::none;
+    }
+
+    auto res = impl::table.slots[impl::hash(name)];
+    return impl::names[static_cast<std::size_t>(res)] == name ? res : form::none;
+}
+
+// the special form a symbol heads, or none. looked up once, when the
+// symbol was interned.
+inline form of(const SymName* sym)
+{
+    return static_cast<form>(sym->special);
+}
+
+constexpr std::string_view name(form f)
+{
+    return impl::names[static_cast<std::size_t>(f)];
+}
+
+// runs a top level form headed by a special form. the rest of the form
+// is passed as is, as code.
+patom eval(Env* env, form f, const ref<List>& lst);
+
+// the implementation of a special form, as a callable. the analyzer
+// calls this for forms it leaves as they are, as their args aren't
+// code or they're malformed.
+const patom& callable(form f);
+
+} // namespace lib::detail::special
+} // namespace csxp
+
+#endif // CSXP_LIB_DETAIL_SPECIAL_H
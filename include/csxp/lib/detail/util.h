@@ -3,6 +3,7 @@
 
 #include "csxp/atom.h"
 #include "csxp/env.h"
+#include "fmt/format.h"
 
 #include <memory>
 #include <variant>
@@ -27,6 +28,12 @@ void check_no_args(AtomIterator* args, std::string_view errFn);
 patom arg_next(AtomIterator* args, int errN,
         std::string_view errFn);
 
+// the current item of args, evaluated unless args are values already
+inline patom eval_curr(Env* env, AtomIterator* args)
+{
+    return args->evaluated() ? args->value() : env->eval(args->value());
+}
+
 // gets and evals the next item from args; throws message about wrong # of args.
 // see arg_next without env arg for details.
 patom arg_next(Env* env, AtomIterator* args, int errN,
@@ -34,7 +41,7 @@ patom arg_next(Env* env, AtomIterator* args, int errN,
 
 // gets a typed next item from args; see default specialization arg_next
 template <typename T>
-std::shared_ptr<T> arg_next(AtomIterator* args, int errN,
+atom_ref_t<T> arg_next(AtomIterator* args, int errN,
         std::string_view errFn)
 {
     auto val = arg_next(args, errN, errFn);
@@ -51,7 +58,7 @@ std::shared_ptr<T> arg_next(AtomIterator* args, int errN,
 
 // gets a typed next item from args; see default specialization arg_next
 template <typename T>
-std::shared_ptr<T> arg_next(Env* env, AtomIterator* args, int errN,
+atom_ref_t<T> arg_next(Env* env, AtomIterator* args, int errN,
         std::string_view errFn)
 {
     auto val = arg_next(env, args, errN, errFn);
@@ -68,7 +75,7 @@ std::shared_ptr<T> arg_next(Env* env, AtomIterator* args, int errN,
 
 // gets the current typed item from args, throws if not correct type
 template <typename T>
-std::shared_ptr<T> arg_curr(AtomIterator* args, int errN,
+atom_ref_t<T> arg_curr(AtomIterator* args, int errN,
         std::string_view errFn)
 {
     auto val = args->value();
@@ -83,10 +90,10 @@ std::shared_ptr<T> arg_curr(AtomIterator* args, int errN,
 
 // gets and evals the current typed item from args, throws if not correct type
 template <typename T>
-std::shared_ptr<T> arg_curr(Env* env, AtomIterator* args, int errN,
+atom_ref_t<T> arg_curr(Env* env, AtomIterator* args, int errN,
         std::string_view errFn)
 {
-    auto val = env->eval(args->value());
+    auto val = eval_curr(env, args);
     if (auto p = get_if<T>(val)) {
         return p;
     }
@@ -0,0 +1,27 @@
+#ifndef CSXP_LIB_DETAIL_VM_H
+#define CSXP_LIB_DETAIL_VM_H
+
+#include "csxp/atom.h"
+#include "csxp/lib/detail/analyze.h"
+
+#include <vector>
+
+namespace csxp {
+struct Env;
+
+// the register machine behind Engine::vm. the analyzer's node trees are
+// compiled to bytecode, a chunk per fn, which runs with the fn's frame
+// as its register file: locals in the slots analysis gave them, and
+// temporaries after those.
+namespace lib::detail::vm {
+
+// compiles a top level form and runs it, in a frame of its own
+patom eval(Env* env, const patom& form);
+
+// compiles an analyzed fn to a vm fn, with the values it captured
+ref<Callable> makefn(std::vector<patom> captured, const analyze::AnalyzedFn& fn);
+
+} // namespace lib::detail::vm
+} // namespace csxp
+
+#endif // CSXP_LIB_DETAIL_VM_H
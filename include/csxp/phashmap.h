@@ -0,0 +1,741 @@
+#ifndef CSXP_PHASHMAP_H
+#define CSXP_PHASHMAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace csxp {
+
+// a persistent hash map. a small map is an array of its entries, in the
+// order they were added, and found by comparing keys in turn, without
+// hashing them. past array_max entries, it's a hash array mapped trie,
+// laid out as in CHAMP: each node splits on 5 bits of the hash, and
+// packs the entries that end there ahead of its subnodes, each found
+// by the bitmap of the hash bits in use. keys whose hashes are the same
+// all the way down share a collision node at the bottom.
+//
+// as in pvector, nodes are reference counted, and copies share them;
+// an update copies only the nodes on the path to the entry it changes,
+// and a node only this map holds is updated in place.
+template <typename K, typename V, typename Hash = std::hash<K>,
+        typename Equal = std::equal_to<K>>
+class phashmap
+{
+public:
+    static constexpr unsigned bits = 5;
+    static constexpr std::size_t width = std::size_t(1) << bits;
+    static constexpr std::size_t mask = width - 1;
+    // the most entries a map keeps as an array
+    static constexpr std::size_t array_max = 8;
+
+    class const_iterator;
+    using iterator = const_iterator;
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = std::size_t;
+
+    phashmap() = default;
+
+    phashmap(std::initializer_list<value_type> items) :
+        phashmap(items.begin(), items.end()) {}
+
+    template <typename It>
+    phashmap(It begin, It end)
+    {
+        for (auto it = begin; it != end; ++it) {
+            set(it->first, it->second);
+        }
+    }
+
+    phashmap(const phashmap& other) :
+        cnt(other.cnt), root(other.root)
+    {
+        retain(root);
+    }
+
+    phashmap(phashmap&& other) noexcept :
+        cnt(std::exchange(other.cnt, 0)),
+        root(std::exchange(other.root, nullptr))
+    {}
+
+    phashmap& operator=(phashmap other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~phashmap() { release(root); }
+
+    void swap(phashmap& other) noexcept
+    {
+        std::swap(cnt, other.cnt);
+        std::swap(root, other.root);
+    }
+
+    std::size_t size() const noexcept { return cnt; }
+    bool empty() const noexcept { return cnt == 0; }
+
+    // the value of key, or null if it isn't in the map
+    const V* find(const K& key) const
+    {
+        if (!root) {
+            return nullptr;
+        }
+
+        auto entry = root->kind == Node::array ?
+                scan(root, key) :
+                lookup(root, key, Hash{}(key));
+        return entry ? &entry->second : nullptr;
+    }
+
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    const_iterator begin() const { return const_iterator(root); }
+    const_iterator end() const { return const_iterator(); }
+
+    // the persistent updates, leaving this as it is
+
+    phashmap assoc(K key, V val) const
+    {
+        auto res = *this;
+        res.set(std::move(key), std::move(val));
+        return res;
+    }
+
+    phashmap dissoc(const K& key) const
+    {
+        auto res = *this;
+        res.erase(key);
+        return res;
+    }
+
+    // the in place updates, which only change what this map holds
+
+    // adds key, or replaces its value if it's already in the map
+    void set(K key, V val)
+    {
+        if (!root || root->kind == Node::array) {
+            if (setArray(key, val)) {
+                return;
+            }
+            toTrie();
+        }
+
+        bool added = false;
+        auto hash = Hash{}(key);
+        root = insert(root, 0, hash, std::move(key), std::move(val), added);
+        cnt += added;
+    }
+
+    // removes key, giving whether it was in the map
+    bool erase(const K& key)
+    {
+        if (!root) {
+            return false;
+        }
+
+        if (root->kind == Node::array) {
+            auto entry = scan(root, key);
+            if (!entry) {
+                return false;
+            }
+
+            auto idx = static_cast<std::uint32_t>(entry - root->entries());
+            if (unique(root)) {
+                // shifted down, to keep the rest in order
+                auto entries = root->entries();
+                std::move(entries + idx + 1, entries + root->count, entries + idx);
+                std::destroy_at(entries + --root->count);
+            } else {
+                root = resized(root, root->cap, idx);
+            }
+        } else {
+            auto hash = Hash{}(key);
+            if (!lookup(root, key, hash)) {
+                return false;
+            }
+            root = remove(root, 0, hash, key);
+        }
+
+        if (--cnt == 0) {
+            clear();
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        release(root);
+        root = nullptr;
+        cnt = 0;
+    }
+
+    // maps are equal if they have the same keys, with equal values,
+    // whatever order they're in
+    bool operator==(const phashmap& other) const
+    {
+        if (cnt != other.cnt) {
+            return false;
+        } else if (root == other.root) {
+            return true;
+        }
+
+        for (auto& [key, val] : *this) {
+            auto res = other.find(key);
+            if (!res || !(*res == val)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const phashmap& other) const { return !(*this == other); }
+
+private:
+#ifdef CSXP_NONATOMIC_REFCOUNT
+    using refcount_type = std::uint32_t;
+#else
+    using refcount_type = std::atomic<std::uint32_t>;
+#endif
+
+    static constexpr unsigned hash_bits = std::numeric_limits<std::size_t>::digits;
+    // a bitmap node for every 5 bits of the hash, then a collision node
+    static constexpr std::size_t max_depth = (hash_bits + bits - 1) / bits + 1;
+
+    // entries live after the header, and only the first count of them
+    // are constructed. a bitmap node's subnodes follow them.
+    struct Node
+    {
+        enum kind_type : std::uint8_t
+        {
+            array,
+            bitmap,
+            collision,
+        };
+
+        static constexpr std::size_t header()
+        {
+            return (sizeof(Node) + alignof(value_type) - 1) /
+                   alignof(value_type) * alignof(value_type);
+        }
+
+        static std::size_t kidsAt(std::size_t cap)
+        {
+            auto res = header() + cap * sizeof(value_type);
+            return (res + alignof(Node*) - 1) / alignof(Node*) * alignof(Node*);
+        }
+
+        static Node* make(kind_type kind, std::size_t cap, std::size_t nkids = 0)
+        {
+            auto mem = ::operator new(kidsAt(cap) + nkids * sizeof(Node*));
+            auto res = new (mem) Node;
+            res->kind = kind;
+            res->cap = static_cast<std::uint32_t>(cap);
+            return res;
+        }
+
+        value_type* entries()
+        {
+            return reinterpret_cast<value_type*>(reinterpret_cast<char*>(this) + header());
+        }
+        const value_type* entries() const
+        {
+            return reinterpret_cast<const value_type*>(
+                    reinterpret_cast<const char*>(this) + header());
+        }
+
+        Node** kids()
+        {
+            return reinterpret_cast<Node**>(reinterpret_cast<char*>(this) + kidsAt(cap));
+        }
+        Node* const* kids() const
+        {
+            return reinterpret_cast<Node* const*>(
+                    reinterpret_cast<const char*>(this) + kidsAt(cap));
+        }
+
+        std::uint32_t nkids() const { return popcount(nodemap); }
+
+        mutable refcount_type refs = 1;
+        kind_type kind = array;
+        std::uint32_t count = 0;
+        std::uint32_t cap = 0;
+        // which hash bits at this level lead to an entry, or a subnode
+        std::uint32_t datamap = 0;
+        std::uint32_t nodemap = 0;
+        // the hash a collision node's keys share
+        std::size_t hash = 0;
+    };
+
+    static unsigned popcount(std::uint32_t val)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_popcount(val));
+#else
+        unsigned res = 0;
+        for (; val; val &= val - 1) {
+            res++;
+        }
+        return res;
+#endif
+    }
+
+    static std::uint32_t bitOf(std::size_t hash, unsigned shift)
+    {
+        return std::uint32_t(1) << ((hash >> shift) & mask);
+    }
+
+    // where the entry or subnode for bit is, among those in map
+    static std::uint32_t index(std::uint32_t map, std::uint32_t bit)
+    {
+        return popcount(map & (bit - 1));
+    }
+
+    static void retain(const Node* node)
+    {
+        if (node) {
+#ifdef CSXP_NONATOMIC_REFCOUNT
+            ++node->refs;
+#else
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+#endif
+        }
+    }
+
+    static bool unique(const Node* node)
+    {
+#ifdef CSXP_NONATOMIC_REFCOUNT
+        return node->refs == 1;
+#else
+        return node->refs.load(std::memory_order_acquire) == 1;
+#endif
+    }
+
+    // frees a node, without touching its subnodes
+    static void free(Node* node)
+    {
+        std::destroy_n(node->entries(), node->count);
+        node->~Node();
+        ::operator delete(node);
+    }
+
+    static void release(Node* node)
+    {
+        if (!node) {
+            return;
+        }
+
+#ifdef CSXP_NONATOMIC_REFCOUNT
+        if (--node->refs != 0) {
+            return;
+        }
+#else
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+#endif
+
+        auto kids = node->kids();
+        for (std::uint32_t i = 0; i < node->nkids(); i++) {
+            release(kids[i]);
+        }
+        free(node);
+    }
+
+    // a node we hold, which only we hold, copying it if it's shared
+    static Node* own(Node* node)
+    {
+        if (unique(node)) {
+            return node;
+        }
+
+        auto res = Node::make(node->kind, node->cap, node->nkids());
+        res->datamap = node->datamap;
+        res->nodemap = node->nodemap;
+        res->hash = node->hash;
+        std::uninitialized_copy_n(node->entries(), node->count, res->entries());
+        res->count = node->count;
+        std::copy_n(node->kids(), node->nkids(), res->kids());
+        for (std::uint32_t i = 0; i < res->nkids(); i++) {
+            retain(res->kids()[i]);
+        }
+
+        release(node);
+        return res;
+    }
+
+    // an array or collision node like src (or an empty array node), with
+    // room for cap entries, and without the entry at skip. src's entries
+    // are moved if only we hold it, or copied if not; either way, our
+    // reference to it is dropped.
+    static Node* resized(Node* src, std::size_t cap,
+            std::uint32_t skip = static_cast<std::uint32_t>(-1))
+    {
+        auto res = Node::make(src ? src->kind : Node::array, cap);
+        if (!src) {
+            return res;
+        }
+
+        res->hash = src->hash;
+        bool moving = unique(src);
+        auto to = res->entries();
+        for (std::uint32_t i = 0; i < src->count; i++) {
+            if (i != skip) {
+                auto& entry = src->entries()[i];
+                moving ? new (to++) value_type(std::move(entry)) :
+                         new (to++) value_type(entry);
+            }
+        }
+        res->count = static_cast<std::uint32_t>(to - res->entries());
+
+        moving ? free(src) : release(src);
+        return res;
+    }
+
+    // a bitmap node like src, but with entry (if any) at bit in place of
+    // what src had there, or with kid (if any) there instead. src's other
+    // entries and subnodes are moved if only we hold it, or copied if not;
+    // either way, our reference to it is dropped.
+    static Node* rebuild(Node* src, std::uint32_t bit, value_type* entry, Node* kid)
+    {
+        auto datamap = (src->datamap & ~bit) | (entry ? bit : 0);
+        auto nodemap = (src->nodemap & ~bit) | (kid ? bit : 0);
+
+        auto res = Node::make(Node::bitmap, popcount(datamap), popcount(nodemap));
+        res->datamap = datamap;
+        res->nodemap = nodemap;
+
+        bool moving = unique(src);
+
+        auto from = src->entries();
+        auto to = res->entries();
+        for (auto left = datamap | src->datamap; left; left &= left - 1) {
+            auto b = left & (~left + 1);
+            if (b != bit) {
+                moving ? new (to++) value_type(std::move(*from++)) :
+                         new (to++) value_type(*from++);
+                continue;
+            }
+
+            if (entry) {
+                new (to++) value_type(std::move(*entry));
+            }
+            if (src->datamap & b) {
+                from++;
+            }
+        }
+        res->count = popcount(datamap);
+
+        auto kidsFrom = src->kids();
+        auto kidsTo = res->kids();
+        for (auto left = nodemap | src->nodemap; left; left &= left - 1) {
+            auto b = left & (~left + 1);
+            if (b != bit) {
+                if (!moving) {
+                    retain(*kidsFrom);
+                }
+                *kidsTo++ = *kidsFrom++;
+                continue;
+            }
+
+            if (kid) {
+                *kidsTo++ = kid;
+            }
+            if (src->nodemap & b) {
+                // src's reference to it goes with src
+                if (moving) {
+                    release(*kidsFrom);
+                }
+                kidsFrom++;
+            }
+        }
+
+        moving ? free(src) : release(src);
+        return res;
+    }
+
+    // finds key in an array or collision node, by comparing it to each
+    static const value_type* scan(const Node* node, const K& key)
+    {
+        auto entries = node->entries();
+        for (std::uint32_t i = 0; i < node->count; i++) {
+            if (Equal{}(entries[i].first, key)) {
+                return entries + i;
+            }
+        }
+        return nullptr;
+    }
+
+    static const value_type* lookup(const Node* node, const K& key, std::size_t hash)
+    {
+        for (unsigned shift = 0;; shift += bits) {
+            if (node->kind != Node::bitmap) {
+                return scan(node, key);
+            }
+
+            auto bit = bitOf(hash, shift);
+            if (node->datamap & bit) {
+                auto& entry = node->entries()[index(node->datamap, bit)];
+                return Equal{}(entry.first, key) ? &entry : nullptr;
+            } else if (!(node->nodemap & bit)) {
+                return nullptr;
+            }
+            node = node->kids()[index(node->nodemap, bit)];
+        }
+    }
+
+    // sets key in the array root, unless the array is full and key is
+    // new, giving whether it did
+    bool setArray(K& key, V& val)
+    {
+        if (root) {
+            if (auto entry = scan(root, key)) {
+                auto idx = entry - root->entries();
+                root = own(root);
+                root->entries()[idx].second = std::move(val);
+                return true;
+            }
+        }
+
+        if (cnt == array_max) {
+            return false;
+        }
+
+        // grown by doubling, from 2
+        if (!root || !unique(root) || root->count == root->cap) {
+            auto cap = root ? root->cap : 0;
+            root = resized(root, root && root->count < cap ?
+                            cap :
+                            std::min(array_max, std::max<std::size_t>(2, cap * 2)));
+        }
+
+        new (root->entries() + root->count) value_type(std::move(key), std::move(val));
+        root->count++;
+        cnt++;
+        return true;
+    }
+
+    // turns a full array root into a trie of the same entries
+    void toTrie()
+    {
+        auto src = root;
+        bool moving = unique(src);
+
+        root = Node::make(Node::bitmap, 0);
+        bool added = false;
+        for (std::uint32_t i = 0; i < src->count; i++) {
+            auto& [key, val] = src->entries()[i];
+            auto hash = Hash{}(key);
+            root = moving ?
+                    insert(root, 0, hash, std::move(key), std::move(val), added) :
+                    insert(root, 0, hash, K(key), V(val), added);
+        }
+
+        release(src);
+    }
+
+    // a node holding two entries, with different keys, at shift
+    static Node* merge(unsigned shift, value_type&& lhs, std::size_t lhash,
+            value_type&& rhs, std::size_t rhash)
+    {
+        if (shift >= hash_bits) {
+            auto res = Node::make(Node::collision, 2);
+            res->hash = lhash;
+            new (res->entries()) value_type(std::move(lhs));
+            new (res->entries() + 1) value_type(std::move(rhs));
+            res->count = 2;
+            return res;
+        }
+
+        auto lbit = bitOf(lhash, shift);
+        auto rbit = bitOf(rhash, shift);
+        if (lbit == rbit) {
+            auto res = Node::make(Node::bitmap, 0, 1);
+            res->nodemap = lbit;
+            res->kids()[0] = merge(shift + bits, std::move(lhs), lhash,
+                    std::move(rhs), rhash);
+            return res;
+        }
+
+        auto res = Node::make(Node::bitmap, 2);
+        res->datamap = lbit | rbit;
+        auto first = lbit < rbit ? &lhs : &rhs;
+        auto second = lbit < rbit ? &rhs : &lhs;
+        new (res->entries()) value_type(std::move(*first));
+        new (res->entries() + 1) value_type(std::move(*second));
+        res->count = 2;
+        return res;
+    }
+
+    // sets key in a node of the trie at shift, giving the node to hold
+    // in its place; our reference to node goes to the result
+    static Node* insert(Node* node, unsigned shift, std::size_t hash, K&& key,
+            V&& val, bool& added)
+    {
+        if (node->kind == Node::collision) {
+            if (auto entry = scan(node, key)) {
+                auto idx = entry - node->entries();
+                node = own(node);
+                node->entries()[idx].second = std::move(val);
+                return node;
+            }
+
+            added = true;
+            auto res = resized(node, node->count + 1);
+            new (res->entries() + res->count) value_type(std::move(key), std::move(val));
+            res->count++;
+            return res;
+        }
+
+        auto bit = bitOf(hash, shift);
+        if (node->datamap & bit) {
+            auto idx = index(node->datamap, bit);
+            auto& entry = node->entries()[idx];
+            if (Equal{}(entry.first, key)) {
+                node = own(node);
+                node->entries()[idx].second = std::move(val);
+                return node;
+            }
+
+            // two keys here, so both go down a level
+            added = true;
+            auto other = unique(node) ? value_type(std::move(entry)) : value_type(entry);
+            auto otherHash = Hash{}(other.first);
+            auto kid = merge(shift + bits, std::move(other), otherHash,
+                    value_type(std::move(key), std::move(val)), hash);
+            return rebuild(node, bit, nullptr, kid);
+        } else if (node->nodemap & bit) {
+            node = own(node);
+            auto& kid = node->kids()[index(node->nodemap, bit)];
+            kid = insert(kid, shift + bits, hash, std::move(key), std::move(val), added);
+            return node;
+        }
+
+        added = true;
+        value_type entry(std::move(key), std::move(val));
+        return rebuild(node, bit, &entry, nullptr);
+    }
+
+    // the entry of a node that has only one, and no subnodes, or null
+    static value_type* single(Node* node)
+    {
+        return node->count == 1 && !node->nodemap ? node->entries() : nullptr;
+    }
+
+    // removes key, which is in the trie, from a node at shift, giving
+    // the node to hold in its place; our reference to node goes to the
+    // result. a node left with a single entry, and no subnodes, is
+    // folded into its parent, so the trie stays as shallow as it can.
+    static Node* remove(Node* node, unsigned shift, std::size_t hash, const K& key)
+    {
+        if (node->kind == Node::collision) {
+            auto idx = static_cast<std::uint32_t>(scan(node, key) - node->entries());
+            return resized(node, node->count - 1, idx);
+        }
+
+        auto bit = bitOf(hash, shift);
+        if (node->datamap & bit) {
+            return rebuild(node, bit, nullptr, nullptr);
+        }
+
+        node = own(node);
+        auto& kid = node->kids()[index(node->nodemap, bit)];
+        kid = remove(kid, shift + bits, hash, key);
+        if (auto entry = single(kid)) {
+            auto moved = unique(kid) ? value_type(std::move(*entry)) : value_type(*entry);
+            return rebuild(node, bit, &moved, nullptr);
+        }
+        return node;
+    }
+
+    std::size_t cnt = 0;
+    Node* root = nullptr;
+
+public:
+    // walks the trie depth first, each node's entries before its
+    // subnodes, so there's no order to it but that of the hashes
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename phashmap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return *curr; }
+        pointer operator->() const { return curr; }
+
+        const_iterator& operator++()
+        {
+            advance();
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        bool operator==(const const_iterator& other) const { return curr == other.curr; }
+        bool operator!=(const const_iterator& other) const { return curr != other.curr; }
+
+    private:
+        friend class phashmap;
+
+        explicit const_iterator(const Node* root)
+        {
+            if (root) {
+                stack[depth++] = {root, 0};
+                advance();
+            }
+        }
+
+        void advance()
+        {
+            while (depth > 0) {
+                auto& top = stack[depth - 1];
+                if (top.idx < top.node->count) {
+                    curr = top.node->entries() + top.idx++;
+                    return;
+                }
+
+                auto kid = top.idx++ - top.node->count;
+                if (kid < top.node->nkids()) {
+                    stack[depth++] = {top.node->kids()[kid], 0};
+                } else {
+                    depth--;
+                }
+            }
+            curr = nullptr;
+        }
+
+        struct Pos
+        {
+            const Node* node;
+            std::uint32_t idx;
+        };
+
+        Pos stack[max_depth];
+        std::size_t depth = 0;
+        const value_type* curr = nullptr;
+    };
+};
+
+} // namespace csxp
+
+#endif // CSXP_PHASHMAP_H
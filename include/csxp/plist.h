@@ -0,0 +1,270 @@
+#ifndef CSXP_PLIST_H
+#define CSXP_PLIST_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace csxp {
+
+// a persistent singly linked list. cells are reference counted and
+// never change once linked, so a list's rest, or a list with an item
+// consed onto it, shares every cell after its head with the list it
+// came from. both are O(1), as is size, which each list keeps rather
+// than counting its cells.
+template <typename T>
+class plist
+{
+public:
+    class const_iterator;
+    using iterator = const_iterator;
+    using value_type = T;
+    using size_type = std::size_t;
+
+    plist() = default;
+
+    plist(std::initializer_list<T> items)
+    {
+        assign(items.begin(), items.end());
+    }
+
+    plist(const std::vector<T>& items)
+    {
+        assign(items.begin(), items.end());
+    }
+
+    plist(std::vector<T>&& items)
+    {
+        assign(std::make_move_iterator(items.begin()),
+                std::make_move_iterator(items.end()));
+    }
+
+    template <typename It>
+    plist(It begin, It end)
+    {
+        assign(begin, end);
+    }
+
+    plist(const plist& other) :
+        cnt(other.cnt), head(other.head)
+    {
+        retain(head);
+    }
+
+    plist(plist&& other) noexcept :
+        cnt(std::exchange(other.cnt, 0)),
+        head(std::exchange(other.head, nullptr))
+    {}
+
+    plist& operator=(plist other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~plist() { release(head); }
+
+    void swap(plist& other) noexcept
+    {
+        std::swap(cnt, other.cnt);
+        std::swap(head, other.head);
+    }
+
+    std::size_t size() const noexcept { return cnt; }
+    bool empty() const noexcept { return cnt == 0; }
+
+    const T& front() const { return head->val; }
+
+    // walks to the item, so O(idx)
+    const T& operator[](std::size_t idx) const
+    {
+        return *std::next(begin(), idx);
+    }
+
+    const_iterator begin() const { return const_iterator(head); }
+    const_iterator end() const { return const_iterator(nullptr); }
+
+    // the persistent updates, leaving this as it is
+
+    plist cons(T val) const
+    {
+        auto res = *this;
+        res.push_front(std::move(val));
+        return res;
+    }
+
+    // all but the first n items, sharing their cells
+    plist drop(std::size_t n) const
+    {
+        plist res;
+        if (n < cnt) {
+            auto cell = head;
+            for (std::size_t i = 0; i < n; i++) {
+                cell = cell->next;
+            }
+            retain(cell);
+            res.head = cell;
+            res.cnt = cnt - n;
+        }
+        return res;
+    }
+
+    plist rest() const { return drop(1); }
+
+    // the in place updates, which only change what this list holds
+
+    void push_front(T val)
+    {
+        // the new cell takes over this list's reference to the old head
+        head = new Cell{1, std::move(val), head};
+        cnt++;
+    }
+
+    void pop_front()
+    {
+        auto next = head->next;
+        retain(next);
+        release(head);
+        head = next;
+        cnt--;
+    }
+
+    void clear()
+    {
+        release(head);
+        head = nullptr;
+        cnt = 0;
+    }
+
+    template <typename It>
+    void assign(It begin, It end)
+    {
+        clear();
+
+        // the new cells are only ours until we're done, so they're
+        // linked up front to back
+        auto link = &head;
+        for (auto it = begin; it != end; ++it) {
+            *link = new Cell{1, *it, nullptr};
+            link = &(*link)->next;
+            cnt++;
+        }
+    }
+
+    bool operator==(const plist& other) const
+    {
+        if (cnt != other.cnt) {
+            return false;
+        }
+
+        // lists sharing a tail are equal from there on
+        auto lhs = head;
+        auto rhs = other.head;
+        for (; lhs != rhs; lhs = lhs->next, rhs = rhs->next) {
+            if (!(lhs->val == rhs->val)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const plist& other) const { return !(*this == other); }
+
+private:
+#ifdef CSXP_NONATOMIC_REFCOUNT
+    using refcount_type = std::uint32_t;
+#else
+    using refcount_type = std::atomic<std::uint32_t>;
+#endif
+
+    struct Cell
+    {
+        mutable refcount_type refs;
+        T val;
+        Cell* next;
+    };
+
+    static void retain(const Cell* cell)
+    {
+        if (cell) {
+#ifdef CSXP_NONATOMIC_REFCOUNT
+            ++cell->refs;
+#else
+            cell->refs.fetch_add(1, std::memory_order_relaxed);
+#endif
+        }
+    }
+
+    // drops a reference to a cell. freeing a cell drops its reference
+    // to the next, in a loop rather than recursively, so a long list
+    // doesn't use up the stack.
+    static void release(Cell* cell)
+    {
+        while (cell) {
+#ifdef CSXP_NONATOMIC_REFCOUNT
+            if (--cell->refs != 0) {
+                return;
+            }
+#else
+            if (cell->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+#endif
+
+            auto next = cell->next;
+            delete cell;
+            cell = next;
+        }
+    }
+
+    std::size_t cnt = 0;
+    Cell* head = nullptr;
+
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return cell->val; }
+        pointer operator->() const { return &cell->val; }
+
+        const_iterator& operator++()
+        {
+            cell = cell->next;
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        bool operator==(const const_iterator& other) const { return cell == other.cell; }
+        bool operator!=(const const_iterator& other) const { return cell != other.cell; }
+
+    private:
+        friend class plist;
+
+        explicit const_iterator(const Cell* cell) :
+            cell(cell) {}
+
+        const Cell* cell = nullptr;
+    };
+};
+
+} // namespace csxp
+
+#endif // CSXP_PLIST_H
@@ -0,0 +1,608 @@
+#ifndef CSXP_PVECTOR_H
+#define CSXP_PVECTOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace csxp {
+
+// a persistent vector: a trie of 32-way nodes holding all but the last
+// few items, which are kept in a tail leaf outside it. copies share
+// their nodes, so a copy is O(1), and an update copies only the nodes
+// on the path to the item it changes; everything else stays shared.
+// nodes are reference counted, and a node only this vector holds is
+// updated in place, so building a vector by pushing onto it doesn't
+// copy anything.
+//
+// the tail of a small vector is allocated as it grows, so a vector of
+// up to 32 items is a single leaf, with nothing in the trie.
+template <typename T>
+class pvector
+{
+public:
+    static constexpr unsigned bits = 5;
+    static constexpr std::size_t width = std::size_t(1) << bits;
+    static constexpr std::size_t mask = width - 1;
+
+    class const_iterator;
+    using iterator = const_iterator;
+    using value_type = T;
+    using size_type = std::size_t;
+
+    pvector() = default;
+
+    pvector(std::initializer_list<T> items)
+    {
+        assign(items.begin(), items.end());
+    }
+
+    pvector(const std::vector<T>& items)
+    {
+        assign(items.begin(), items.end());
+    }
+
+    pvector(std::vector<T>&& items)
+    {
+        assign(std::make_move_iterator(items.begin()),
+                std::make_move_iterator(items.end()));
+    }
+
+    template <typename It>
+    pvector(It begin, It end)
+    {
+        assign(begin, end);
+    }
+
+    pvector(const pvector& other) :
+        cnt(other.cnt), shift(other.shift), root(other.root), tail(other.tail)
+    {
+        retain(root);
+        retain(tail);
+    }
+
+    pvector(pvector&& other) noexcept :
+        cnt(std::exchange(other.cnt, 0)),
+        shift(std::exchange(other.shift, bits)),
+        root(std::exchange(other.root, nullptr)),
+        tail(std::exchange(other.tail, nullptr))
+    {}
+
+    pvector& operator=(pvector other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~pvector()
+    {
+        release(root, shift);
+        release(tail, 0);
+    }
+
+    void swap(pvector& other) noexcept
+    {
+        std::swap(cnt, other.cnt);
+        std::swap(shift, other.shift);
+        std::swap(root, other.root);
+        std::swap(tail, other.tail);
+    }
+
+    std::size_t size() const noexcept { return cnt; }
+    bool empty() const noexcept { return cnt == 0; }
+
+    const T& operator[](std::size_t idx) const
+    {
+        return chunk(idx)[idx & mask];
+    }
+
+    const T& front() const { return (*this)[0]; }
+    const T& back() const { return tail->items()[tail->size - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, cnt); }
+
+    // the items of the leaf holding idx, from the first in it
+    const T* chunk(std::size_t idx) const
+    {
+        if (idx >= tailoff()) {
+            return tail->items();
+        }
+
+        auto node = root;
+        for (auto level = shift; level > 0; level -= bits) {
+            node = static_cast<const Branch*>(node)->kids[(idx >> level) & mask];
+        }
+        return static_cast<const Leaf*>(node)->items();
+    }
+
+    // calls f with each leaf's items and how many there are, in order
+    template <typename F>
+    void chunks(F&& f) const
+    {
+        for (std::size_t i = 0; i < cnt; i += width) {
+            f(chunk(i), std::min(width, cnt - i));
+        }
+    }
+
+    // the persistent updates, leaving this as it is
+
+    pvector conj(T val) const
+    {
+        auto res = *this;
+        res.push_back(std::move(val));
+        return res;
+    }
+
+    pvector assoc(std::size_t idx, T val) const
+    {
+        auto res = *this;
+        res.set(idx, std::move(val));
+        return res;
+    }
+
+    pvector pop() const
+    {
+        auto res = *this;
+        res.pop_back();
+        return res;
+    }
+
+    // in place updates, copying only the nodes other vectors share
+
+    void push_back(T val)
+    {
+        if (!tail) {
+            tail = Leaf::make(grow(0));
+        } else if (cnt - tailoff() < width) {
+            auto cap = tail->size == tail->cap ? grow(tail->cap) : tail->cap;
+            if (!unique(tail)) {
+                replaceTail(copy(tail, cap));
+            } else if (cap != tail->cap) {
+                replaceTail(move(tail, cap));
+            }
+        } else {
+            // the tail is full; it goes into the trie, and val starts a
+            // new one
+            if (!root) {
+                auto res = new Branch;
+                res->kids[0] = tail;
+                root = res;
+            } else if ((cnt >> bits) > (std::size_t(1) << shift)) {
+                auto res = new Branch;
+                res->kids[0] = root;
+                res->kids[1] = path(shift, tail);
+                root = res;
+                shift += bits;
+            } else {
+                root = pushTail(shift, root, tail);
+            }
+            tail = Leaf::make(width);
+        }
+
+        new (tail->items() + tail->size) T(std::move(val));
+        tail->size++;
+        cnt++;
+    }
+
+    template <typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        push_back(T(std::forward<Args>(args)...));
+    }
+
+    void set(std::size_t idx, T val)
+    {
+        if (idx >= tailoff()) {
+            if (!unique(tail)) {
+                replaceTail(copy(tail, tail->cap));
+            }
+            tail->items()[idx & mask] = std::move(val);
+            return;
+        }
+
+        root = own(root, shift);
+        auto node = root;
+        for (auto level = shift; level > 0; level -= bits) {
+            auto& kid = static_cast<Branch*>(node)->kids[(idx >> level) & mask];
+            kid = own(kid, level - bits);
+            node = kid;
+        }
+        static_cast<Leaf*>(node)->items()[idx & mask] = std::move(val);
+    }
+
+    void pop_back()
+    {
+        if (cnt <= 1) {
+            clear();
+            return;
+        } else if (cnt - tailoff() > 1) {
+            if (!unique(tail)) {
+                replaceTail(copy(tail, tail->cap));
+            }
+            tail->size--;
+            tail->items()[tail->size].~T();
+            cnt--;
+            return;
+        }
+
+        // the tail's last item goes, so the trie's last leaf becomes
+        // the tail
+        auto last = const_cast<Leaf*>(static_cast<const Leaf*>(leaf(cnt - 2)));
+        retain(last);
+        release(tail, 0);
+        tail = last;
+
+        root = popTail(shift, root);
+        if (!root) {
+            shift = bits;
+        } else if (shift > bits && !static_cast<Branch*>(root)->kids[1]) {
+            auto res = static_cast<Branch*>(root)->kids[0];
+            static_cast<Branch*>(root)->kids[0] = nullptr;
+            release(root, shift);
+            root = res;
+            shift -= bits;
+        }
+        cnt--;
+    }
+
+    void clear()
+    {
+        release(root, shift);
+        release(tail, 0);
+        cnt = 0;
+        shift = bits;
+        root = nullptr;
+        tail = nullptr;
+    }
+
+    // makes room for n items, if they'd all fit in the tail
+    void reserve(std::size_t n)
+    {
+        if (cnt == 0 && n > 0 && n <= width && (!tail || tail->cap < n)) {
+            replaceTail(Leaf::make(n));
+        }
+    }
+
+    template <typename It>
+    void assign(It begin, It end)
+    {
+        clear();
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                              typename std::iterator_traits<It>::iterator_category>) {
+            reserve(static_cast<std::size_t>(std::distance(begin, end)));
+        }
+        for (; begin != end; ++begin) {
+            push_back(*begin);
+        }
+    }
+
+    bool operator==(const pvector& other) const
+    {
+        if (cnt != other.cnt) {
+            return false;
+        } else if (root == other.root && tail == other.tail) {
+            return true;
+        }
+
+        return std::equal(begin(), end(), other.begin());
+    }
+
+    bool operator!=(const pvector& other) const { return !(*this == other); }
+
+private:
+#ifdef CSXP_NONATOMIC_REFCOUNT
+    using refcount_type = std::uint32_t;
+#else
+    using refcount_type = std::atomic<std::uint32_t>;
+#endif
+
+    struct Node
+    {
+        mutable refcount_type refs = 1;
+    };
+
+    struct Branch : public Node
+    {
+        Node* kids[width] = {};
+    };
+
+    // items live after the header, and only the first size of them
+    // are constructed
+    struct Leaf : public Node
+    {
+        static constexpr std::size_t header =
+                (sizeof(Node) + 2 * sizeof(std::uint32_t) + alignof(T) - 1) /
+                alignof(T) * alignof(T);
+
+        static Leaf* make(std::size_t cap)
+        {
+            auto mem = ::operator new(header + cap * sizeof(T));
+            auto res = new (mem) Leaf;
+            res->cap = static_cast<std::uint32_t>(cap);
+            return res;
+        }
+
+        T* items() { return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + header); }
+        const T* items() const
+        {
+            return reinterpret_cast<const T*>(reinterpret_cast<const char*>(this) + header);
+        }
+
+        std::uint32_t size = 0;
+        std::uint32_t cap = 0;
+    };
+
+    static std::size_t grow(std::size_t cap)
+    {
+        return std::min(width, std::max<std::size_t>(4, cap * 2));
+    }
+
+    static void retain(const Node* node)
+    {
+        if (node) {
+#ifdef CSXP_NONATOMIC_REFCOUNT
+            ++node->refs;
+#else
+            node->refs.fetch_add(1, std::memory_order_relaxed);
+#endif
+        }
+    }
+
+    static bool unique(const Node* node)
+    {
+#ifdef CSXP_NONATOMIC_REFCOUNT
+        return node->refs == 1;
+#else
+        return node->refs.load(std::memory_order_acquire) == 1;
+#endif
+    }
+
+    // drops a reference to a node at level, which is 0 for leaves
+    static void release(Node* node, unsigned level)
+    {
+        if (!node) {
+            return;
+        }
+
+#ifdef CSXP_NONATOMIC_REFCOUNT
+        if (--node->refs != 0) {
+            return;
+        }
+#else
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+#endif
+
+        if (level == 0) {
+            auto leaf = static_cast<Leaf*>(node);
+            std::destroy_n(leaf->items(), leaf->size);
+            leaf->~Leaf();
+            ::operator delete(leaf);
+        } else {
+            auto branch = static_cast<Branch*>(node);
+            for (auto kid : branch->kids) {
+                release(kid, level - bits);
+            }
+            delete branch;
+        }
+    }
+
+    // a copy of a leaf (or an empty one) with room for cap items
+    static Leaf* copy(const Leaf* src, std::size_t cap)
+    {
+        auto res = Leaf::make(cap);
+        if (src) {
+            std::uninitialized_copy_n(src->items(), src->size, res->items());
+            res->size = src->size;
+        }
+        return res;
+    }
+
+    // a leaf with room for cap items, taking them from src, which only
+    // the caller holds
+    static Leaf* move(Leaf* src, std::size_t cap)
+    {
+        auto res = Leaf::make(cap);
+        std::uninitialized_move_n(src->items(), src->size, res->items());
+        res->size = src->size;
+        return res;
+    }
+
+    void replaceTail(Leaf* leaf)
+    {
+        release(tail, 0);
+        tail = leaf;
+    }
+
+    // node, or a copy of it if it's shared; either way, held only by
+    // the caller, which gives up its reference to node
+    static Node* own(Node* node, unsigned level)
+    {
+        if (unique(node)) {
+            return node;
+        }
+
+        Node* res;
+        if (level == 0) {
+            auto leaf = static_cast<const Leaf*>(node);
+            res = copy(leaf, leaf->cap);
+        } else {
+            auto branch = new Branch;
+            std::copy(std::begin(static_cast<const Branch*>(node)->kids),
+                    std::end(static_cast<const Branch*>(node)->kids), branch->kids);
+            for (auto kid : branch->kids) {
+                retain(kid);
+            }
+            res = branch;
+        }
+
+        release(node, level);
+        return res;
+    }
+
+    std::size_t tailoff() const
+    {
+        return cnt < width ? 0 : ((cnt - 1) >> bits) << bits;
+    }
+
+    const Node* leaf(std::size_t idx) const
+    {
+        auto node = root;
+        for (auto level = shift; level > 0; level -= bits) {
+            node = static_cast<const Branch*>(node)->kids[(idx >> level) & mask];
+        }
+        return node;
+    }
+
+    // a chain of branches down from level to leaf
+    static Node* path(unsigned level, Node* leaf)
+    {
+        if (level == 0) {
+            return leaf;
+        }
+
+        auto res = new Branch;
+        res->kids[0] = path(level - bits, leaf);
+        return res;
+    }
+
+    Node* pushTail(unsigned level, Node* parent, Node* leaf)
+    {
+        auto res = static_cast<Branch*>(own(parent, level));
+        auto& kid = res->kids[((cnt - 1) >> level) & mask];
+        if (level == bits) {
+            kid = leaf;
+        } else if (kid) {
+            kid = pushTail(level - bits, kid, leaf);
+        } else {
+            kid = path(level - bits, leaf);
+        }
+        return res;
+    }
+
+    // drops the last leaf, giving the node left, or null if it's empty
+    Node* popTail(unsigned level, Node* node)
+    {
+        auto idx = ((cnt - 2) >> level) & mask;
+        auto res = static_cast<Branch*>(own(node, level));
+        auto& kid = res->kids[idx];
+        if (level > bits) {
+            kid = popTail(level - bits, kid);
+        } else {
+            release(kid, 0);
+            kid = nullptr;
+        }
+
+        if (!kid && idx == 0) {
+            release(res, level);
+            return nullptr;
+        }
+        return res;
+    }
+
+    std::size_t cnt = 0;
+    unsigned shift = bits;
+    Node* root = nullptr;
+    Leaf* tail = nullptr;
+
+public:
+    // steps through the items a leaf at a time, only going down the
+    // trie for the first item of each
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        const_iterator(const pvector* vec, std::size_t idx) :
+            vec(vec), idx(idx), items(idx < vec->cnt ? vec->chunk(idx) : nullptr)
+        {}
+
+        reference operator*() const { return items[idx & mask]; }
+        pointer operator->() const { return &items[idx & mask]; }
+        reference operator[](difference_type n) const { return *(*this + n); }
+
+        const_iterator& operator++()
+        {
+            if ((++idx & mask) == 0) {
+                items = idx < vec->cnt ? vec->chunk(idx) : nullptr;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        const_iterator& operator--()
+        {
+            if ((idx-- & mask) == 0 || !items) {
+                items = vec->chunk(idx);
+            }
+            return *this;
+        }
+
+        const_iterator operator--(int)
+        {
+            auto res = *this;
+            --*this;
+            return res;
+        }
+
+        const_iterator& operator+=(difference_type n)
+        {
+            auto to = idx + n;
+            if ((to >> bits) != (idx >> bits) || !items) {
+                items = to < vec->cnt ? vec->chunk(to) : nullptr;
+            }
+            idx = to;
+            return *this;
+        }
+
+        const_iterator& operator-=(difference_type n) { return *this += -n; }
+
+        friend const_iterator operator+(const_iterator it, difference_type n) { return it += n; }
+        friend const_iterator operator+(difference_type n, const_iterator it) { return it += n; }
+        friend const_iterator operator-(const_iterator it, difference_type n) { return it -= n; }
+
+        difference_type operator-(const const_iterator& other) const
+        {
+            return static_cast<difference_type>(idx) - static_cast<difference_type>(other.idx);
+        }
+
+        bool operator==(const const_iterator& other) const { return idx == other.idx; }
+        bool operator!=(const const_iterator& other) const { return idx != other.idx; }
+        bool operator<(const const_iterator& other) const { return idx < other.idx; }
+        bool operator>(const const_iterator& other) const { return idx > other.idx; }
+        bool operator<=(const const_iterator& other) const { return idx <= other.idx; }
+        bool operator>=(const const_iterator& other) const { return idx >= other.idx; }
+
+    private:
+        const pvector* vec = nullptr;
+        std::size_t idx = 0;
+        // the leaf idx is in
+        const T* items = nullptr;
+    };
+};
+
+} // namespace csxp
+
+#endif // CSXP_PVECTOR_H
@@ -1,75 +1,430 @@
 #include "csxp/atom.h"
+#include "csxp/lib/detail/special.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std::literals;
 
 namespace csxp {
 
-const patom Nil = Const::make_atom("nil"sv);
-const patom True = Const::make_atom("true"sv);
-const patom False = Const::make_atom("false"sv);
+const patom Nil = patom::make_nil();
+const patom True = patom::make_bool(true);
+const patom False = patom::make_bool(false);
+
+void Object::destroy(const Object* obj) noexcept
+{
+    switch (obj->objtype) {
+        case type::callable:
+            delete static_cast<const Callable*>(obj);
+            break;
+        case type::konst:
+            delete static_cast<const Const*>(obj);
+            break;
+        case type::keyword:
+            delete static_cast<const Keyword*>(obj);
+            break;
+        case type::local:
+            delete static_cast<const Local*>(obj);
+            break;
+        case type::node:
+            // virtual, so this reaches the concrete node
+            delete static_cast<const Node*>(obj);
+            break;
+        case type::seq:
+            delete static_cast<const Seq*>(obj);
+            break;
+        case type::str:
+            delete static_cast<const Str*>(obj);
+            break;
+        case type::symname:
+            delete static_cast<const SymName*>(obj);
+            break;
+        case type::transient:
+            delete static_cast<const Transient*>(obj);
+            break;
+        case type::var:
+            delete static_cast<const Var*>(obj);
+            break;
+    }
+}
+
+namespace {
+
+// canonical instances of an interned type, keyed on a view of each
+// instance's own name. entries are never removed, so a name lives as
+// long as the program does.
+template <typename T>
+class InternTable
+{
+public:
+    ref<T> intern(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return intern_locked(name);
+    }
+
+private:
+    ref<T> intern_locked(std::string_view name)
+    {
+        if (auto it = table.find(name); it != table.end()) {
+            return it->second;
+        }
+
+        // pinned, as the table holds it for good
+        auto obj = make_ref<T>(name);
+        obj->pin();
+        if constexpr (std::is_same_v<T, SymName>) {
+            if (obj->slash != std::string::npos) {
+                obj->nssym = intern_locked(obj->nspart()).get();
+                obj->basesym = intern_locked(obj->basename()).get();
+            } else {
+                obj->special = static_cast<std::uint8_t>(
+                        lib::detail::special::lookup(obj->name));
+            }
+        }
+
+        table.emplace(obj->name, obj);
+        return obj;
+    }
+
+    std::mutex mtx;
+    std::unordered_map<std::string_view, ref<T>> table;
+};
 
-atom::atom(variant_type v) :
-    p(v)
-{}
+template <typename T>
+InternTable<T>& internTable()
+{
+    // function local, as other statics intern during initialization.
+    // never destroyed, so its names are still reachable at exit, and
+    // statics destroyed after it can still drop theirs.
+    static auto table = new InternTable<T>;
+    return *table;
+}
 
-atom::atom(const atom& other) :
-    p(other.p)
-{}
+} // namespace
 
-atom::atom(atom&& other) noexcept :
-    p(std::move(other.p))
-{}
+ref<Const> Const::intern(std::string_view name)
+{
+    return internTable<Const>().intern(name);
+}
 
-atom& atom::operator=(const atom& other)
+ref<Keyword> Keyword::intern(std::string_view name)
 {
-    return *this = atom(other);
+    return internTable<Keyword>().intern(name);
 }
 
-atom& atom::operator=(atom&& other) noexcept
+ref<SymName> SymName::intern(std::string_view name)
 {
-    std::swap(p, other.p);
-    return *this;
+    return internTable<SymName>().intern(name);
 }
 
-bool operator==(const atom& lhs, const atom& rhs)
+bool operator==(const patom& lhs, const patom& rhs)
 {
-    return std::visit(
-            [](auto&& lhs, auto&& rhs) -> bool {
-                using LT = std::decay_t<decltype(lhs)>;
-                using RT = std::decay_t<decltype(rhs)>;
+    // same immediate, same heap object, or both empty
+    if (lhs.raw() == rhs.raw()) {
+        return true;
+    }
 
-                if constexpr (std::is_same_v<LT, std::monostate> &&
-                              std::is_same_v<RT, std::monostate>) {
-                    return true;
-                } else if constexpr (std::is_same_v<LT, RT>) {
-                    if constexpr (std::is_same_v<LT, std::shared_ptr<Callable>>) {
-                        // when both callables are null, they're equal,
-                        // other callables are never equal (I'm lazy)
-                        if (!lhs && !rhs) {
-                            return true;
-                        }
-                        return false;
-                    } else {
-                        // compare anything else, no casts needed
-                        return atom_vals_eq(lhs, rhs);
-                    }
-                } else {
-                    // types differ
-                    return false;
-                }
-            },
-            lhs.p, rhs.p);
+    // differing immediates, or one side empty or immediate
+    auto l = lhs.get();
+    auto r = rhs.get();
+    if (!l || !r || l->objtype != r->objtype) {
+        return false;
+    }
 
-    return true;
+    switch (l->objtype) {
+        case Object::type::konst:
+            return *static_cast<const Const*>(l) == *static_cast<const Const*>(r);
+        case Object::type::keyword:
+            return *static_cast<const Keyword*>(l) == *static_cast<const Keyword*>(r);
+        case Object::type::seq:
+            return *static_cast<const Seq*>(l) == *static_cast<const Seq*>(r);
+        case Object::type::str:
+            return *static_cast<const Str*>(l) == *static_cast<const Str*>(r);
+        case Object::type::symname:
+            return *static_cast<const SymName*>(l) == *static_cast<const SymName*>(r);
+        default:
+            // callables, locals and vars are only equal to themselves (I'm lazy)
+            return false;
+    }
 }
 
-bool operator!=(const atom& lhs, const atom& rhs)
+bool operator!=(const patom& lhs, const patom& rhs)
 {
     return !(lhs == rhs);
 }
 
+namespace {
+
+// spreads the bits of val over the whole hash (the splitmix64 finalizer)
+std::size_t mix(std::uint64_t val)
+{
+    val ^= val >> 30;
+    val *= 0xbf58476d1ce4e5b9;
+    val ^= val >> 27;
+    val *= 0x94d049bb133111eb;
+    val ^= val >> 31;
+    return static_cast<std::size_t>(val);
+}
+
+// the wyhash primitives: a 64x64->128 bit multiply, folded, and reads
+// of unaligned bytes
+void wymum(std::uint64_t& a, std::uint64_t& b)
+{
+#ifdef __SIZEOF_INT128__
+    auto res = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<std::uint64_t>(res);
+    b = static_cast<std::uint64_t>(res >> 64);
+#else
+    auto ha = a >> 32, hb = b >> 32, la = a & 0xffffffff, lb = b & 0xffffffff;
+    auto rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    auto t = rl + (rm0 << 32);
+    auto c = static_cast<std::uint64_t>(t < rl);
+    auto lo = t + (rm1 << 32);
+    c += lo < t;
+    a = lo;
+    b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+std::uint64_t wymix(std::uint64_t a, std::uint64_t b)
+{
+    wymum(a, b);
+    return a ^ b;
+}
+
+std::uint64_t wyr8(const unsigned char* p)
+{
+    std::uint64_t res;
+    std::memcpy(&res, p, sizeof(res));
+    return res;
+}
+
+std::uint64_t wyr4(const unsigned char* p)
+{
+    std::uint32_t res;
+    std::memcpy(&res, p, sizeof(res));
+    return res;
+}
+
+std::uint64_t wyr3(const unsigned char* p, std::size_t len)
+{
+    return (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[len >> 1]) << 8) | p[len - 1];
+}
+
+constexpr std::uint64_t wysecret[] = {
+        0xa0761d6478bd642f,
+        0xe7037ed1a0b428db,
+        0x8ebc6af09c88c6e3,
+        0x589965cc75374cc3,
+};
+
+// finishes a collection's hash, folding in how many items went into it
+std::size_t mixColl(std::size_t res, std::size_t cnt)
+{
+    return mix(res ^ mix(cnt));
+}
+
+// ordered: lists, vecs, and the [k v] entries of a map, so an entry
+// hashes the same as the vec it's given as
+template <typename It>
+std::size_t orderedHash(It begin, It end)
+{
+    std::size_t res = 1;
+    std::size_t cnt = 0;
+    for (auto it = begin; it != end; ++it, cnt++) {
+        res = res * 31 + hash(*it);
+    }
+    return mixColl(res, cnt);
+}
+
+std::size_t entryHash(const patom& key, const patom& val)
+{
+    return mixColl((31 + hash(key)) * 31 + hash(val), 2);
+}
+
+// unordered: summed, so the order of a map's entries doesn't matter
+std::size_t mapHash(const Map::items_type& items)
+{
+    std::size_t res = 0;
+    for (auto& [key, val] : items) {
+        res += entryHash(key, val);
+    }
+    return mixColl(res, items.size());
+}
+
+std::size_t seqHash(const Seq* seq)
+{
+    switch (seq->seqkind) {
+        case Seq::kind::list: {
+            auto& items = static_cast<const List*>(seq)->items;
+            return orderedHash(items.begin(), items.end());
+        }
+        case Seq::kind::vec: {
+            auto& items = static_cast<const Vec*>(seq)->items;
+            return orderedHash(items.begin(), items.end());
+        }
+        case Seq::kind::map:
+            return mapHash(static_cast<const Map*>(seq)->items);
+        default: {
+            // through the iterator, as for a list
+            std::size_t res = 1;
+            std::size_t cnt = 0;
+            auto it = seq->iterator();
+            while (it->next()) {
+                res = res * 31 + hash(it->value());
+                cnt++;
+            }
+            return mixColl(res, cnt);
+        }
+    }
+}
+
+// lists and vecs compare item by item, without going through their
+// iterators
+template <typename L, typename R>
+bool equalItems(const L& lhs, const R& rhs)
+{
+    return lhs.size() == rhs.size() &&
+           std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <typename L>
+bool equalItems(const L& lhs, const Seq& rhs)
+{
+    if (rhs.seqkind == Seq::kind::list) {
+        return equalItems(lhs, static_cast<const List&>(rhs).items);
+    }
+    return equalItems(lhs, static_cast<const Vec&>(rhs).items);
+}
+
+bool isListOrVec(const Seq& seq)
+{
+    return seq.seqkind == Seq::kind::list || seq.seqkind == Seq::kind::vec;
+}
+
+} // namespace
+
+std::size_t hashString(std::string_view str)
+{
+    auto p = reinterpret_cast<const unsigned char*>(str.data());
+    auto len = str.size();
+
+    std::uint64_t seed = wymix(wysecret[0], wysecret[1]);
+    std::uint64_t a, b;
+    if (len <= 16) {
+        if (len >= 4) {
+            a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+            b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+        } else if (len > 0) {
+            a = wyr3(p, len);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        auto i = len;
+        if (i > 48) {
+            auto see1 = seed, see2 = seed;
+            do {
+                seed = wymix(wyr8(p) ^ wysecret[1], wyr8(p + 8) ^ seed);
+                see1 = wymix(wyr8(p + 16) ^ wysecret[2], wyr8(p + 24) ^ see1);
+                see2 = wymix(wyr8(p + 32) ^ wysecret[3], wyr8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = wymix(wyr8(p) ^ wysecret[1], wyr8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+        a = wyr8(p + i - 16);
+        b = wyr8(p + i - 8);
+    }
+
+    a ^= wysecret[1];
+    b ^= seed;
+    wymum(a, b);
+    return static_cast<std::size_t>(wymix(a ^ wysecret[0] ^ len, b ^ wysecret[1]));
+}
+
+std::size_t hash(const patom& val)
+{
+    // immediates (nil, bools, nums and chars) are equal only if their
+    // bits are
+    auto obj = val.get();
+    if (!obj) {
+        return mix(val.raw());
+    }
+
+    switch (obj->objtype) {
+        case Object::type::konst:
+            return static_cast<const Const*>(obj)->hash;
+        case Object::type::keyword:
+            return static_cast<const Keyword*>(obj)->hash;
+        case Object::type::symname:
+            return static_cast<const SymName*>(obj)->hash;
+        case Object::type::str: {
+            auto str = static_cast<const Str*>(obj);
+            std::size_t res = str->hashval;
+            if (res == 0) {
+                res = hashString(str->val);
+                str->hashval = res;
+            }
+            return res;
+        }
+        case Object::type::seq: {
+            auto seq = static_cast<const Seq*>(obj);
+            std::size_t res = seq->hashval;
+            if (res == 0) {
+                res = seqHash(seq);
+                if (seq->seqkind != Seq::kind::seq) {
+                    seq->hashval = res;
+                }
+            }
+            return res;
+        }
+        default:
+            // equal only to themselves
+            return mix(reinterpret_cast<std::uintptr_t>(obj));
+    }
+}
+
 bool operator==(const Seq& lhs, const Seq& rhs)
 {
+    if (&lhs == &rhs) {
+        return true;
+    }
+
+    // seqs that have both worked out their hashes already can only be
+    // equal if those are
+    std::size_t lhash = lhs.hashval;
+    std::size_t rhash = rhs.hashval;
+    if (lhash != 0 && rhash != 0 && lhash != rhash) {
+        return false;
+    }
+
+    // maps are equal by their entries, in whatever order, and never
+    // equal to other seqs
+    if (lhs.seqkind == Seq::kind::map || rhs.seqkind == Seq::kind::map) {
+        return lhs.seqkind == rhs.seqkind &&
+               static_cast<const Map&>(lhs).items == static_cast<const Map&>(rhs).items;
+    }
+
+    if (isListOrVec(lhs) && isListOrVec(rhs)) {
+        if (lhs.seqkind == Seq::kind::list) {
+            return equalItems(static_cast<const List&>(lhs).items, rhs);
+        }
+        return equalItems(static_cast<const Vec&>(lhs).items, rhs);
+    }
+
     const auto lhsit = lhs.iterator();
     const auto rhsit = rhs.iterator();
 
@@ -87,14 +442,9 @@ bool operator==(const Seq& lhs, const Seq& rhs)
             auto lhsval = lhsit->value();
             auto rhsval = rhsit->value();
 
-            // both null or not null?
-            if (!lhsval != !rhsval) {
+            // handles both null or not null
+            if (lhsval != rhsval) {
                 return false;
-            } else if (lhsval) {
-                // both have items, they equal?
-                if (*lhsval != *rhsval) {
-                    return false;
-                }
             }
 
             hasLeft = lhsit->next();
@@ -126,9 +476,22 @@ SeqIt Seq::end()
     return SeqIt({});
 }
 
+patom Const::make_atom(std::string_view name)
+{
+    if (name == "nil"sv) {
+        return Nil;
+    } else if (name == "true"sv) {
+        return True;
+    } else if (name == "false"sv) {
+        return False;
+    }
+
+    return patom(intern(name));
+}
+
 bool operator==(const Const& lhs, const Const& rhs)
 {
-    return lhs.name == rhs.name;
+    return &lhs == &rhs;
 }
 
 bool operator!=(const Const& lhs, const Const& rhs)
@@ -158,6 +521,12 @@ bool operator!=(const Num& lhs, const Num& rhs)
 
 bool operator==(const Str& lhs, const Str& rhs)
 {
+    std::size_t lhash = lhs.hashval;
+    std::size_t rhash = rhs.hashval;
+    if (lhash != 0 && rhash != 0 && lhash != rhash) {
+        return false;
+    }
+
     return lhs.val == rhs.val;
 }
 
@@ -168,7 +537,7 @@ bool operator!=(const Str& lhs, const Str& rhs)
 
 bool operator==(const SymName& lhs, const SymName& rhs)
 {
-    return lhs.name == rhs.name;
+    return &lhs == &rhs;
 }
 
 bool operator!=(const SymName& lhs, const SymName& rhs)
@@ -176,60 +545,62 @@ bool operator!=(const SymName& lhs, const SymName& rhs)
     return !(lhs == rhs);
 }
 
+// gives each entry as a vec of its key and value
 struct MapIterator : public AtomIterator
 {
 public:
-    MapIterator(std::shared_ptr<const Map> s) :
-        s(s)
+    MapIterator(ref<const Map> s) :
+        s(s), it(s->items.begin())
     {}
 
     bool next()
     {
-        /* todo: map
-        int len = static_cast<int>(s->items.size());
-        if (s && !s->items.empty() && idx < len - 1) {
-            idx++;
-            return true;
+        if (!started) {
+            started = true;
+        } else if (it != s->items.end()) {
+            ++it;
         }
-        */
 
-        return false;
+        if (it == s->items.end()) {
+            return false;
+        }
+
+        curr = Vec::make_atom({it->first, it->second});
+        return true;
     }
 
     patom value() const
     {
-        /* todo: map
-        int len = static_cast<int>(s->items.size());
-        if (s && !s->items.empty() && idx < len) {
-            return s->items[idx];
-        }
-        */
-
-        return {};
+        return curr;
     }
 
 private:
-    std::shared_ptr<const Map> s;
+    ref<const Map> s;
+    Map::items_type::const_iterator it;
+    bool started = false;
+    patom curr;
 };
 
 std::shared_ptr<AtomIterator> Map::iterator() const
 {
-    return std::make_shared<MapIterator>(shared_from_this());
+    return std::make_shared<MapIterator>(ref<const Map>(this));
 }
 
-template <typename SeqT>
-struct ItemsIterator : public AtomIterator
+// walks the list's cells, so each step is O(1)
+struct ListIterator : public AtomIterator
 {
 public:
-    ItemsIterator(std::shared_ptr<const SeqT> s) :
-        s(s)
+    ListIterator(ref<const List> s) :
+        s(s), it(s->items.begin())
     {}
 
     bool next()
     {
-        int len = static_cast<int>(s->items.size());
-        if (s && !s->items.empty() && idx < len - 1) {
-            idx++;
+        if (!started) {
+            started = true;
+            return it != s->items.end();
+        } else if (it != s->items.end() && std::next(it) != s->items.end()) {
+            ++it;
             return true;
         }
 
@@ -238,88 +609,65 @@ public:
 
     patom value() const
     {
-        int len = static_cast<int>(s->items.size());
-        if (s && !s->items.empty() && idx < len) {
-            return s->items[idx];
+        if (started && it != s->items.end()) {
+            return *it;
         }
 
         return {};
     }
 
 private:
-    std::shared_ptr<const SeqT> s;
-    int idx = -1;
+    ref<const List> s;
+    plist<patom>::const_iterator it;
+    bool started = false;
 };
 
 std::shared_ptr<AtomIterator> List::iterator() const
 {
-    return std::make_shared<ItemsIterator<List>>(shared_from_this());
+    return std::make_shared<ListIterator>(ref<const List>(this));
 }
 
-std::shared_ptr<AtomIterator> Vec::iterator() const
+// steps through the vec's leaves in turn, rather than finding each
+// item from the root
+struct VecIterator : public AtomIterator
 {
-    return std::make_shared<ItemsIterator<Vec>>(shared_from_this());
-}
-
-template <>
-std::shared_ptr<Map> get<Map>(patom atom) {
-    if (auto p = std::dynamic_pointer_cast<Map>(get<Seq>(atom))) {
-        return p;
-    } else {
-        throw std::bad_variant_access();
-    }
-}
-
-template <>
-std::shared_ptr<List> get<List>(patom atom) {
-    if (auto p = std::dynamic_pointer_cast<List>(get<Seq>(atom))) {
-        return p;
-    } else {
-        throw std::bad_variant_access();
-    }
-}
+public:
+    VecIterator(ref<const Vec> s) :
+        s(s), it(s->items.begin()), end(s->items.end())
+    {}
 
-template <>
-std::shared_ptr<Vec> get<Vec>(patom atom) {
-    if (auto p = std::dynamic_pointer_cast<Vec>(get<Seq>(atom))) {
-        return p;
-    } else {
-        throw std::bad_variant_access();
-    }
-}
+    bool next()
+    {
+        if (!started) {
+            started = true;
+            return it != end;
+        } else if (end - it > 1) {
+            ++it;
+            return true;
+        }
 
-template <>
-std::shared_ptr<Map> get_if<Map>(patom atom) noexcept {
-    if (auto seq = get_if<Seq>(atom)) {
-        return std::dynamic_pointer_cast<Map>(seq);
+        return false;
     }
-    return {};
-}
 
-template <>
-std::shared_ptr<List> get_if<List>(patom atom) noexcept {
-    if (auto seq = get_if<Seq>(atom)) {
-        return std::dynamic_pointer_cast<List>(seq);
-    }
-    return {};
-}
+    patom value() const
+    {
+        if (started && it != end) {
+            return *it;
+        }
 
-template <>
-std::shared_ptr<Vec> get_if<Vec>(patom atom) noexcept {
-    if (auto seq = get_if<Seq>(atom)) {
-        return std::dynamic_pointer_cast<Vec>(seq);
+        return {};
     }
-    return {};
-}
 
-bool is_nil(patom a)
-{
-    return !a || *a == *Nil || a->p.index() == 0;
-}
+private:
+    ref<const Vec> s;
+    pvector<patom>::const_iterator it;
+    pvector<patom>::const_iterator end;
+    bool started = false;
+};
 
-bool truthy(patom a)
+std::shared_ptr<AtomIterator> Vec::iterator() const
 {
-    return !is_nil(a) && *a != *False;
+    return std::make_shared<VecIterator>(ref<const Vec>(this));
 }
 
 } // namespace csxp
@@ -0,0 +1,221 @@
+#include "csxp/env.h"
+#include "csxp/lib/lib.h"
+#include "csxp/reader.h"
+#include "nanobench.h"
+
+#include <tuple>
+
+using namespace std::literals;
+
+namespace {
+
+csxp::patom read_one(std::string_view str)
+{
+    for (auto val : csxp::reader(str, "internal-test"sv)) {
+        return val;
+    }
+    return {};
+}
+
+} // namespace
+
+void bench_eval(ankerl::nanobench::Config& cfg)
+{
+    auto env = csxp::createEnv();
+    csxp::lib::addCore(env.get());
+    csxp::lib::addMath(env.get());
+
+    // locals of a fn, a let inside it, and a closure over both
+    env->eval(read_one(R"-(
+            (defn locals [a b]
+              (let [c (+ a b)
+                    d (* c a)
+                    f (fn [x] (+ x a c))]
+                (+ a b c d (f d))))
+            )-"sv));
+
+    // a closure created on every call
+    env->eval(read_one("(defn adder [n] (fn [x] (+ x n)))"sv));
+
+    // nested destructuring of params
+    env->eval(read_one("(defn dist [[x1 y1] [x2 y2]] (+ x1 y1 x2 y2))"sv));
+
+    // a body per arity, and a variadic one
+    env->eval(read_one(R"-(
+            (defn argcount ([] 0) ([x] 1) ([x y] 2) ([x y & more]
+              (+ (argcount x y) (count more))))
+            )-"sv));
+
+    // one form of each collection kind, plus calls, so the
+    // per-form cost of dispatching on the seq type shows up
+    std::pair<const char*, std::string_view> forms[] = {
+            {"eval form: list call", "(+ 1 2)"sv},
+            {"eval form: nested calls", "(+ (* 2 3) (- 4 (inc 1)))"sv},
+            {"eval form: vec", "[1 2 3]"sv},
+            {"eval form: map", "{}"sv},
+            {"eval form: quoted list", "'(1 2 3)"sv},
+            {"eval form: fn with locals", "(locals 1 2)"sv},
+            {"eval form: closure per call", "((adder 1) 2)"sv},
+            {"eval form: destructured params", "(dist [1 2] [3 4])"sv},
+            {"eval form: multi-arity call", "(argcount 1 2)"sv},
+            {"eval form: variadic call", "(argcount 1 2 3 4 5)"sv},
+    };
+
+    for (auto& [name, str] : forms) {
+        auto form = read_one(str);
+
+        csxp::patom res;
+        cfg.minEpochIterations(100000).run(name, [&] {
+                                          res = env->eval(form);
+                                      })
+                .doNotOptimizeAway(&res);
+    }
+}
+
+void bench_reduce(ankerl::nanobench::Config& cfg)
+{
+    auto env = csxp::createEnv();
+    csxp::lib::addCore(env.get());
+    csxp::lib::addMath(env.get());
+
+    // a higher-order builtin calling back for each item
+    env->eval(read_one("(def ones (take 1000 (repeat 1)))"sv));
+
+    std::pair<const char*, std::string_view> forms[] = {
+            {"reduce 1000 (builtin)", "(reduce + ones)"sv},
+            {"reduce 1000 (fn)", "(reduce (fn [a b] (+ a b)) ones)"sv},
+    };
+
+    for (auto& [name, str] : forms) {
+        auto form = read_one(str);
+
+        csxp::patom res;
+        cfg.minEpochIterations(1000).run(name, [&] {
+                                      res = env->eval(form);
+                                  })
+                .doNotOptimizeAway(&res);
+    }
+}
+
+void bench_engines(ankerl::nanobench::Config& cfg)
+{
+    // fns calling fns, which the vm calls directly
+    std::pair<const char*, csxp::Engine> engines[] = {
+            {"fib 15", csxp::Engine::tree},
+            {"fib 15 (vm)", csxp::Engine::vm},
+    };
+
+    for (auto& [name, engine] : engines) {
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        env->eval(read_one(R"-(
+                (defn fib [n]
+                  (if (< n 2)
+                    n
+                    (+ (fib (- n 1)) (fib (- n 2)))))
+                )-"sv));
+
+        auto form = read_one("(fib 15)"sv);
+
+        csxp::patom res;
+        cfg.minEpochIterations(20).run(name, [&] {
+                                      res = env->eval(form);
+                                  })
+                .doNotOptimizeAway(&res);
+    }
+
+    // iteration, rebinding in place rather than calling; with ^long
+    // hints, the math runs on the nums without calling the builtins
+    constexpr auto sum = R"-(
+            (defn sum [n]
+              (loop [i 0 acc 0]
+                (if (= i n) acc (recur (+ i 1) (+ acc i)))))
+            )-"sv;
+    constexpr auto hinted = R"-(
+            (defn sum [^long n]
+              (loop [^long i 0 ^long acc 0]
+                (if (< i n) (recur (+ i 1) (+ acc i)) acc)))
+            )-"sv;
+
+    std::tuple<const char*, csxp::Engine, std::string_view> loops[] = {
+            {"loop 1000", csxp::Engine::tree, sum},
+            {"loop 1000 (vm)", csxp::Engine::vm, sum},
+            {"loop 1000 ^long", csxp::Engine::tree, hinted},
+            {"loop 1000 ^long (vm)", csxp::Engine::vm, hinted},
+    };
+
+    for (auto& [name, engine, defn] : loops) {
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        env->eval(read_one(defn));
+
+        auto form = read_one("(sum 1000)"sv);
+
+        csxp::patom res;
+        cfg.minEpochIterations(20).run(name, [&] {
+                                      res = env->eval(form);
+                                  })
+                .doNotOptimizeAway(&res);
+    }
+
+    // walking a list with first and rest, each rest sharing its cells
+    std::pair<const char*, csxp::Engine> walks[] = {
+            {"walk list 1000", csxp::Engine::tree},
+            {"walk list 1000 (vm)", csxp::Engine::vm},
+    };
+
+    for (auto& [name, engine] : walks) {
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        env->eval(read_one(R"-(
+                (def xs
+                  (loop [i 0 acc '()]
+                    (if (= i 1000) acc (recur (+ i 1) (conj acc i)))))
+                )-"sv));
+        env->eval(read_one(R"-(
+                (defn walk [xs]
+                  (loop [xs xs acc 0]
+                    (if (seq xs) (recur (rest xs) (+ acc (first xs))) acc)))
+                )-"sv));
+
+        auto form = read_one("(walk xs)"sv);
+
+        csxp::patom res;
+        cfg.minEpochIterations(20).run(name, [&] {
+                                      res = env->eval(form);
+                                  })
+                .doNotOptimizeAway(&res);
+    }
+
+    // building a vec, persistently and through a transient
+    std::pair<const char*, std::string_view> builds[] = {
+            {"build vec 10000 with conj", R"-(
+                (loop [i 0 v []]
+                  (if (= i 10000) v (recur (+ i 1) (conj v i))))
+                )-"sv},
+            {"build vec 10000 with conj!", R"-(
+                (loop [i 0 v (transient [])]
+                  (if (= i 10000) (persistent! v) (recur (+ i 1) (conj! v i))))
+                )-"sv},
+    };
+
+    for (auto& [name, code] : builds) {
+        auto env = csxp::createEnv(csxp::Engine::vm);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        auto form = read_one(code);
+
+        csxp::patom res;
+        cfg.minEpochIterations(20).run(name, [&] {
+                                      res = env->eval(form);
+                                  })
+                .doNotOptimizeAway(&res);
+    }
+}
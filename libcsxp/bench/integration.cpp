@@ -1,8 +1,12 @@
 #include "csxp/env.h"
+#include "csxp/lib/detail/analyze.h"
+#include "csxp/lib/detail/callcache.h"
 #include "csxp/lib/lib.h"
 #include "csxp/reader.h"
 #include "nanobench.h"
 
+#include <iostream>
+
 using namespace std::literals;
 
 auto str = R"-(
@@ -75,22 +79,61 @@ void bench_read_run(ankerl::nanobench::Config& cfg)
                                    })
                 .doNotOptimizeAway(&res);
     }
-    {
+    std::pair<const char*, csxp::Engine> engines[] = {
+            {"run logic blob (no read)", csxp::Engine::tree},
+            {"run logic blob (no read, vm)", csxp::Engine::vm},
+    };
+
+    for (auto& [name, engine] : engines) {
         std::vector<csxp::patom> atoms;
         for (auto val : csxp::reader(str, "internal-test"sv)) {
             atoms.emplace_back(val);
         }
 
-        auto env = csxp::createEnv();
+        auto env = csxp::createEnv(engine);
         csxp::lib::addCore(env.get());
         csxp::lib::addMath(env.get());
 
         csxp::patom res;
-        cfg.minEpochIterations(105).run("run logic blob (no read)", [&] {
+        cfg.minEpochIterations(105).run(name, [&] {
                                        for (auto& atom : atoms) {
                                            res = env->eval(atom);
                                        }
                                    })
                 .doNotOptimizeAway(&res);
+
+        // just the calls, with the fns already defined
+        auto call = *csxp::reader("(and (f) (g))"sv, "internal-test"sv).begin();
+        cfg.minEpochIterations(105).run(std::string(name) + " calls only", [&] {
+                                       res = env->eval(call);
+                                   })
+                .doNotOptimizeAway(&res);
+
+        // how often the call sites in f and g saw the callee they cached
+        namespace callcache = csxp::lib::detail::callcache;
+        callcache::resetStats();
+        for (int i = 0; i < 100; i++) {
+            env->eval(call);
+        }
+
+        auto calls = callcache::stats();
+        std::cout << name << " call sites: " << calls.hits << " hits, "
+                  << calls.misses << " misses\n";
     }
+
+    // what analysis folds into constants in one run of the blob
+    namespace analyze = csxp::lib::detail::analyze;
+    analyze::resetFoldStats();
+    {
+        auto env = csxp::createEnv();
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+        for (auto val : csxp::reader(str, "internal-test"sv)) {
+            env->eval(val);
+        }
+    }
+
+    auto stats = analyze::foldStats();
+    std::cout << "logic blob folded: " << stats.calls << " calls, "
+              << stats.vecs << " vecs, " << stats.branches << " branches\n";
 }
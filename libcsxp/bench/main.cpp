@@ -5,6 +5,11 @@
 
 // todo: better way than extern.
 
+extern void bench_engines(ankerl::nanobench::Config& cfg);
+extern void bench_eval(ankerl::nanobench::Config& cfg);
+extern void bench_phashmap(ankerl::nanobench::Config& cfg);
+extern void bench_pvector(ankerl::nanobench::Config& cfg);
+extern void bench_reduce(ankerl::nanobench::Config& cfg);
 extern void bench_read_run(ankerl::nanobench::Config& cfg);
 extern void bench_reading(ankerl::nanobench::Config& cfg);
 
@@ -14,6 +19,11 @@ int main()
 
     auto cfg = ankerl::nanobench::Config();
 
+    bench_eval(cfg);
+    bench_reduce(cfg);
+    bench_engines(cfg);
+    bench_phashmap(cfg);
+    bench_pvector(cfg);
     bench_read_run(cfg);
     bench_reading(cfg);
 }
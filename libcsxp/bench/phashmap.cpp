@@ -0,0 +1,92 @@
+#include "csxp/atom.h"
+#include "nanobench.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+void bench_phashmap(ankerl::nanobench::Config& cfg)
+{
+    using map = csxp::Map::items_type;
+
+    // a map of n nums to nums, built in place
+    auto build = [](std::size_t n) {
+        map res;
+        for (std::size_t i = 0; i < n; i++) {
+            auto key = csxp::Num::make_atom(static_cast<int>(i));
+            res.set(key, key);
+        }
+        return res;
+    };
+
+    std::pair<const char*, std::size_t> sizes[] = {
+            {"8", 8},
+            {"1K", 1000},
+            {"1M", 1000000},
+    };
+
+    for (auto& [name, n] : sizes) {
+        // fewer rounds for the bigger maps, which take longer per round
+        auto iters = n <= 1000 ? 1000 : 1;
+        auto label = [&](const char* what) {
+            return std::string("map ") + what + " " + name;
+        };
+
+        map res;
+        cfg.minEpochIterations(iters).run(label("build"), [&] {
+                                             res = build(n);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        // each step keeps the map it started from, as assoc in csxp does
+        auto src = build(n);
+        cfg.minEpochIterations(iters).run(label("assoc each"), [&] {
+                                             auto m = src;
+                                             for (std::size_t i = 0; i < n; i++) {
+                                                 m = m.assoc(csxp::Num::make_atom(static_cast<int>(i)), csxp::Nil);
+                                             }
+                                             res = std::move(m);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        cfg.minEpochIterations(iters).run(label("dissoc all"), [&] {
+                                             auto m = src;
+                                             for (std::size_t i = 0; i < n; i++) {
+                                                 m = m.dissoc(csxp::Num::make_atom(static_cast<int>(i)));
+                                             }
+                                             res = std::move(m);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        long sum = 0;
+        cfg.minEpochIterations(iters).run(label("get each"), [&] {
+                                             for (std::size_t i = 0; i < n; i++) {
+                                                 sum += src.find(csxp::Num::make_atom(static_cast<int>(i)))->num();
+                                             }
+                                         })
+                .doNotOptimizeAway(&sum);
+
+        cfg.minEpochIterations(iters).run(label("iterate"), [&] {
+                                             for (auto& [key, val] : src) {
+                                                 sum += val.num();
+                                             }
+                                         })
+                .doNotOptimizeAway(&sum);
+    }
+
+    // str keys hash their bytes once, and keep it
+    std::vector<csxp::patom> keys;
+    map strs;
+    for (int i = 0; i < 1000; i++) {
+        keys.push_back(csxp::Str::make_atom("key number " + std::to_string(i)));
+        strs.set(keys.back(), csxp::Num::make_atom(i));
+    }
+
+    long sum = 0;
+    cfg.minEpochIterations(1000).run("map get each str key 1K", [&] {
+                                        for (auto& key : keys) {
+                                            sum += strs.find(key)->num();
+                                        }
+                                    })
+            .doNotOptimizeAway(&sum);
+}
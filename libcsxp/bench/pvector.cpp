@@ -0,0 +1,84 @@
+#include "csxp/atom.h"
+#include "csxp/pvector.h"
+#include "nanobench.h"
+
+#include <cstddef>
+#include <string>
+
+void bench_pvector(ankerl::nanobench::Config& cfg)
+{
+    using vec = csxp::pvector<csxp::patom>;
+
+    // a vec of n nums, built in place
+    auto build = [](std::size_t n) {
+        vec res;
+        for (std::size_t i = 0; i < n; i++) {
+            res.push_back(csxp::Num::make_atom(static_cast<int>(i)));
+        }
+        return res;
+    };
+
+    std::pair<const char*, std::size_t> sizes[] = {
+            {"10", 10},
+            {"1K", 1000},
+            {"1M", 1000000},
+    };
+
+    for (auto& [name, n] : sizes) {
+        // fewer rounds for the bigger vecs, which take longer per round
+        auto iters = n <= 1000 ? 1000 : 1;
+        auto label = [&](const char* what) {
+            return std::string("vec ") + what + " " + name;
+        };
+
+        vec res;
+        cfg.minEpochIterations(iters).run(label("build"), [&] {
+                                             res = build(n);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        // each step keeps the vec it started from, as conj in csxp does
+        cfg.minEpochIterations(iters).run(label("conj"), [&] {
+                                             vec v;
+                                             for (std::size_t i = 0; i < n; i++) {
+                                                 v = v.conj(csxp::Num::make_atom(static_cast<int>(i)));
+                                             }
+                                             res = std::move(v);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        auto src = build(n);
+        cfg.minEpochIterations(iters).run(label("assoc each"), [&] {
+                                             auto v = src;
+                                             for (std::size_t i = 0; i < n; i++) {
+                                                 v = v.assoc(i, csxp::Nil);
+                                             }
+                                             res = std::move(v);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        cfg.minEpochIterations(iters).run(label("pop all"), [&] {
+                                             auto v = src;
+                                             while (!v.empty()) {
+                                                 v = v.pop();
+                                             }
+                                             res = std::move(v);
+                                         })
+                .doNotOptimizeAway(&res);
+
+        long sum = 0;
+        cfg.minEpochIterations(iters).run(label("nth each"), [&] {
+                                             for (std::size_t i = 0; i < n; i++) {
+                                                 sum += src[i].num();
+                                             }
+                                         })
+                .doNotOptimizeAway(&sum);
+
+        cfg.minEpochIterations(iters).run(label("iterate"), [&] {
+                                             for (auto& val : src) {
+                                                 sum += val.num();
+                                             }
+                                         })
+                .doNotOptimizeAway(&sum);
+    }
+}
@@ -1,13 +1,23 @@
 #include "csxp/env.h"
 #include "csxp/atom_fmt.h"
+#include "csxp/lib/detail/core.h"
+#include "csxp/lib/detail/macro.h"
+#include "csxp/lib/detail/special.h"
+#include "csxp/lib/detail/vm.h"
 #include "rw/logging.h"
 #include "fmt/format.h"
 
-#include <deque>
-#include <stack>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
 #include <string_view>
 // todo: compare map vs unordered_map perf
 #include <unordered_map>
+#include <vector>
 
 #define LOGGER() (rw::logging::get("env"))
 
@@ -15,22 +25,134 @@ using namespace std::literals;
 
 namespace csxp {
 
+namespace {
+
+// a stack of Ts, bump allocated from blocks. a push of n takes them from
+// the top block, or the next if it hasn't room, and a pop resets the top
+// to where it was. blocks are kept when popped past and never move, so
+// what's pushed stays put until it's popped.
+template <typename T>
+class Stack
+{
+public:
+    Stack() { blocks.emplace_back(block_size); }
+
+    std::size_t block() const { return curr; }
+    std::size_t top() const { return used; }
+
+    T* push(std::size_t n)
+    {
+        if (blocks[curr].size - used < n) {
+            curr++;
+            used = 0;
+            if (curr == blocks.size()) {
+                blocks.emplace_back(std::max(n, block_size));
+            } else if (blocks[curr].size < n) {
+                blocks[curr] = Block(n);
+            }
+        }
+
+        auto res = blocks[curr].items.get() + used;
+        used += n;
+        return res;
+    }
+
+    void reset(std::size_t block, std::size_t top)
+    {
+        curr = block;
+        used = top;
+    }
+
+    // for a stack only pushed one at a time, whose blocks are full up to
+    // the top, the last item pushed, or null if it's empty
+    T* back() const
+    {
+        if (used > 0) {
+            return blocks[curr].items.get() + used - 1;
+        } else if (curr > 0) {
+            auto& prev = blocks[curr - 1];
+            return prev.items.get() + prev.size - 1;
+        }
+
+        return nullptr;
+    }
+
+    // and popping it
+    void pop()
+    {
+        if (used == 0) {
+            curr--;
+            used = blocks[curr].size;
+        }
+        used--;
+    }
+
+private:
+    static constexpr std::size_t block_size = 4096;
+
+    struct Block
+    {
+        explicit Block(std::size_t size) :
+            items(std::make_unique<T[]>(size)), size(size) {}
+
+        std::unique_ptr<T[]> items;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks;
+    std::size_t curr = 0;
+    std::size_t used = 0;
+};
+
+// the lowest address the native stack of this thread may grow down
+// to, leaving room for what runs between checks of it (see enter).
+// null where it can't be found.
+const char* stackLimit()
+{
+    thread_local const char* limit = [] {
+        const char* res = nullptr;
+#ifdef __linux__
+        pthread_attr_t attr;
+        if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+            void* addr;
+            std::size_t size;
+            if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+                res = static_cast<const char*>(addr) +
+                        std::min<std::size_t>(size / 4, 64 * 1024);
+            }
+            pthread_attr_destroy(&attr);
+        }
+#endif
+        return res;
+    }();
+    return limit;
+}
+
+} // namespace
+
 struct EnvImpl final : public Env
 {
 public:
-    EnvImpl();
+    EnvImpl(Engine engine);
+    ~EnvImpl();
+
+    Engine engine() const { return engine_; }
 
     // TODO: namespaces need some love. what namespace are we in,
     // when a func blows up? see also nswhere.
 
     patom resolve(const SymName* name);
-    patom lexResolve(const SymName* name);
+    ref<Var> resolveVar(const SymName* name);
+    ref<Var> internVar(const SymName* name);
     patom eval(const patom& val);
-    void pushFrame(const Scope& scope);
+    Frame* pushFrame(std::size_t size, const std::vector<patom>* captured);
     void popFrame();
+    Frame* currFrame() const { return curr; }
+    std::size_t maxDepth() const { return depthLimit; }
+    void maxDepth(std::size_t depth) { depthLimit = depth; }
+    void enter();
+    void leave() { depth--; }
     void destructure(const patom& binding, const patom& val);
-    void pushScope();
-    void popScope();
     void setInternal(std::string_view name, const patom& val);
     void setInternal(const SymName* name,
             const patom& val);
@@ -39,178 +161,223 @@ public:
     std::shared_ptr<Module> createModule(std::string_view nsname);
     bool hasModule(std::string_view nsname);
     const std::string& currNs() const { return where; };
-    void currNs(std::string_view nsname) { where = nsname; }
+    void currNs(std::string_view nsname);
     void aliasNs(std::string_view nsname, std::string_view nstarget);
 
 private:
-    patom evalMap(const std::shared_ptr<Map>& map);
-    patom evalVec(const std::shared_ptr<Vec>& vec);
-    patom evalList(const std::shared_ptr<List>& lst);
-
-    std::unordered_map<std::string,
-            std::unordered_map<std::string, patom>>
-            namespaces;
-    std::unordered_map<std::string,
-            std::unordered_map<std::string, std::string>>
-            aliases;
-    std::unordered_map<std::string, patom> internal = {
-            {"true", True},
-            {"false", False},
-    };
+    patom evalMap(const ref<Map>& map);
+    patom evalVec(const ref<Vec>& vec);
+    patom evalList(const ref<List>& lst);
+    patom& slot(const Local* local);
+    const patom& captured(const Local* local) const;
+
+    ref<Var> findVar(const SymName* name, bool throwing);
 
-    std::stack<std::deque<Scope>> stack;
+    // keyed on interned symbols, which live forever
+    using NsMap = std::unordered_map<const SymName*, ref<Var>>;
+
+    std::unordered_map<const SymName*, NsMap> namespaces;
+    std::unordered_map<const SymName*,
+            std::unordered_map<const SymName*, const SymName*>>
+            aliases;
+    NsMap internal;
+
+    Engine engine_;
+    Stack<Frame> frames;
+    Stack<patom> values;
+    // top level code runs without a frame
+    Frame* curr = nullptr;
+    std::size_t depth = 0;
+    std::size_t depthLimit = default_max_depth;
     std::string where;
+    const SymName* whereSym = nullptr;
 };
 
-EnvImpl::EnvImpl()
+EnvImpl::EnvImpl(Engine engine) :
+    engine_(engine)
 {
-    // stack needs an initial frame
-    stack.emplace();
+    setInternal("true"sv, True);
+    setInternal("false"sv, False);
 }
 
-patom EnvImpl::resolve(const SymName* name)
+EnvImpl::~EnvImpl()
 {
-    const auto& sname = name->name;
+    // a defn's var holds its fn, whose code holds the var and caches
+    // the fns it calls; those cycles would keep them all alive. vars
+    // let go of their values first, then fns of their code.
+    std::vector<patom> vals;
+    auto take = [&](NsMap& vars) {
+        for (auto& [name, var] : vars) {
+            vals.push_back(std::move(var->val));
+        }
+    };
+    for (auto& [name, vars] : namespaces) {
+        take(vars);
+    }
+    take(internal);
 
-    // sure would be nice to be able to look up string_views
-    // in a string keyed unordered_map
-    std::string nspart;
-    std::string namepart;
+    for (auto& val : vals) {
+        if (auto call = get_if<Callable>(val)) {
+            call->clear();
+        }
+    }
+}
 
-    auto slash = sname.find('/');
-    if (slash != std::string::npos) {
-        nspart = sname.substr(0, slash);
+ref<Var> EnvImpl::findVar(const SymName* name, bool throwing)
+{
+    auto nssym = name->nssym;
+    auto basesym = name->basesym;
 
-        const auto& requires = aliases[where];
-        if (auto it = requires.find(nspart); it != requires.end()) {
-            nspart = it->second;
+    if (nssym) {
+        if (auto it = aliases.find(whereSym); it != aliases.end()) {
+            if (auto alias = it->second.find(nssym); alias != it->second.end()) {
+                nssym = alias->second;
+            }
         }
 
-        namepart = sname.substr(slash + 1);
-    } else {
-        namepart = sname;
-    }
-
-    patom res;
-    if (!nspart.empty()) {
-        if (auto it = namespaces.find(nspart); it != namespaces.end()) {
-            if (auto srch = it->second.find(namepart); srch != it->second.cend()) {
-                res = srch->second;
+        if (auto it = namespaces.find(nssym); it != namespaces.end()) {
+            if (auto srch = it->second.find(basesym); srch != it->second.cend()) {
+                return srch->second;
             }
-        } else {
+        } else if (throwing) {
             throw EnvError(fmt::format(
-                    "unable to find namespace {} for {}", nspart, sname));
+                    "unable to find namespace {} for {}", nssym->name, name->name));
         }
     } else {
-        // check scope next
-        auto& frame = stack.top();
-        for (auto it = frame.crbegin(); it != frame.crend(); it++) {
-            auto srch = it->find(namepart);
-            if (srch != it->cend()) {
-                res = srch->second;
-                break;
-            }
-        }
-
-        // check curr ns if we have one
-        if (!where.empty()) {
-            if (auto it = namespaces.find(where); it != namespaces.end()) {
-                if (auto srch = it->second.find(namepart); srch != it->second.cend()) {
-                    res = srch->second;
+        // locals were resolved by analysis, so check curr ns if we have one
+        if (whereSym) {
+            if (auto it = namespaces.find(whereSym); it != namespaces.end()) {
+                if (auto srch = it->second.find(basesym); srch != it->second.cend()) {
+                    return srch->second;
                 }
             }
         }
         // otherwise, check global ns
-        if (!res) {
-            if (auto srch = internal.find(namepart); srch != internal.cend()) {
-                res = srch->second;
-            }
+        if (auto srch = internal.find(basesym); srch != internal.cend()) {
+            return srch->second;
         }
     }
 
-    if (!res) {
-        throw EnvError(fmt::format(
-                "unable to find symbol {}", sname));
-    }
-
-    return res;
+    return {};
 }
 
-patom EnvImpl::lexResolve(const SymName* name)
+patom EnvImpl::resolve(const SymName* name)
 {
-    const auto& sname = name->name;
-
-    // namespaces mean not lexical scope
-    auto slash = sname.find('/');
-    if (slash == std::string::npos) {
-        // check scopes
-        auto& frame = stack.top();
-        for (auto it = frame.crbegin(); it != frame.crend(); it++) {
-            auto srch = it->find(sname);
-            if (srch != it->cend()) {
-                return srch->second;
-            }
-        }
+    auto var = findVar(name, true);
+    if (!var || !var->val) {
+        throw EnvError(fmt::format(
+                "unable to find symbol {}", name->name));
     }
 
-    return {};
+    return var->val;
 }
 
-patom EnvImpl::evalMap(const std::shared_ptr<Map>& map)
+ref<Var> EnvImpl::resolveVar(const SymName* name)
 {
-    auto resMap = std::make_shared<Map>();
+    return findVar(name, false);
+}
 
-    /* todo: map
-    var pairAtom atom.Atom
-    it := m.Iterator()
-    for it.Next() {
-        // assumes map is well formed, where each value is a vec pair
+ref<Var> EnvImpl::internVar(const SymName* name)
+{
+    auto nssym = name->nssym ? name->nssym : whereSym;
+    auto& vars = nssym ? namespaces[nssym] : internal;
+
+    auto& var = vars[name->basesym];
+    if (!var) {
+        // name the var by its qualified symbol
+        var = make_ref<Var>(SymName::intern(nssym ?
+                        fmt::format("{}/{}", nssym->name, name->basesym->name) :
+                        name->basesym->name));
+    }
 
-        if pairAtom, err = env.Eval(it.Value()); err != nil {
-            return
-        }
+    return var;
+}
 
-        pair := pairAtom.(*atom.Vec)
-        resMap = resMap.Assoc(pair.Items[0], pair.Items[1])
+patom EnvImpl::evalMap(const ref<Map>& map)
+{
+    if (is_literal(map)) {
+        return map;
     }
-    */
 
-    auto it = map->iterator();
-    while (it->next()) {
-        // todo: map
-        // resVec->items.push_back(eval(it->value()));
+    EnvDepth ed{this};
+
+    // built in place, as only this holds it so far
+    Map::items_type res;
+    for (auto& [key, val] : map->items) {
+        res.set(eval(key), eval(val));
     }
 
-    return std::make_shared<atom>(resMap);
+    return patom(make_ref<Map>(std::move(res)));
 }
 
-patom EnvImpl::evalVec(const std::shared_ptr<Vec>& vec)
+patom EnvImpl::evalVec(const ref<Vec>& vec)
 {
-    auto resVec = std::make_shared<Vec>();
+    // literals are shared; the result starts as the vec itself, and
+    // only the leaves holding items that aren't literals are copied
+    auto& items = vec->items;
+    auto it = std::find_if_not(items.begin(), items.end(), is_literal);
+    if (it == items.end()) {
+        return vec;
+    }
+
+    EnvDepth ed{this};
 
-    auto it = vec->iterator();
-    while (it->next()) {
-        resVec->items.push_back(eval(it->value()));
+    auto res = items;
+    for (; it != items.end(); it++) {
+        if (!is_literal(*it)) {
+            res.set(it - items.begin(), eval(*it));
+        }
     }
 
-    return std::make_shared<atom>(resVec);
+    return patom(make_ref<Vec>(std::move(res)));
 }
 
-patom EnvImpl::evalList(const std::shared_ptr<List>& lst)
+patom EnvImpl::evalList(const ref<List>& lst)
 {
-    // evaluate the first argument
-    auto it = lst->iterator();
+    auto& items = lst->items;
 
     // empty list, evals to self
-    if (!it->next()) {
-        return std::make_shared<atom>(lst);
+    if (items.empty()) {
+        return lst;
     }
 
-    auto first = it->value();
-    auto res = eval(first);
+    EnvDepth ed{this};
+
+    // evaluate the first argument
+    patom res;
+    if (auto head = get_if<SymName>(items[0])) {
+        // special forms run as they are, whatever their name resolves to
+        if (auto sf = lib::detail::special::of(head.get());
+                sf != lib::detail::special::form::none) {
+            return lib::detail::special::eval(this, sf, lst);
+        }
+
+        // and calls to macros are expanded, and the expansion run
+        auto var = findVar(head.get(), true);
+        if (var && var->macro && var->val) {
+            return eval(lib::detail::macro::expand(this, *var, *lst));
+        }
+
+        res = var ? var->val : patom();
+        if (!res) {
+            throw EnvError(fmt::format(
+                    "unable to find symbol {}", head->name));
+        }
+    } else {
+        res = eval(items[0]);
+    }
 
     if (auto call = get_if<Callable>(res)) {
+        if (!call->special) {
+            return apply(this, *call, std::next(items.begin()), items.end());
+        }
+
+        auto it = lst->iterator();
+        it->next();
         return (*call)(static_cast<Env*>(this), it.get());
+    } else if (get_if<Keyword>(res)) {
+        // a keyword looks itself up in the map it's called with
+        return apply(this, lib::detail::core::keyword_get, items.begin(), items.end());
     }
 
     throw EnvError("unable to cast first item of list to Callable");
@@ -222,47 +389,124 @@ patom EnvImpl::eval(const patom& val)
         return Nil;
     }
 
-    return std::visit(
-            [this, &val](auto&& p) -> patom {
-                using T = std::decay_t<decltype(p)>;
-                if constexpr (
-                        std::is_same_v<T, std::shared_ptr<std::monostate>> ||
-                        std::is_same_v<T, std::shared_ptr<Callable>> ||
-                        std::is_same_v<T, std::shared_ptr<Char>> ||
-                        std::is_same_v<T, std::shared_ptr<Const>> ||
-                        std::is_same_v<T, std::shared_ptr<Keyword>> ||
-                        std::is_same_v<T, std::shared_ptr<Num>> ||
-                        std::is_same_v<T, std::shared_ptr<Str>>) {
-                    return val;
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<SymName>>) {
-                    return resolve(p.get());
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Seq>>) {
-                    if (auto m = std::dynamic_pointer_cast<Map>(p)) {
-                        return evalMap(m);
-                    } else if (auto l = std::dynamic_pointer_cast<List>(p)) {
-                        return evalList(l);
-                    } else if (auto v = std::dynamic_pointer_cast<Vec>(p)) {
-                        return evalVec(v);
-                    } else {
-                        // todo: add type to msg
-                        throw EnvError("unexpected seq type in eval");
+    // immediates evaluate to themselves
+    auto obj = val.get();
+    if (!obj) {
+        return val;
+    }
+
+    switch (obj->objtype) {
+        case Object::type::callable:
+        case Object::type::konst:
+        case Object::type::keyword:
+        case Object::type::str:
+        case Object::type::transient:
+            return val;
+        case Object::type::local: {
+            auto local = static_cast<const Local*>(obj);
+            return local->captured ? captured(local) : slot(local);
+        }
+        case Object::type::node:
+            return static_cast<const Node*>(obj)->exec(this);
+        case Object::type::symname:
+            return resolve(static_cast<const SymName*>(obj));
+        case Object::type::var: {
+            auto var = static_cast<const Var*>(obj);
+            if (!var->val) {
+                throw EnvError(fmt::format(
+                        "unable to find symbol {}", var->sym->name));
+            }
+            return var->val;
+        }
+        case Object::type::seq: {
+            auto seq = static_cast<Seq*>(obj);
+            switch (seq->seqkind) {
+                case Seq::kind::list:
+                    // on the vm, lists and vecs are compiled and run
+                    // there; empty ones are left to eval to themselves
+                    if (engine_ == Engine::vm && !static_cast<List*>(seq)->items.empty()) {
+                        return lib::detail::vm::eval(this, val);
+                    }
+                    return evalList(ref<List>(static_cast<List*>(seq)));
+                case Seq::kind::map:
+                    return evalMap(ref<Map>(static_cast<Map*>(seq)));
+                case Seq::kind::vec:
+                    if (engine_ == Engine::vm && !static_cast<Vec*>(seq)->items.empty()) {
+                        return lib::detail::vm::eval(this, val);
                     }
-                } else {
+                    return evalVec(ref<Vec>(static_cast<Vec*>(seq)));
+                default:
                     // todo: add type to msg
-                    throw EnvError("unexpected type in eval");
-                }
-            },
-            val->p);
+                    throw EnvError("unexpected seq type in eval");
+            }
+        }
+        default:
+            // todo: add type to msg
+            throw EnvError("unexpected type in eval");
+    }
+}
+
+void EnvImpl::enter()
+{
+    if (depth >= depthLimit) {
+        throw EnvError(fmt::format("max depth of {} exceeded", depthLimit));
+    }
+
+    // how much native stack a level takes varies with the build, so
+    // the thread's own stack is checked too
+    char here;
+    if (auto limit = stackLimit(); limit && &here < limit) {
+        throw EnvError(fmt::format("native stack exhausted at depth {}", depth));
+    }
+
+    depth++;
 }
 
-void EnvImpl::pushFrame(const Scope& scope)
+Frame* EnvImpl::pushFrame(std::size_t size, const std::vector<patom>* captured)
 {
-    stack.push({scope});
+    enter();
+
+    auto block = values.block();
+    auto top = values.top();
+
+    curr = frames.push(1);
+    *curr = Frame{values.push(size), size, captured};
+    curr->block = block;
+    curr->top = top;
+    return curr;
 }
 
 void EnvImpl::popFrame()
 {
-    stack.pop();
+    // let go of the locals now, rather than when the slots are reused
+    std::fill_n(curr->slots, curr->size, patom());
+    values.reset(curr->block, curr->top);
+
+    frames.pop();
+    curr = frames.back();
+    leave();
+}
+
+patom& EnvImpl::slot(const Local* local)
+{
+    auto frame = curr;
+    if (!frame || local->captured || local->slot >= frame->size) {
+        throw EnvError(fmt::format(
+                "no frame slot for local {}", local->sym->name));
+    }
+
+    return frame->slots[local->slot];
+}
+
+const patom& EnvImpl::captured(const Local* local) const
+{
+    auto frame = curr;
+    if (!frame || !frame->captured || local->slot >= frame->captured->size()) {
+        throw EnvError(fmt::format(
+                "no captured value for local {}", local->sym->name));
+    }
+
+    return (*frame->captured)[local->slot];
 }
 
 void EnvImpl::destructure(const patom& binding, const patom& val)
@@ -270,131 +514,89 @@ void EnvImpl::destructure(const patom& binding, const patom& val)
     // todo: check for nil binding?
 
     // todo: refactor
-    std::visit(
-            [this, &val](auto&& binding) {
-                using T = std::decay_t<decltype(binding)>;
-                if constexpr (std::is_same_v<T, std::shared_ptr<SymName>>) {
-                    auto& frame = stack.top();
-                    if (!frame.empty()) {
-                        frame.back()[binding->name] = val;
-                    } else {
-                        throw EnvError("attempted to set scope when scope stack was empty");
-                    }
-                } else if constexpr (std::is_same_v<T, std::shared_ptr<Seq>>) {
-                    if (auto bindvec = std::dynamic_pointer_cast<Vec>(binding)) {
-                        if (auto seq = get_if<Seq>(val)) {
-                            auto valit = seq->iterator();
-
-                            for (std::size_t i = 0; i < bindvec->items.size(); i++) {
-                                auto b = bindvec->items[i];
-
-                                bool handled = std::visit(
-                                        [this, &bindvec, &val, &valit, &i, &b](auto&& v) -> bool {
-                                            using T = std::decay_t<decltype(v)>;
-                                            if constexpr (std::is_same_v<T, std::shared_ptr<SymName>>) {
-                                                if (v->name == "&"sv) {
-                                                    if (i > bindvec->items.size() - 2) {
-                                                        throw EnvError("destructuring & requires a symbol");
-                                                    }
-
-                                                    // get / consume the symbol
-                                                    i++;
-                                                    b = bindvec->items[i];
-
-                                                    if (std::holds_alternative<std::shared_ptr<SymName>>(b->p)) {
-                                                        auto vec = std::make_shared<Vec>();
-                                                        while (valit->next()) {
-                                                            vec->items.push_back(valit->value());
-                                                        }
-
-                                                        destructure(b, std::make_shared<atom>(vec));
-                                                        return true;
-                                                    }
-                                                }
-                                            } else if constexpr (std::is_same_v<T, std::shared_ptr<Keyword>>) {
-                                                if (v->name == ":as"sv) {
-                                                    if (i > bindvec->items.size() - 2) {
-                                                        throw EnvError("destructuring :as requires a symbol");
-                                                    }
-
-                                                    // get / consume the symbol
-                                                    i++;
-                                                    b = bindvec->items[i];
-
-                                                    // bind symbol to incoming value
-                                                    destructure(b, val);
-                                                    return true;
-                                                }
-                                            }
-                                            return false;
-                                        },
-                                        b->p);
-
-                                if (!handled) {
-                                    patom valval;
-                                    if (valit->next()) {
-                                        valval = valit->value();
-                                    } else {
-                                        valval = Nil;
-                                    }
-
-                                    destructure(b, valval);
+    if (auto local = get_if<Local>(binding)) {
+        slot(local.get()) = val;
+    } else if (auto seq = get_if<Seq>(binding)) {
+        if (auto bindvec = ref<Vec>(seq_cast<Vec>(seq.get()))) {
+            if (auto seq = get_if<Seq>(val)) {
+                auto valit = seq->iterator();
+
+                for (std::size_t i = 0; i < bindvec->items.size(); i++) {
+                    auto b = bindvec->items[i];
+
+                    bool handled = false;
+                    if (auto v = get_if<SymName>(b)) {
+                        if (v->name == "&"sv) {
+                            if (i > bindvec->items.size() - 2) {
+                                throw EnvError("destructuring & requires a symbol");
+                            }
+
+                            // get / consume the symbol
+                            i++;
+                            b = bindvec->items[i];
+
+                            if (get_if<Local>(b)) {
+                                auto vec = make_ref<Vec>();
+                                while (valit->next()) {
+                                    vec->items.push_back(valit->value());
                                 }
+
+                                destructure(b, vec);
+                                handled = true;
                             }
-                        } else {
-                            throw EnvError("destructuring vector, unable to iterate over arg");
                         }
-                    } else {
-                        throw EnvError("unexpected seq type for destructure binding");
+                    } else if (auto v = get_if<Keyword>(b)) {
+                        if (v->name == ":as"sv) {
+                            if (i > bindvec->items.size() - 2) {
+                                throw EnvError("destructuring :as requires a symbol");
+                            }
+
+                            // get / consume the symbol
+                            i++;
+                            b = bindvec->items[i];
+
+                            // bind symbol to incoming value
+                            destructure(b, val);
+                            handled = true;
+                        }
                     }
-                } else {
-                    // for map:
-                    // TODO: destructure map
-                    // TODO: :keys, :strs and :syms
 
-                    throw EnvError("unexpected type for destructure binding");
-                }
-            },
-            binding->p);
-}
+                    if (!handled) {
+                        patom valval;
+                        if (valit->next()) {
+                            valval = valit->value();
+                        } else {
+                            valval = Nil;
+                        }
 
-void EnvImpl::pushScope()
-{
-    stack.top().emplace_back();
-}
+                        destructure(b, valval);
+                    }
+                }
+            } else {
+                throw EnvError("destructuring vector, unable to iterate over arg");
+            }
+        } else {
+            throw EnvError("unexpected seq type for destructure binding");
+        }
+    } else {
+        // for map:
+        // TODO: destructure map
+        // TODO: :keys, :strs and :syms
 
-void EnvImpl::popScope()
-{
-    stack.top().pop_back();
+        throw EnvError("unexpected type for destructure binding");
+    }
 }
 
 void EnvImpl::setInternal(std::string_view name, const patom& val)
 {
-    // sure would be nice to be able to look up string_views
-    // in a string keyed unordered_map
-    std::string nspart;
-    std::string namepart;
-
-    auto slash = name.find('/');
-    if (slash != std::string::npos) {
-        nspart = name.substr(0, slash);
-        namepart = name.substr(slash + 1);
-    } else {
-        nspart = where;
-        namepart = name;
-    }
-
-    if (!nspart.empty()) {
-        namespaces[nspart][namepart] = val;
-    } else {
-        internal[namepart] = val;
-    }
+    setInternal(SymName::intern(name).get(), val);
 }
 
 void EnvImpl::setInternal(const SymName* name,
         const patom& val)
 {
-    setInternal(name->name, val);
+    // update in place, so anything bound to the var sees it
+    internVar(name)->val = val;
 }
 
 void EnvImpl::registerModule(std::string_view nsname,
@@ -423,26 +625,113 @@ struct ModuleImpl : public Module
 
 std::shared_ptr<Module> EnvImpl::createModule(std::string_view nsname)
 {
-    namespaces[std::string(nsname)] = {};
+    namespaces[SymName::intern(nsname).get()] = {};
     return std::make_shared<ModuleImpl>(static_cast<Env*>(this), nsname);
 }
 
 bool EnvImpl::hasModule(std::string_view nsname)
 {
-    // ugh.
-    return namespaces.find(std::string(nsname)) != namespaces.end();
+    return namespaces.find(SymName::intern(nsname).get()) != namespaces.end();
 }
 
 // todo: swap args, like "alias X as x"
 void EnvImpl::aliasNs(std::string_view nsname, std::string_view nstarget)
 {
-    // ugh. allocating here sucks.
-    aliases[where][std::string(nsname)] = nstarget;
+    aliases[whereSym][SymName::intern(nsname).get()] =
+            SymName::intern(nstarget).get();
+}
+
+void EnvImpl::currNs(std::string_view nsname)
+{
+    where = nsname;
+    whereSym = nsname.empty() ? nullptr : SymName::intern(nsname).get();
+}
+
+namespace {
+
+// vecs nested deeper than this are taken to be code, and evaluated, so
+// checking doesn't recurse without bound
+constexpr int max_literal_depth = 16;
+
+bool is_literal(const patom& val, int depth)
+{
+    auto obj = val.get();
+    if (!obj) {
+        return true;
+    }
+
+    switch (obj->objtype) {
+        case Object::type::callable:
+        case Object::type::konst:
+        case Object::type::keyword:
+        case Object::type::str:
+            return true;
+        case Object::type::seq:
+            switch (static_cast<const Seq*>(obj)->seqkind) {
+                case Seq::kind::list:
+                    return static_cast<const List*>(obj)->items.empty();
+                case Seq::kind::map: {
+                    if (depth == max_literal_depth) {
+                        return false;
+                    }
+
+                    auto& items = static_cast<const Map*>(obj)->items;
+                    return std::all_of(items.begin(), items.end(), [&](auto& entry) {
+                        return is_literal(entry.first, depth + 1) &&
+                               is_literal(entry.second, depth + 1);
+                    });
+                }
+                case Seq::kind::vec: {
+                    if (depth == max_literal_depth) {
+                        return false;
+                    }
+
+                    auto& items = static_cast<const Vec*>(obj)->items;
+                    return std::all_of(items.begin(), items.end(),
+                            [&](auto& item) { return is_literal(item, depth + 1); });
+                }
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool is_literal(const patom& val)
+{
+    return is_literal(val, 0);
+}
+
+patom apply(Env* env, Callable& call, AtomIterator* args)
+{
+    constexpr std::size_t small = 8;
+
+    patom vals[small];
+    std::vector<patom> more;
+
+    std::size_t nargs = 0;
+    while (args->next()) {
+        auto val = args->evaluated() ? args->value() : env->eval(args->value());
+        if (nargs < small) {
+            vals[nargs] = std::move(val);
+        } else {
+            if (more.empty()) {
+                more.assign(vals, vals + small);
+            }
+            more.push_back(std::move(val));
+        }
+        nargs++;
+    }
+
+    return call.call(env, nargs > small ? more.data() : vals, nargs);
 }
 
-std::shared_ptr<Env> createEnv()
+std::shared_ptr<Env> createEnv(Engine engine)
 {
-    return std::make_shared<EnvImpl>();
+    return std::make_shared<EnvImpl>(engine);
 }
 
 } // namespace csxp
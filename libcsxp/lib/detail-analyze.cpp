@@ -0,0 +1,1175 @@
+#include "csxp/atom_fmt.h"
+#include "csxp/env.h"
+#include "csxp/lib/detail/analyze.h"
+#include "csxp/lib/detail/core.h"
+#include "csxp/lib/detail/lazy.h"
+#include "csxp/lib/detail/macro.h"
+#include "csxp/lib/detail/math.h"
+#include "csxp/lib/detail/node.h"
+#include "csxp/lib/detail/special.h"
+#include "csxp/lib/lib.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
+
+namespace csxp::lib::detail::analyze {
+
+namespace {
+
+// symbols and values the analyzer compiles with. the values are
+// shared by the code of every env, so they're pinned, as interned
+// symbols are.
+struct Heads
+{
+    Heads()
+    {
+        lazySeqFn.get()->pin();
+        keywordFn.get()->pin();
+    }
+
+    ref<SymName> amp = SymName::intern("&"sv);
+    // metadata, as ^long before a binding; the reader leaves it as is
+    ref<SymName> caret = SymName::intern("^"sv);
+    ref<SymName> long_ = SymName::intern("long"sv);
+    ref<SymName> let = SymName::intern(special::name(special::form::let));
+    ref<SymName> loop = SymName::intern(special::name(special::form::loop));
+
+    // lazy-seq compiles to a call of this, with its body as a fn
+    patom lazySeqFn = make_fn(lazy::lazy_seq_fn);
+    // and a keyword called as a fn to a call of this, with the keyword
+    // as the first arg
+    patom keywordFn = make_pure_fn(core::keyword_get);
+};
+
+const Heads& heads()
+{
+    static Heads heads;
+    return heads;
+}
+
+struct Folded
+{
+    std::atomic<std::uint64_t> vecs = 0;
+    std::atomic<std::uint64_t> calls = 0;
+    std::atomic<std::uint64_t> branches = 0;
+};
+
+Folded folded;
+
+// a local declared in a scope
+struct Name
+{
+    const SymName* sym;
+    std::uint32_t slot;
+    Local::hint hinted;
+};
+
+// locals visible in the fn (or top level let) being analyzed. lets
+// inside it add names, which go out of sight at the end of the let,
+// but never give back their slots. locals of enclosing fns are
+// captured, copied into the fn when it's created.
+struct FnScope
+{
+    FnScope(Env* env, FnScope* outer) :
+        env(env), outer(outer) {}
+
+    // globals are bound to their vars in this env
+    Env* env;
+    FnScope* outer;
+    std::vector<Name> names;
+    std::uint32_t framesize = 0;
+    // what each captured value is copied from, as Locals of outer
+    std::vector<patom> captures;
+    // the fn's params, as declared
+    std::vector<patom> params;
+    // what a recur rebinds: the targets of the innermost loop, or
+    // params. null outside any fn or loop.
+    const std::vector<patom>* recur = nullptr;
+    // the var a defn is binding the fn to, if any; a call to it in tail
+    // position may recur
+    ref<Var> self;
+};
+
+// tail is whether val's value is the value of the innermost loop (or
+// the fn), so it can recur
+patom form(FnScope* scope, const patom& val, bool tail = false);
+patom callOf(FnScope* scope, const ref<List>& lst, patom callee,
+        std::vector<patom> args, bool tail);
+
+// a name declared in scope itself, if any
+const Name* declared(FnScope* scope, const ref<SymName>& sym)
+{
+    for (auto it = scope->names.crbegin(); it != scope->names.crend(); it++) {
+        if (it->sym == sym.get()) {
+            return &*it;
+        }
+    }
+
+    return nullptr;
+}
+
+// resolves a local, capturing it into scope (and every fn between) if
+// it belongs to an enclosing fn
+patom lookup(FnScope* scope, const ref<SymName>& sym)
+{
+    if (!scope) {
+        return {};
+    } else if (auto name = declared(scope, sym)) {
+        return Local::make_atom(sym, false, name->slot, name->hinted);
+    }
+
+    for (std::size_t i = 0; i < scope->captures.size(); i++) {
+        if (auto local = get<Local>(scope->captures[i]); local->sym == sym) {
+            return Local::make_atom(sym, true, static_cast<std::uint32_t>(i),
+                    local->hinted);
+        }
+    }
+
+    auto outer = lookup(scope->outer, sym);
+    if (!outer) {
+        return {};
+    }
+
+    auto hinted = get<Local>(outer)->hinted;
+    scope->captures.push_back(std::move(outer));
+    return Local::make_atom(sym, true,
+            static_cast<std::uint32_t>(scope->captures.size() - 1), hinted);
+}
+
+bool isLocal(FnScope* scope, const ref<SymName>& sym)
+{
+    for (; scope; scope = scope->outer) {
+        if (declared(scope, sym)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::uint32_t declareLocal(FnScope* scope, const ref<SymName>& sym,
+        Local::hint hinted = Local::hint::none)
+{
+    if (sym->nssym) {
+        throw LibError(fmt::format(
+                "unable to bind qualified symbol {}", sym->name));
+    }
+
+    auto slot = scope->framesize++;
+    scope->names.push_back({sym.get(), slot, hinted});
+    return slot;
+}
+
+// the items of a binding vec without their metadata, and the hint each
+// has. ^long is the only hint that's used; any other metadata is
+// dropped.
+struct Hinted
+{
+    std::vector<patom> items;
+    std::vector<Local::hint> hints;
+};
+
+Hinted hinted(const Vec& vec)
+{
+    Hinted res;
+    auto hint = Local::hint::none;
+    for (std::size_t i = 0; i < vec.items.size(); i++) {
+        auto& item = vec.items[i];
+        if (get_if<SymName>(item) == heads().caret) {
+            if (i + 2 >= vec.items.size()) {
+                throw LibError("metadata requires a binding after it");
+            }
+
+            if (get_if<SymName>(vec.items[++i]) == heads().long_) {
+                hint = Local::hint::long_;
+            }
+            continue;
+        }
+
+        res.items.push_back(item);
+        res.hints.push_back(hint);
+        hint = Local::hint::none;
+    }
+
+    return res;
+}
+
+// the local a vec binding names with :as, if any
+ref<SymName> bindingAs(const Vec& vec)
+{
+    for (std::size_t i = 0; i < vec.items.size(); i++) {
+        if (auto kw = get_if<Keyword>(vec.items[i]); kw && kw->name == ":as"sv) {
+            auto sym = i + 1 < vec.items.size() ?
+                    get_if<SymName>(vec.items[i + 1]) :
+                    ref<SymName>();
+            if (!sym) {
+                throw LibError("destructuring :as requires a symbol");
+            }
+            return sym;
+        }
+    }
+
+    return {};
+}
+
+void plan(FnScope* scope, node::BindNode& res, const Vec& vec, std::uint32_t src);
+
+// adds the step taking an item (or the rest) of src into target
+void step(FnScope* scope, node::BindNode& res, node::BindNode::Op op,
+        const patom& target, std::uint32_t src, std::uint32_t idx)
+{
+    if (auto sym = get_if<SymName>(target); sym && sym != heads().amp) {
+        res.steps.push_back({op, declareLocal(scope, sym), src, idx});
+    } else if (auto vec = get_if<Vec>(target)) {
+        auto as = bindingAs(*vec);
+        auto dst = as ? declareLocal(scope, as) : scope->framesize++;
+        res.steps.push_back({op, dst, src, idx});
+        plan(scope, res, *vec, dst);
+    } else {
+        throw LibError(fmt::format(
+                "unexpected destructure binding {}", target));
+    }
+}
+
+// adds the steps destructuring the seq in src by vec
+void plan(FnScope* scope, node::BindNode& res, const Vec& vec, std::uint32_t src)
+{
+    auto& items = vec.items;
+
+    std::uint32_t idx = 0;
+    for (std::size_t i = 0; i < items.size(); i++) {
+        auto& item = items[i];
+        if (auto kw = get_if<Keyword>(item)) {
+            if (kw->name != ":as"sv) {
+                throw LibError(fmt::format(
+                        "unexpected destructure binding {}", item));
+            }
+
+            // declared with the vec's own slot
+            i++;
+        } else if (get_if<SymName>(item) == heads().amp) {
+            if (i + 1 >= items.size()) {
+                throw LibError("destructuring & requires a symbol");
+            }
+
+            step(scope, res, node::BindNode::Op::rest, items[++i], src, idx);
+        } else {
+            step(scope, res, node::BindNode::Op::nth, item, src, idx++);
+        }
+    }
+}
+
+// declares the symbols in a binding target, returning the target with
+// the symbols replaced by their slots, and vecs by their plans. only a
+// plain symbol takes a hint.
+patom declare(FnScope* scope, const patom& binding,
+        Local::hint hint = Local::hint::none)
+{
+    if (auto sym = get_if<SymName>(binding)) {
+        if (sym == heads().amp) {
+            return binding;
+        }
+
+        return Local::make_atom(sym, false, declareLocal(scope, sym, hint), hint);
+    } else if (auto vec = get_if<Vec>(binding)) {
+        auto as = bindingAs(*vec);
+        auto slot = as ? declareLocal(scope, as) : scope->framesize++;
+
+        auto res = make_ref<node::BindNode>(binding, slot);
+        plan(scope, *res, *vec, slot);
+        return res;
+    }
+
+    // let destructure complain about it at runtime
+    return binding;
+}
+
+// whether compiled code gives a long without a check: a num, or a
+// ^long local
+bool isLong(const patom& code)
+{
+    if (code.is_num()) {
+        return true;
+    } else if (auto local = get_if<Local>(code)) {
+        return local->hinted == Local::hint::long_;
+    } else if (auto obj = code.get(); obj && obj->objtype == Object::type::node &&
+            static_cast<const Node*>(obj)->nodekind == Node::kind::konst) {
+        return static_cast<const node::ConstNode*>(obj)->val.is_num();
+    }
+
+    return false;
+}
+
+// code giving a value for a ^long local, checking it's a num
+patom check(const Local& local, patom code)
+{
+    auto obj = code.get();
+    auto form = obj && obj->objtype == Object::type::node ?
+            static_cast<const Node*>(obj)->form :
+            code;
+    return patom(make_ref<node::HintNode>(std::move(form), std::move(code), local.sym));
+}
+
+// code bound to a target, checked if the target is a ^long local and
+// the code may give something else
+patom checked(const patom& target, patom code)
+{
+    auto local = get_if<Local>(target);
+    if (!local || local->hinted != Local::hint::long_ || isLong(code)) {
+        return code;
+    }
+
+    return check(*local, std::move(code));
+}
+
+using form_iterator = plist<patom>::const_iterator;
+
+// compiles the forms of a body; more than one runs as a do. only the
+// last is in tail position.
+patom body(FnScope* scope, form_iterator begin, form_iterator end, bool tail)
+{
+    if (begin == end) {
+        return Nil;
+    } else if (std::next(begin) == end) {
+        return form(scope, *begin, tail);
+    }
+
+    std::vector<patom> res;
+    for (auto it = begin; it != end; it++) {
+        res.push_back(form(scope, *it, tail && std::next(it) == end));
+    }
+    return patom(make_ref<node::DoNode>(patom(), std::move(res)));
+}
+
+// compiles a body of a fn. the fn's captures so far are passed in, and
+// back out with any the body adds, as its bodies share them.
+Analyzed bodyIn(Env* env, FnScope* outer, const Vec& params,
+        form_iterator begin, form_iterator end, ref<Var> self,
+        std::vector<patom>& captures)
+{
+    FnScope scope(env, outer);
+    scope.captures = std::move(captures);
+
+    auto [items, hints] = hinted(params);
+
+    Analyzed res;
+    res.binding = make_ref<Vec>();
+    res.binding->items.reserve(items.size());
+    for (std::size_t i = 0; i < items.size(); i++) {
+        auto& param = items[i];
+        if (get_if<SymName>(param) == heads().amp) {
+            if (i + 2 != items.size()) {
+                throw LibError("fn params require a single binding after &");
+            }
+            res.variadic = true;
+            continue;
+        }
+        res.binding->items.push_back(declare(&scope, param, hints[i]));
+    }
+    scope.params.assign(res.binding->items.begin(), res.binding->items.end());
+    scope.recur = &scope.params;
+    // args to a variadic fn don't map to its params one to one, so
+    // calls to it are left as calls. a call with as many args as a
+    // fixed arity's params runs that arity, so may recur.
+    if (!res.variadic) {
+        scope.self = std::move(self);
+    }
+    res.body = body(&scope, begin, end, true);
+
+    // ^long params are checked on the way in
+    std::vector<patom> checks;
+    for (auto& param : res.binding->items) {
+        if (auto local = get_if<Local>(param); local && local->hinted == Local::hint::long_) {
+            checks.push_back(check(*local, param));
+        }
+    }
+    if (!checks.empty()) {
+        checks.push_back(std::move(res.body));
+        res.body = patom(make_ref<node::DoNode>(patom(), std::move(checks)));
+    }
+
+    res.framesize = scope.framesize;
+    captures = std::move(scope.captures);
+    return res;
+}
+
+// fills in which body a call of fn runs for each number of args
+void dispatch(AnalyzedFn& fn)
+{
+    if (fn.bodies.size() >= Arities::none) {
+        throw LibError("too many fn arities");
+    }
+
+    auto& arities = fn.arities;
+    auto set = [&](std::size_t nargs, std::uint8_t i) {
+        if (arities.bodies.size() <= nargs) {
+            arities.bodies.resize(nargs + 1, Arities::none);
+        }
+        arities.bodies[nargs] = i;
+    };
+
+    for (std::size_t i = 0; i < fn.bodies.size(); i++) {
+        auto& body = fn.bodies[i];
+        auto nparams = body.binding->items.size() - body.variadic;
+        if (body.variadic) {
+            if (arities.rest != Arities::none) {
+                throw LibError("fn can't have more than one variadic arity");
+            }
+            arities.rest = static_cast<std::uint8_t>(i);
+        } else if (nparams < arities.bodies.size() &&
+                   arities.bodies[nparams] != Arities::none) {
+            throw LibError("fn can't have two arities with the same number of params");
+        } else {
+            set(nparams, static_cast<std::uint8_t>(i));
+        }
+    }
+
+    // the variadic body takes any number of args from its params up,
+    // other than as many as a fixed arity has
+    if (arities.rest != Arities::none) {
+        auto& body = fn.bodies[arities.rest];
+        auto nparams = body.binding->items.size() - 1;
+        if (arities.bodies.size() > nparams + 1) {
+            throw LibError("fn can't have a fixed arity with more params than its variadic arity");
+        } else if (arities.bodies.size() <= nparams) {
+            set(nparams, arities.rest);
+        }
+    }
+}
+
+// compiles a fn of one body, of params and the forms from begin
+AnalyzedFn fnIn(Env* env, FnScope* outer, const Vec& params,
+        form_iterator begin, form_iterator end, ref<Var> self = {})
+{
+    AnalyzedFn res;
+    res.bodies.push_back(bodyIn(env, outer, params, begin, end,
+            std::move(self), res.captures));
+    dispatch(res);
+    return res;
+}
+
+// compiles a fn from the forms after fn (or a defn's name): params and
+// a body, or a list of params and body for each arity
+AnalyzedFn fnIn(Env* env, FnScope* outer, form_iterator begin,
+        form_iterator end, const ref<Var>& self = {})
+{
+    if (begin != end) {
+        if (auto params = get_if<Vec>(*begin)) {
+            return fnIn(env, outer, *params, std::next(begin), end, self);
+        }
+    }
+
+    AnalyzedFn res;
+    for (auto it = begin; it != end; it++) {
+        auto arity = get_if<List>(*it);
+        auto params = arity && !arity->items.empty() ?
+                get_if<Vec>(arity->items.front()) :
+                ref<Vec>();
+        if (!params) {
+            throw LibError("fn requires params, or lists of params and body");
+        }
+
+        res.bodies.push_back(bodyIn(env, outer, *params,
+                std::next(arity->items.begin()), arity->items.end(), self,
+                res.captures));
+    }
+
+    if (res.bodies.empty()) {
+        throw LibError("fn requires params, or lists of params and body");
+    }
+
+    dispatch(res);
+    return res;
+}
+
+// compiles a let (or loop) into the current scope. its names go out of
+// sight at the end of the body, but keep their slots.
+template <typename T>
+patom letIn(FnScope* scope, patom src, const Vec& bindings,
+        form_iterator begin, form_iterator end, bool tail)
+{
+    auto [items, hints] = hinted(bindings);
+    if (items.size() % 2) {
+        throw LibError(fmt::format("{} requires even number of args",
+                T::node_kind == Node::kind::loop ? "loop" : "let"));
+    }
+
+    auto mark = scope->names.size();
+
+    auto res = make_ref<T>(std::move(src));
+    res->targets.reserve(items.size() / 2);
+    res->inits.reserve(items.size() / 2);
+    for (std::size_t i = 0; i < items.size(); i += 2) {
+        // init first, so it can't see its own binding
+        auto init = form(scope, items[i + 1]);
+        res->targets.push_back(declare(scope, items[i], hints[i]));
+        res->inits.push_back(checked(res->targets.back(), std::move(init)));
+    }
+
+    if constexpr (T::node_kind == Node::kind::loop) {
+        // the body is the loop's tail, whatever surrounds it
+        auto outer = scope->recur;
+        scope->recur = &res->targets;
+        res->body = body(scope, begin, end, true);
+        scope->recur = outer;
+    } else {
+        res->body = body(scope, begin, end, tail);
+    }
+
+    scope->names.resize(mark);
+    return res;
+}
+
+// compiles a recur of the innermost loop (or fn). its args are
+// evaluated into scratch slots of its own before any are rebound.
+patom recurIn(FnScope* scope, patom src, const std::vector<patom>& targets,
+        std::vector<patom> args)
+{
+    for (std::size_t i = 0; i < args.size(); i++) {
+        args[i] = checked(targets[i], std::move(args[i]));
+    }
+
+    auto scratch = scope->framesize;
+    scope->framesize += static_cast<std::uint32_t>(args.size());
+    return patom(make_ref<node::RecurNode>(std::move(src), targets,
+            std::move(args), scratch));
+}
+
+using Guards = std::vector<node::FoldNode::Guard>;
+
+// adds guards on vars not already guarded; a var is guarded once,
+// however many folded calls in a form depend on it
+void addGuards(Guards& guards, Guards::const_iterator first, Guards::const_iterator last)
+{
+    for (; first != last; ++first) {
+        auto it = std::find_if(guards.begin(), guards.end(), [&](auto& guard) {
+            return guard.var == first->var;
+        });
+        if (it == guards.end()) {
+            guards.push_back(*first);
+        }
+    }
+}
+
+// the value of compiled code that's constant: quoted, or a literal. if
+// guards is given, a folded call counts too, while its vars hold what
+// they do now; its guards are added to those.
+bool constant(const patom& code, patom& val, Guards* guards = nullptr)
+{
+    if (auto obj = code.get(); obj && obj->objtype == Object::type::node) {
+        auto n = static_cast<const Node*>(obj);
+        if (n->nodekind == Node::kind::fold && guards) {
+            auto f = static_cast<const node::FoldNode*>(n);
+            addGuards(*guards, f->guards.begin(), f->guards.end());
+            val = f->val;
+            return true;
+        } else if (n->nodekind != Node::kind::konst) {
+            return false;
+        }
+
+        val = static_cast<const node::ConstNode*>(obj)->val;
+        return true;
+    } else if (!is_literal(code)) {
+        return false;
+    }
+
+    val = code;
+    return true;
+}
+
+// calls a pure callable on constant args now, giving the result. empty
+// if it's not that kind of call, or if the call throws, which is left
+// to happen when it runs. the vars the result depends on, the callee's
+// and those of folded args, are added to guards, as they may be
+// redefined.
+patom fold(Env* env, const patom& callee, const std::vector<patom>& args,
+        Guards& guards)
+{
+    auto var = get_if<Var>(callee);
+    auto call = get_if<Callable>(var ? var->val : callee);
+    if (!call || call->special || !call->pure) {
+        return {};
+    }
+
+    Guards res;
+    if (var) {
+        res.push_back({var, var->val});
+    }
+
+    std::vector<patom> vals(args.size());
+    for (std::size_t i = 0; i < args.size(); i++) {
+        if (!constant(args[i], vals[i], &res)) {
+            return {};
+        }
+    }
+
+    patom val;
+    try {
+        val = call->call(env, vals.data(), vals.size());
+    } catch (const std::exception&) {
+        return {};
+    }
+
+    folded.calls++;
+    addGuards(guards, res.begin(), res.end());
+    return val ? val : Nil;
+}
+
+// code that's constant, unless it depends on guarded vars; then it's
+// only while they hold what they do, with code to run once they don't
+patom foldedCode(const patom& form, patom val, Guards guards, patom code)
+{
+    if (guards.empty()) {
+        return patom(make_ref<node::ConstNode>(form, std::move(val)));
+    }
+
+    return patom(make_ref<node::FoldNode>(form, std::move(val),
+            std::move(guards), std::move(code)));
+}
+
+// the math builtins a call on longs is compiled to a PrimNode for
+struct Prim
+{
+    Callable::Builtin builtin;
+    node::PrimNode::Op op;
+};
+
+constexpr Prim prims[] = {
+        {math::add, node::PrimNode::Op::add},
+        {math::sub, node::PrimNode::Op::sub},
+        {math::mul, node::PrimNode::Op::mul},
+        {math::inc, node::PrimNode::Op::inc},
+        {math::lt, node::PrimNode::Op::lt},
+        {math::lteq, node::PrimNode::Op::lteq},
+        {math::gt, node::PrimNode::Op::gt},
+        {math::gteq, node::PrimNode::Op::gteq},
+};
+
+// whether compiled code is arithmetic on longs, so gives one while its
+// builtins are in place
+bool isArith(const patom& code)
+{
+    auto obj = code.get();
+    return obj && obj->objtype == Object::type::node &&
+           static_cast<const Node*>(obj)->nodekind == Node::kind::prim &&
+           static_cast<const node::PrimNode*>(obj)->arith();
+}
+
+// compiles a call of a math builtin on longs to a PrimNode, or returns
+// empty if it's not that kind of call. arithmetic on more than two args
+// nests, from the left.
+patom prim(const ref<List>& lst, const patom& callee, const std::vector<patom>& args)
+{
+    using Op = node::PrimNode::Op;
+
+    auto var = get_if<Var>(callee);
+    auto call = var ? get_if<Callable>(var->val) : ref<Callable>();
+    if (!call || call->special) {
+        return {};
+    }
+
+    auto builtin = call->builtin();
+    auto it = std::find_if(std::begin(prims), std::end(prims),
+            [&](const Prim& p) { return p.builtin == builtin; });
+    if (it == std::end(prims)) {
+        return {};
+    }
+
+    // inc takes one arg, comparisons two, and arithmetic two or more
+    auto op = it->op;
+    auto nargs = op == Op::inc ? 1u : 2u;
+    if (op < Op::inc ? args.size() < nargs : args.size() != nargs) {
+        return {};
+    }
+
+    for (auto& arg : args) {
+        if (!isLong(arg) && !isArith(arg)) {
+            return {};
+        }
+    }
+
+    auto invoke = [&](const std::vector<patom>& args) {
+        return patom(make_ref<node::InvokeNode>(lst, callee, args));
+    };
+
+    if (args.size() == nargs) {
+        return patom(make_ref<node::PrimNode>(lst, op, var, args, invoke(args)));
+    }
+
+    auto res = args[0];
+    for (std::size_t i = 1; i < args.size(); i++) {
+        std::vector<patom> pair{res, args[i]};
+        // the outermost is the call as written
+        auto call = invoke(i + 1 == args.size() ? args : pair);
+        res = patom(make_ref<node::PrimNode>(lst, op, var, std::move(pair),
+                std::move(call)));
+    }
+    return res;
+}
+
+// the symbols a syntax-quote generates for names ending in #
+using Gensyms = std::vector<std::pair<const SymName*, patom>>;
+
+patom gensym(const ref<SymName>& sym, Gensyms& gensyms)
+{
+    for (auto& [name, res] : gensyms) {
+        if (name == sym.get()) {
+            return res;
+        }
+    }
+
+    static std::atomic<unsigned> counter = 0;
+    auto& name = sym->name;
+    auto res = SymName::make_atom(fmt::format("{}__{}__auto__",
+            std::string_view(name).substr(0, name.size() - 1), counter++));
+    gensyms.emplace_back(sym.get(), res);
+    return res;
+}
+
+// the head of a list form, if it's the symbol name
+bool headed(const patom& val, std::string_view name)
+{
+    if (auto lst = get_if<List>(val); lst && lst->items.size() == 2) {
+        if (auto sym = get_if<SymName>(lst->items[0])) {
+            return sym->name == name;
+        }
+    }
+
+    return false;
+}
+
+// compiles code building a syntax-quoted form: it's quoted, but for
+// the code in it that's unquoted, which is compiled as usual. symbols
+// aren't qualified with their namespace.
+patom syntaxQuote(FnScope* scope, const patom& val, Gensyms& gensyms)
+{
+    if (auto sym = get_if<SymName>(val)) {
+        if (sym->name.size() > 1 && sym->name.back() == '#') {
+            return patom(make_ref<node::ConstNode>(val, gensym(sym, gensyms)));
+        }
+    } else if (headed(val, "unquote"sv)) {
+        return form(scope, get<List>(val)->items[1]);
+    } else if (headed(val, "unquote-splicing"sv)) {
+        throw LibError("unable to splice outside of a list or vec");
+    } else if (auto seq = get_if<Seq>(val); seq &&
+            (seq->seqkind == Seq::kind::list || seq->seqkind == Seq::kind::vec)) {
+        EnvDepth ed{scope->env};
+
+        std::vector<node::SyntaxQuoteNode::Item> res;
+        auto quote = [&](const auto& src) {
+            res.reserve(src.size());
+            for (auto& item : src) {
+                if (headed(item, "unquote-splicing"sv)) {
+                    res.push_back({form(scope, get<List>(item)->items[1]), true});
+                } else {
+                    res.push_back({syntaxQuote(scope, item, gensyms), false});
+                }
+            }
+        };
+
+        if (seq->seqkind == Seq::kind::list) {
+            quote(get<List>(val)->items);
+        } else {
+            quote(get<Vec>(val)->items);
+        }
+        return patom(make_ref<node::SyntaxQuoteNode>(val, seq->seqkind, std::move(res)));
+    }
+
+    // maps, like everything else, are quoted as is
+    return patom(make_ref<node::ConstNode>(val, val));
+}
+
+// compiles a special form, or returns empty if it's malformed or its
+// args aren't code; its implementation is called with them as is
+patom special(FnScope* scope, const ref<List>& lst, special::form head,
+        bool tail)
+{
+    auto& items = lst->items;
+    auto size = items.size();
+
+    // the forms of a body, the last of them in tail position if the
+    // body is
+    auto body = [&](std::size_t from) {
+        std::vector<patom> res;
+        res.reserve(size - from);
+        auto it = std::next(items.begin(), from);
+        for (auto i = from; i < size; i++, it++) {
+            res.push_back(form(scope, *it, tail && i + 1 == size));
+        }
+        return res;
+    };
+
+    switch (head) {
+        case special::form::quote:
+            if (size == 2) {
+                return patom(make_ref<node::ConstNode>(lst, items[1]));
+            }
+            break;
+        case special::form::do_:
+            return patom(make_ref<node::DoNode>(lst, body(1)));
+        case special::form::if_:
+            if (size == 3 || size == 4) {
+                auto test = form(scope, items[1]);
+
+                // a constant test picks its branch now
+                if (patom val; constant(test, val)) {
+                    folded.branches++;
+                    if (truthy(val)) {
+                        return form(scope, items[2], tail);
+                    }
+                    return size == 4 ? form(scope, items[3], tail) : Nil;
+                }
+
+                return patom(make_ref<node::IfNode>(lst, std::move(test),
+                        form(scope, items[2], tail),
+                        size == 4 ? form(scope, items[3], tail) : patom()));
+            }
+            break;
+        case special::form::when:
+            if (size > 1) {
+                auto test = form(scope, items[1]);
+                return patom(make_ref<node::IfNode>(lst, std::move(test),
+                        patom(make_ref<node::DoNode>(lst, body(2))), patom()));
+            }
+            break;
+        case special::form::and_:
+            if (size == 1) {
+                return patom(make_ref<node::ConstNode>(lst, True));
+            }
+            return patom(make_ref<node::AndNode>(lst, body(1)));
+        case special::form::or_:
+            return patom(make_ref<node::OrNode>(lst, body(1)));
+        case special::form::fn:
+            if (size > 1 && (get_if<Vec>(items[1]) || get_if<List>(items[1]))) {
+                auto res = fnIn(scope->env, scope, std::next(items.begin()), items.end());
+                return patom(make_ref<node::FnNode>(lst, std::move(res)));
+            }
+            break;
+        case special::form::defn:
+            if (size > 2) {
+                auto sym = get_if<SymName>(items[1]);
+                if (sym && (get_if<Vec>(items[2]) || get_if<List>(items[2]))) {
+                    // declared first, so the body can refer to it
+                    auto var = scope->env->internVar(sym.get());
+                    auto res = fnIn(scope->env, scope, std::next(items.begin(), 2), items.end(), var);
+                    return patom(make_ref<node::DefNode>(lst, std::move(var),
+                            patom(make_ref<node::FnNode>(lst, std::move(res)))));
+                }
+            }
+            break;
+        case special::form::defmacro:
+            if (size > 2) {
+                auto sym = get_if<SymName>(items[1]);
+                // skip a docstring
+                std::size_t first = get_if<Str>(items[2]) ? 3 : 2;
+                auto fnform = first < size &&
+                              (get_if<Vec>(items[first]) || get_if<List>(items[first]));
+                if (sym && fnform) {
+                    auto var = scope->env->internVar(sym.get());
+                    auto res = fnIn(scope->env, scope, std::next(items.begin(), first),
+                            items.end());
+                    return patom(make_ref<node::DefNode>(lst, std::move(var),
+                            patom(make_ref<node::FnNode>(lst, std::move(res))), true));
+                }
+            }
+            break;
+        case special::form::syntax_quote:
+            if (size == 2) {
+                Gensyms gensyms;
+                return syntaxQuote(scope, items[1], gensyms);
+            }
+            break;
+        case special::form::def:
+            if (size == 3) {
+                if (auto sym = get_if<SymName>(items[1])) {
+                    auto var = scope->env->internVar(sym.get());
+                    return patom(make_ref<node::DefNode>(lst, std::move(var),
+                            form(scope, items[2])));
+                }
+            }
+            break;
+        case special::form::let:
+            if (size > 1) {
+                if (auto bindings = get_if<Vec>(items[1])) {
+                    return letIn<node::LetNode>(scope, lst, *bindings,
+                            std::next(items.begin(), 2), items.end(), tail);
+                }
+            }
+            break;
+        case special::form::loop:
+            if (size > 1) {
+                if (auto bindings = get_if<Vec>(items[1])) {
+                    return letIn<node::LoopNode>(scope, lst, *bindings,
+                            std::next(items.begin(), 2), items.end(), tail);
+                }
+            }
+            break;
+        case special::form::recur: {
+            if (!scope->recur) {
+                throw LibError("recur outside of loop or fn");
+            } else if (!tail) {
+                throw LibError("can only recur from tail position");
+            } else if (size - 1 != scope->recur->size()) {
+                throw LibError(fmt::format(
+                        "mismatched arg count to recur, expected: {} args, got: {}",
+                        scope->recur->size(), size - 1));
+            }
+
+            std::vector<patom> args;
+            args.reserve(size - 1);
+            for (auto it = std::next(items.begin()); it != items.end(); it++) {
+                args.push_back(form(scope, *it));
+            }
+            return recurIn(scope, lst, *scope->recur, std::move(args));
+        }
+        case special::form::lazy_seq: {
+            // the body runs later, as a fn of no args
+            auto res = fnIn(scope->env, scope, Vec(), std::next(items.begin()),
+                    items.end());
+            return patom(make_ref<node::InvokeNode>(lst, heads().lazySeqFn,
+                    std::vector<patom>{make_ref<node::FnNode>(lst, std::move(res))}));
+        }
+        case special::form::comment:
+        case special::form::ns:
+        case special::form::require:
+        case special::form::none:
+            break;
+    }
+
+    return {};
+}
+
+patom list(FnScope* scope, const ref<List>& lst, bool tail)
+{
+    auto& items = lst->items;
+    if (items.empty()) {
+        return lst;
+    }
+
+    if (auto head = get_if<SymName>(items[0])) {
+        if (auto sf = special::of(head.get());
+                sf != special::form::none && !isLocal(scope, head)) {
+            if (auto res = special(scope, lst, sf, tail)) {
+                return res;
+            }
+
+            // args aren't code, or the form is malformed: pass the
+            // args as is, and leave it to the implementation
+            return patom(make_ref<node::InvokeNode>(lst, special::callable(sf),
+                    std::vector<patom>(std::next(items.begin()), items.end())));
+        }
+    }
+
+    // a macro call is expanded here, once, and its expansion compiled
+    // in its place
+    if (auto head = get_if<SymName>(items[0]); head && !isLocal(scope, head)) {
+        if (auto var = macro::macroOf(scope->env, *lst)) {
+            return form(scope, macro::expand(scope->env, *var, *lst), tail);
+        }
+    }
+
+    std::vector<patom> args;
+    args.reserve(items.size() - 1);
+    for (auto it = std::next(items.begin()); it != items.end(); it++) {
+        args.push_back(form(scope, *it));
+    }
+
+    auto callee = form(scope, items.front());
+    if (get_if<Keyword>(callee)) {
+        args.insert(args.begin(), std::move(callee));
+        callee = heads().keywordFn;
+    }
+
+    if (Guards guards; auto res = fold(scope->env, callee, args, guards)) {
+        auto code = guards.empty() ? patom() : callOf(scope, lst, callee, args, tail);
+        return foldedCode(lst, std::move(res), std::move(guards), std::move(code));
+    }
+
+    return callOf(scope, lst, std::move(callee), std::move(args), tail);
+}
+
+// compiles a call as it's made when it runs, rather than folded
+patom callOf(FnScope* scope, const ref<List>& lst, patom callee,
+        std::vector<patom> args, bool tail)
+{
+    if (auto res = prim(lst, callee, args)) {
+        return res;
+    }
+
+    // a defn calling itself in tail position, and not from inside a
+    // loop, where a recur would rebind the loop instead of the params
+    if (tail && scope->self && callee.get() == scope->self.get() &&
+            scope->recur == &scope->params &&
+            args.size() == scope->params.size()) {
+        auto invoke = patom(make_ref<node::InvokeNode>(lst, callee, args));
+        auto recur = recurIn(scope, lst, scope->params, std::move(args));
+        return patom(make_ref<node::SelfCallNode>(lst, scope->self,
+                std::move(recur), std::move(invoke)));
+    }
+
+    return patom(make_ref<node::InvokeNode>(lst, std::move(callee), std::move(args)));
+}
+
+patom form(FnScope* scope, const patom& val, bool tail)
+{
+    if (auto sym = get_if<SymName>(val)) {
+        if (!sym->nssym) {
+            if (auto local = lookup(scope, sym)) {
+                return local;
+            }
+        }
+
+        // globals bind to their var, if there is one yet; otherwise
+        // they're looked up each time
+        if (auto var = scope->env->resolveVar(sym.get())) {
+            return var;
+        }
+    } else if (auto lst = get_if<List>(val)) {
+        EnvDepth ed{scope->env};
+        return list(scope, lst, tail);
+    } else if (auto vec = get_if<Vec>(val); vec && !vec->items.empty()) {
+        EnvDepth ed{scope->env};
+
+        std::vector<patom> res;
+        res.reserve(vec->items.size());
+        for (auto& item : vec->items) {
+            res.push_back(form(scope, item));
+        }
+
+        // a vec of constants is built once, and shared
+        Guards guards;
+        std::vector<patom> vals(res.size());
+        for (std::size_t i = 0; i < res.size(); i++) {
+            if (!constant(res[i], vals[i], &guards)) {
+                return patom(make_ref<node::VecNode>(val, std::move(res)));
+            }
+        }
+
+        folded.vecs++;
+        auto code = guards.empty() ? patom() : patom(make_ref<node::VecNode>(val, std::move(res)));
+        return foldedCode(val,
+                is_literal(val) ? val : patom(make_ref<Vec>(std::move(vals))),
+                std::move(guards), std::move(code));
+    } else if (auto map = get_if<Map>(val); map && !map->items.empty()) {
+        EnvDepth ed{scope->env};
+
+        // keys and vals, in turn
+        std::vector<patom> res;
+        res.reserve(map->items.size() * 2);
+        for (auto& [k, v] : map->items) {
+            res.push_back(form(scope, k));
+            res.push_back(form(scope, v));
+        }
+
+        // like vecs, a map of constants is built once
+        Guards guards;
+        Map::items_type vals;
+        for (std::size_t i = 0; i < res.size(); i += 2) {
+            patom k, v;
+            if (!constant(res[i], k, &guards) || !constant(res[i + 1], v, &guards)) {
+                return patom(make_ref<node::MapNode>(val, std::move(res)));
+            }
+            vals.set(std::move(k), std::move(v));
+        }
+
+        auto code = guards.empty() ? patom() : patom(make_ref<node::MapNode>(val, std::move(res)));
+        return foldedCode(val,
+                is_literal(val) ? val : patom(make_ref<Map>(std::move(vals))),
+                std::move(guards), std::move(code));
+    }
+
+    return val;
+}
+
+std::vector<patom> collect(AtomIterator* it)
+{
+    std::vector<patom> res;
+    while (it->next()) {
+        res.push_back(it->value());
+    }
+    return res;
+}
+
+} // namespace
+
+FoldStats foldStats()
+{
+    FoldStats res;
+    res.vecs = folded.vecs;
+    res.calls = folded.calls;
+    res.branches = folded.branches;
+    return res;
+}
+
+void resetFoldStats()
+{
+    folded.vecs = 0;
+    folded.calls = 0;
+    folded.branches = 0;
+}
+
+AnalyzedFn fn(Env* env, const patom& first, AtomIterator* rest,
+        const ref<Var>& self)
+{
+    std::vector<patom> forms{first};
+    while (rest->next()) {
+        forms.push_back(rest->value());
+    }
+
+    plist<patom> lst(std::move(forms));
+    return fnIn(env, nullptr, lst.begin(), lst.end(), self);
+}
+
+Analyzed toplevel(Env* env, const patom& form)
+{
+    FnScope scope(env, nullptr);
+
+    Analyzed res;
+    res.binding = make_ref<Vec>();
+    res.body = analyze::form(&scope, form);
+    res.framesize = scope.framesize;
+    return res;
+}
+
+namespace {
+
+template <typename T>
+Analyzed toplevelLet(Env* env, const ref<SymName>& head,
+        const ref<Vec>& binding, AtomIterator* body)
+{
+    auto forms = collect(body);
+
+    // the form itself, for printing, with the body after the bindings
+    std::vector<patom> src{head, binding};
+    src.insert(src.end(), forms.begin(), forms.end());
+    auto lst = make_ref<List>(std::move(src));
+
+    FnScope scope(env, nullptr);
+
+    Analyzed res;
+    res.body = letIn<T>(&scope, lst, *binding,
+            std::next(lst->items.begin(), 2), lst->items.end(), false);
+    res.framesize = scope.framesize;
+    return res;
+}
+
+} // namespace
+
+Analyzed let(Env* env, const ref<Vec>& binding, AtomIterator* body)
+{
+    return toplevelLet<node::LetNode>(env, heads().let, binding, body);
+}
+
+Analyzed loop(Env* env, const ref<Vec>& binding, AtomIterator* body)
+{
+    return toplevelLet<node::LoopNode>(env, heads().loop, binding, body);
+}
+
+} // namespace csxp::lib::detail::analyze
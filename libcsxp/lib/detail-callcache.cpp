@@ -0,0 +1,49 @@
+#include "csxp/lib/detail/callcache.h"
+
+namespace csxp::lib::detail::callcache {
+
+namespace {
+
+// per thread, as call sites run on every call
+thread_local Stats counts;
+
+} // namespace
+
+bool CallCache::check(const patom& val, const Callable* self)
+{
+    auto obj = val.get();
+    auto isself = obj && obj == self;
+    if (obj && (obj == callee.get() || (selfcall && isself))) {
+        counts.hits++;
+        return true;
+    }
+
+    counts.misses++;
+    callee = isself ? patom() : val;
+    selfcall = isself;
+    builtin = nullptr;
+    body = nullptr;
+
+    auto call = get_if<Callable>(val);
+    if (!call) {
+        callkind = get_if<Keyword>(val) ? kind::keyword : kind::none;
+    } else if ((builtin = call->builtin())) {
+        callkind = call->special ? kind::form : kind::builtin;
+    } else {
+        callkind = call->special ? kind::special : kind::fn;
+    }
+
+    return false;
+}
+
+Stats stats()
+{
+    return counts;
+}
+
+void resetStats()
+{
+    counts = {};
+}
+
+} // namespace csxp::lib::detail::callcache
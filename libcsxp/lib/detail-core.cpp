@@ -1,10 +1,15 @@
 #include "csxp/atom_fmt.h"
 #include "csxp/env.h"
+#include "csxp/lib/detail/analyze.h"
 #include "csxp/lib/detail/core.h"
 #include "csxp/lib/detail/util.h"
 #include "csxp/lib/lib.h"
 #include "rw/logging.h"
 
+#include <iterator>
+#include <string_view>
+#include <vector>
+
 #define LOGGER() (rw::logging::get("lib/detail/core"))
 
 using namespace std::literals;
@@ -164,9 +169,11 @@ patom quote(csxp::Env* env, AtomIterator* args)
 patom def(csxp::Env* env, AtomIterator* args)
 {
     auto sym = util::arg_next<SymName>(args, 0, "core/def"sv);
-    auto tval = util::arg_next(env, args, 1, "core/def"sv);
-    env->setInternal(sym.get(), tval);
-    return std::make_shared<atom>(sym);
+    // declare first, so the value can refer to it
+    auto var = env->internVar(sym.get());
+    var->val = util::arg_next(env, args, 1, "core/def"sv);
+    var->macro = false;
+    return patom(sym);
 }
 
 patom do_(csxp::Env* env, AtomIterator* args)
@@ -187,20 +194,26 @@ patom let(csxp::Env* env, AtomIterator* args)
         throw lib::LibError("let requires even number of args");
     }
 
-    EnvScope es{env};
+    // todo: verify binding!
+    // data.ValidBinding(binding);
 
-    for (std::size_t i = 0; i < vec->items.size(); i += 2) {
-        auto binding = vec->items[i];
-        // todo: verify binding!
-        // data.ValidBinding(binding);
+    // a let outside any fn; compile it and give it a frame
+    auto let = analyze::let(env, vec, args);
+    EnvFrame ef{env, let.framesize};
+    return env->eval(let.body);
+}
 
-        auto val = env->eval(vec->items[i + 1]);
-        env->destructure(binding, val);
+patom loop(csxp::Env* env, AtomIterator* args)
+{
+    auto vec = util::arg_next<Vec>(args, 0, "core/loop"sv);
+    if (vec->items.size() % 2) {
+        throw lib::LibError("loop requires even number of args");
     }
 
-    // pass body on to do
-    auto res = do_(env, args);
-    return res;
+    // like let, a loop outside any fn gets a frame of its own
+    auto loop = analyze::loop(env, vec, args);
+    EnvFrame ef{env, loop.framesize};
+    return env->eval(loop.body);
 }
 
 patom assert_(csxp::Env* env, AtomIterator* args)
@@ -224,10 +237,10 @@ patom assert_(csxp::Env* env, AtomIterator* args)
         // do we have a message?
         if (args->next()) {
             throw lib::LibError(fmt::format("assert failed: {}; {}",
-                *val, *x));
+                val, x));
         } else {
             // no message
-            throw lib::LibError(fmt::format("assert failed: {}", *x));
+            throw lib::LibError(fmt::format("assert failed: {}", x));
         }
     }
 
@@ -244,7 +257,11 @@ patom count(csxp::Env* env, AtomIterator* args)
     } else if (auto lst = get_if<List>(val)) {
         res = Num::make_atom(lst->items.size());
     } else if (auto map = get_if<Map>(val)) {
-        res = Num::make_atom(map->items->size());
+        res = Num::make_atom(map->items.size());
+    } else if (auto tr = get_if<Transient>(val)) {
+        res = Num::make_atom(tr->collkind == Seq::kind::map ?
+                tr->map.size() :
+                tr->vec.size());
     } else if (auto seq = get_if<Seq>(val)) {
         int count = 0;
         auto it = seq->iterator();
@@ -267,15 +284,13 @@ patom comment(csxp::Env* env, AtomIterator* args)
 
 patom some(csxp::Env* env, AtomIterator* args)
 {
-    auto call = util::arg_next<Callable>(env, args, 0, "core/some"sv);
+    auto call = fn_arg(env, args, 0, "core/some"sv);
     auto seq = util::arg_next<Seq>(env, args, 1, "core/some"sv);
 
     auto it = seq->iterator();
     while (it->next()) {
-        auto argVec = std::make_shared<Vec>(
-                std::vector<patom>{it->value()});
-        auto argIt = argVec->iterator();
-        auto res = (*call)(env, argIt.get());
+        auto val = it->value();
+        auto res = call->call(env, &val, 1);
         if (truthy(res)) {
             return res;
         }
@@ -284,27 +299,69 @@ patom some(csxp::Env* env, AtomIterator* args)
     return Nil;
 }
 
-patom seq(csxp::Env* env, AtomIterator* args)
+namespace {
+
+// the arg of seq, first, rest or next, as a seq, or null if it's nil
+ref<Seq> seqArg(csxp::Env* env, AtomIterator* args, std::string_view name)
 {
-    auto val = util::arg_next(args, 0, "core/seq"sv);
+    auto val = util::arg_next(env, args, 0, name);
+    util::check_no_args(args, name);
 
-    // note: not lazy
-    std::vector<patom> lst;
-    if (*val != *Nil)
-    {
-        if (auto seqArg = get_if<Seq>(env->eval(val))) {
-            for (auto val : *seqArg) {
-                lst.emplace_back(env->eval(val));
-            }
-        } else {
-            throw lib::LibError("expected arg to be sequence");
+    if (is_nil(val)) {
+        return {};
+    } else if (auto res = get_if<Seq>(val)) {
+        return res;
+    }
+
+    throw lib::LibError("expected arg to be sequence");
+}
+
+// all but the first item of a seq. a list's rest shares its cells, so
+// walking a list by rest doesn't copy it.
+plist<patom> restOf(const ref<Seq>& seq)
+{
+    if (!seq) {
+        return {};
+    } else if (auto lst = seq_cast<List>(seq.get())) {
+        return lst->items.rest();
+    } else if (auto vec = seq_cast<Vec>(seq.get())) {
+        if (vec->items.empty()) {
+            return {};
         }
+        return plist<patom>(std::next(vec->items.begin()), vec->items.end());
     }
 
-    util::check_no_args(args, "core/seq"sv);
+    std::vector<patom> res;
+    auto it = seq->iterator();
+    if (it->next()) {
+        while (it->next()) {
+            res.push_back(it->value());
+        }
+    }
+    return res;
+}
+
+} // namespace
+
+patom seq(csxp::Env* env, AtomIterator* args)
+{
+    auto arg = seqArg(env, args, "core/seq"sv);
+    if (!arg) {
+        return Nil;
+    }
+
+    // a list is its own seq; anything else is copied into one (note:
+    // not lazy)
+    if (auto lst = seq_cast<List>(arg.get())) {
+        return lst->items.empty() ? Nil : patom(arg);
+    }
+
+    std::vector<patom> lst;
+    for (auto val : *arg) {
+        lst.emplace_back(std::move(val));
+    }
 
     if (!lst.empty()) {
-        // todo: check make_atom for other places to std::move
         return List::make_atom(std::move(lst));
     } else {
         return Nil;
@@ -313,61 +370,33 @@ patom seq(csxp::Env* env, AtomIterator* args)
 
 patom first(csxp::Env* env, AtomIterator* args)
 {
-    auto res = seq(env, args);
-    if (*res != *Nil) {
-        // seq always returns Seq or nil, get ok here
-        if (auto seqArg = get<Seq>(res)) {
-            if (auto it = seqArg->begin(); it != seqArg->end()) {
-                return *it;
-            }
-        }
+    auto arg = seqArg(env, args, "core/first"sv);
+    if (!arg) {
+        return Nil;
+    } else if (auto lst = seq_cast<List>(arg.get())) {
+        return lst->items.empty() ? Nil : lst->items.front();
+    } else if (auto vec = seq_cast<Vec>(arg.get())) {
+        return vec->items.empty() ? Nil : vec->items.front();
     }
 
-    return Nil;
+    auto it = arg->iterator();
+    return it->next() ? it->value() : Nil;
 }
 
 patom rest(csxp::Env* env, AtomIterator* args)
 {
-    auto res = seq(env, args);
-
-    std::vector<patom> lst;
-    if (*res != *Nil) {
-        // seq always returns Seq or nil, get ok here
-        if (auto seqArg = get<Seq>(env->eval(args->value()))) {
-            auto it = seqArg->iterator();
-            it->next(); // skip first item
-
-            while (it->next()) {
-                lst.emplace_back(it->value());
-            }
-        }
-    }
-
-    return List::make_atom(std::move(lst));
+    auto arg = seqArg(env, args, "core/rest"sv);
+    return patom(make_ref<List>(restOf(arg)));
 }
 
 patom next(csxp::Env* env, AtomIterator* args)
 {
-    auto res = seq(env, args);
-
-    std::vector<patom> lst;
-    if (*res != *Nil) {
-        // seq always returns Seq or nil, get ok here
-        if (auto seqArg = get<Seq>(env->eval(args->value()))) {
-            auto it = seqArg->iterator();
-            it->next(); // skip first item
-
-            while (it->next()) {
-                lst.emplace_back(it->value());
-            }
-        }
-    }
-
-    if (!lst.empty()) {
-        return List::make_atom(std::move(lst));
-    } else {
+    auto arg = seqArg(env, args, "core/next"sv);
+    auto res = restOf(arg);
+    if (res.empty()) {
         return Nil;
     }
+    return patom(make_ref<List>(std::move(res)));
 }
 
 patom identity(csxp::Env* env, AtomIterator* args)
@@ -380,45 +409,43 @@ patom identity(csxp::Env* env, AtomIterator* args)
 
 patom reduce(csxp::Env* env, AtomIterator* args)
 {
-    auto call = util::arg_next<Callable>(env, args, 0, "core/reduce"sv);
-    auto arg2 = util::arg_next(args, 1, "core/reduce"sv);
+    auto call = fn_arg(env, args, 0, "core/reduce"sv);
+    auto arg2 = util::arg_next(env, args, 1, "core/reduce"sv);
 
     patom res;
     std::shared_ptr<AtomIterator> it;
 
     if (args->next()) {
-        auto arg3 = args->value();
+        auto arg3 = util::eval_curr(env, args);
 
         util::check_no_args(args, "core/reduce"sv);
 
-        if (auto seq = get_if<Seq>(env->eval(arg3))) {
+        if (auto seq = get_if<Seq>(arg3)) {
             it = seq->iterator();
             res = arg2;
         } else {
             throw lib::LibError("expected arg to be sequence");
         }
     } else {
-        if (auto seq = get_if<Seq>(env->eval(arg2))) {
+        if (auto seq = get_if<Seq>(arg2)) {
             it = seq->iterator();
             if (it->next()) {
                 res = it->value();
             } else {
                 // call w/ no args
-                auto argvec = std::make_shared<Vec>();
-                auto argit = argvec->iterator();
-                res = (*call)(env, argit.get());
+                return call->call(env, nullptr, 0);
             }
         } else {
             throw lib::LibError("expected arg to be sequence");
         }
     }
 
+    // last res and curr val, passed in place
+    patom vals[2];
     while (it->next()) {
-        // call w/ last res and curr val
-        auto argvec = std::make_shared<Vec>(
-                std::vector<patom>{res, it->value()});
-        auto argit = argvec->iterator();
-        res = (*call)(env, argit.get());
+        vals[0] = std::move(res);
+        vals[1] = it->value();
+        res = call->call(env, vals, 2);
     }
 
     return res;
@@ -433,7 +460,7 @@ patom take(csxp::Env* env, AtomIterator* args)
 
     // todo: this is seriously cheating. take should be lazy!
     std::vector<patom> lst;
-    if (*val != *Nil) {
+    if (val != Nil) {
         if (auto seqArg = get_if<Seq>(val)) {
             auto it = seqArg->iterator();
             // val may be negative, so we have to make sure to cast size
@@ -451,17 +478,14 @@ patom take(csxp::Env* env, AtomIterator* args)
 
 patom iterate(csxp::Env* env, AtomIterator* args)
 {
-    auto call = util::arg_next<Callable>(env, args, 0, "core/iterate"sv);
+    auto call = fn_arg(env, args, 0, "core/iterate"sv);
     auto val = util::arg_next(env, args, 1, "core/iterate"sv);
     util::check_no_args(args, "core/iterate"sv);
 
     // todo: this is broken. iterate MUST be lazy!
     std::vector<patom> lst;
     for (int i = 0; i < 3; i++) {
-        auto argVec = std::make_shared<Vec>(
-                std::vector<patom>{val});
-        auto argIt = argVec->iterator();
-        val = (*call)(env, argIt.get());
+        val = call->call(env, &val, 1);
         // really, need to yield here
         lst.emplace_back(val);
     }
@@ -475,16 +499,373 @@ patom repeatedly(csxp::Env* env, AtomIterator* args)
     return Nil;
 }
 
+patom mark_pure(csxp::Env* env, AtomIterator* args)
+{
+    auto call = util::arg_next<Callable>(env, args, 0, "core/mark-pure"sv);
+    util::check_no_args(args, "core/mark-pure"sv);
+    if (call->special) {
+        throw lib::LibError("core/mark-pure expects a fn");
+    }
+
+    // only calls analyzed from here on are folded
+    call->pure = true;
+    return patom(call);
+}
+
+namespace {
+
+// the updates shared by the persistent fns and the transient ones,
+// made in place on items, from the rest of args
+
+// [key val] entries, added to a map
+void conjEntries(csxp::Env* env, AtomIterator* args, Map::items_type& items,
+        std::string_view errFn)
+{
+    while (args->next()) {
+        auto entry = get_if<Vec>(util::eval_curr(env, args));
+        if (!entry || entry->items.size() != 2) {
+            throw lib::LibError(fmt::format(
+                    "expected {} to add a [key val] vec to a map", errFn));
+        }
+        items.set(entry->items[0], entry->items[1]);
+    }
+}
+
+// keys and vals, in turn, set in a map
+void assocEntries(csxp::Env* env, AtomIterator* args, Map::items_type& items,
+        std::string_view errFn)
+{
+    int idx = 1;
+    while (args->next()) {
+        auto key = util::eval_curr(env, args);
+        idx++;
+        auto val = util::arg_next(env, args, idx++, errFn);
+        items.set(std::move(key), std::move(val));
+    }
+}
+
+// indexes and vals, in turn, set in a vec
+void assocItems(csxp::Env* env, AtomIterator* args, pvector<patom>& items,
+        std::string_view errFn)
+{
+    int idx = 1;
+    while (args->next()) {
+        auto key = util::arg_curr<Num>(env, args, idx++, errFn);
+        auto val = util::arg_next(env, args, idx++, errFn);
+
+        // one past the end adds to it
+        if (key->val < 0 || static_cast<std::size_t>(key->val) > items.size()) {
+            throw lib::LibError(fmt::format(
+                    "{} index {} out of bounds", errFn, key->val));
+        } else if (static_cast<std::size_t>(key->val) == items.size()) {
+            items.push_back(std::move(val));
+        } else {
+            items.set(key->val, std::move(val));
+        }
+    }
+}
+
+ref<Transient> transientArg(csxp::Env* env, AtomIterator* args, std::string_view errFn)
+{
+    auto res = util::arg_next<Transient>(env, args, 0, errFn);
+    if (!res->editable) {
+        throw lib::LibError(fmt::format(
+                "{} called on a transient after persistent!", errFn));
+    }
+    return res;
+}
+
+} // namespace
+
 patom conj(csxp::Env* env, AtomIterator* args)
 {
-    // todo
-    return Nil;
+    auto coll = util::arg_next(env, args, 0, "core/conj"sv);
+
+    // vecs add to the end, sharing the rest; lists (and nil) add to
+    // the front; maps add [key val] entries
+    if (auto map = get_if<Map>(coll)) {
+        auto items = map->items;
+        conjEntries(env, args, items, "core/conj"sv);
+        return patom(make_ref<Map>(std::move(items)));
+    } else if (auto vec = get_if<Vec>(coll)) {
+        auto items = vec->items;
+        while (args->next()) {
+            items.push_back(util::eval_curr(env, args));
+        }
+        return patom(make_ref<Vec>(std::move(items)));
+    } else if (is_nil(coll) || get_if<List>(coll)) {
+        plist<patom> items;
+        if (auto lst = get_if<List>(coll)) {
+            items = lst->items;
+        }
+        while (args->next()) {
+            items.push_front(util::eval_curr(env, args));
+        }
+        return patom(make_ref<List>(std::move(items)));
+    }
+
+    throw lib::LibError("expected core/conj arg 1 to be a map, vec or list");
 }
 
 patom assoc(csxp::Env* env, AtomIterator* args)
 {
-    // todo
-    return Nil;
+    auto coll = util::arg_next(env, args, 0, "core/assoc"sv);
+
+    // nil is an empty map
+    if (is_nil(coll) || get_if<Map>(coll)) {
+        Map::items_type items;
+        if (auto map = get_if<Map>(coll)) {
+            items = map->items;
+        }
+        assocEntries(env, args, items, "core/assoc"sv);
+        return patom(make_ref<Map>(std::move(items)));
+    }
+
+    auto vec = get_if<Vec>(coll);
+    if (!vec) {
+        throw lib::LibError("expected core/assoc arg 1 to be a map or vec");
+    }
+
+    auto items = vec->items;
+    assocItems(env, args, items, "core/assoc"sv);
+    return patom(make_ref<Vec>(std::move(items)));
+}
+
+patom dissoc(csxp::Env* env, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 0, "core/dissoc"sv);
+
+    if (is_nil(coll)) {
+        util::check_no_args(args, "core/dissoc"sv);
+        return Nil;
+    }
+
+    auto map = get_if<Map>(coll);
+    if (!map) {
+        throw lib::LibError("expected core/dissoc arg 1 to be a map");
+    }
+
+    auto items = map->items;
+    bool changed = false;
+    while (args->next()) {
+        changed |= items.erase(util::eval_curr(env, args));
+    }
+
+    // without any of the keys, it's the same map
+    return changed ? patom(make_ref<Map>(std::move(items))) : coll;
+}
+
+patom lookup(const patom& coll, const patom& key, const patom& notFound)
+{
+    if (auto map = get_if<Map>(coll)) {
+        if (auto res = map->items.find(key)) {
+            return *res;
+        }
+    } else if (auto vec = get_if<Vec>(coll)) {
+        if (key.is_num() && key.num() >= 0 &&
+                static_cast<std::size_t>(key.num()) < vec->items.size()) {
+            return vec->items[key.num()];
+        }
+    }
+
+    return notFound ? notFound : Nil;
+}
+
+patom get(csxp::Env* env, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 0, "core/get"sv);
+    auto key = util::arg_next(env, args, 1, "core/get"sv);
+
+    patom notFound;
+    if (args->next()) {
+        notFound = util::eval_curr(env, args);
+        util::check_no_args(args, "core/get"sv);
+    }
+
+    return lookup(coll, key, notFound);
+}
+
+patom keyword_get(csxp::Env* env, AtomIterator* args)
+{
+    auto key = util::arg_next<Keyword>(env, args, 0, "core/keyword"sv);
+    return keyword_call(env, patom(key), args);
+}
+
+patom keyword_call(csxp::Env* env, const patom& key, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 1, "core/keyword"sv);
+
+    patom notFound;
+    if (args->next()) {
+        notFound = util::eval_curr(env, args);
+        util::check_no_args(args, "core/keyword"sv);
+    }
+
+    return lookup(coll, key, notFound);
+}
+
+namespace {
+
+// a keyword, passed where a fn is expected
+struct KeywordFn : public Callable
+{
+    KeywordFn(patom key) :
+        Callable(false), key(std::move(key)) {}
+
+    patom operator()(csxp::Env* env, AtomIterator* args)
+    {
+        return keyword_call(env, key, args);
+    }
+
+    patom key;
+};
+
+} // namespace
+
+ref<Callable> fn_arg(csxp::Env* env, AtomIterator* args, int errN, std::string_view errFn)
+{
+    auto val = util::arg_next(env, args, errN, errFn);
+    if (auto call = get_if<Callable>(val)) {
+        return call;
+    } else if (get_if<Keyword>(val)) {
+        return make_ref<KeywordFn>(std::move(val));
+    }
+
+    throw lib::LibError(fmt::format("expected {} arg {} to be a fn", errFn, errN + 1));
+}
+
+patom contains(csxp::Env* env, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 0, "core/contains?"sv);
+    auto key = util::arg_next(env, args, 1, "core/contains?"sv);
+    util::check_no_args(args, "core/contains?"sv);
+
+    if (auto map = get_if<Map>(coll)) {
+        return patom::make_bool(map->items.contains(key));
+    } else if (auto vec = get_if<Vec>(coll)) {
+        return patom::make_bool(key.is_num() && key.num() >= 0 &&
+                                static_cast<std::size_t>(key.num()) < vec->items.size());
+    } else if (is_nil(coll)) {
+        return False;
+    }
+
+    throw lib::LibError("expected core/contains? arg 1 to be a map or vec");
+}
+
+patom nth(csxp::Env* env, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 0, "core/nth"sv);
+    auto idx = util::arg_next<Num>(env, args, 1, "core/nth"sv);
+
+    patom notFound;
+    if (args->next()) {
+        notFound = util::eval_curr(env, args);
+        util::check_no_args(args, "core/nth"sv);
+    }
+
+    if (idx->val >= 0) {
+        auto i = static_cast<std::size_t>(idx->val);
+        if (auto vec = get_if<Vec>(coll)) {
+            if (i < vec->items.size()) {
+                return vec->items[i];
+            }
+        } else if (auto lst = get_if<List>(coll)) {
+            if (i < lst->items.size()) {
+                return lst->items[i];
+            }
+        } else if (auto seq = get_if<Seq>(coll)) {
+            auto it = seq->iterator();
+            for (std::size_t n = 0; it->next(); n++) {
+                if (n == i) {
+                    return it->value();
+                }
+            }
+        } else if (!is_nil(coll)) {
+            throw lib::LibError("expected core/nth arg 1 to be a sequence");
+        }
+    }
+
+    if (notFound) {
+        return notFound;
+    }
+
+    throw lib::LibError(fmt::format("core/nth index {} out of bounds", idx->val));
+}
+
+patom pop(csxp::Env* env, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 0, "core/pop"sv);
+    util::check_no_args(args, "core/pop"sv);
+
+    // vecs drop their last item, lists their first
+    if (auto vec = get_if<Vec>(coll)) {
+        if (vec->items.empty()) {
+            throw lib::LibError("can't pop an empty vec");
+        }
+        return patom(make_ref<Vec>(vec->items.pop()));
+    } else if (auto lst = get_if<List>(coll)) {
+        if (lst->items.empty()) {
+            throw lib::LibError("can't pop an empty list");
+        }
+        return patom(make_ref<List>(lst->items.rest()));
+    } else if (is_nil(coll)) {
+        return Nil;
+    }
+
+    throw lib::LibError("expected core/pop arg 1 to be a vec or list");
+}
+
+patom transient(csxp::Env* env, AtomIterator* args)
+{
+    auto coll = util::arg_next(env, args, 0, "core/transient"sv);
+    util::check_no_args(args, "core/transient"sv);
+
+    // shares the collection's nodes until it writes to them
+    if (auto vec = get_if<Vec>(coll)) {
+        return patom(make_ref<Transient>(vec->items));
+    } else if (auto map = get_if<Map>(coll)) {
+        return patom(make_ref<Transient>(map->items));
+    }
+
+    throw lib::LibError("expected core/transient arg 1 to be a map or vec");
+}
+
+patom conj_transient(csxp::Env* env, AtomIterator* args)
+{
+    auto res = transientArg(env, args, "core/conj!"sv);
+    if (res->collkind == Seq::kind::map) {
+        conjEntries(env, args, res->map, "core/conj!"sv);
+    } else {
+        while (args->next()) {
+            res->vec.push_back(util::eval_curr(env, args));
+        }
+    }
+    return patom(res);
+}
+
+patom assoc_transient(csxp::Env* env, AtomIterator* args)
+{
+    auto res = transientArg(env, args, "core/assoc!"sv);
+    if (res->collkind == Seq::kind::map) {
+        assocEntries(env, args, res->map, "core/assoc!"sv);
+    } else {
+        assocItems(env, args, res->vec, "core/assoc!"sv);
+    }
+    return patom(res);
+}
+
+patom persistent(csxp::Env* env, AtomIterator* args)
+{
+    auto res = transientArg(env, args, "core/persistent!"sv);
+    util::check_no_args(args, "core/persistent!"sv);
+
+    // the items move to the new collection, leaving the transient
+    // empty, and not to be used again
+    res->editable = false;
+    if (res->collkind == Seq::kind::map) {
+        return patom(make_ref<Map>(std::move(res->map)));
+    }
+    return patom(make_ref<Vec>(std::move(res->vec)));
 }
 
 } // namespace csxp::lib::detail::core
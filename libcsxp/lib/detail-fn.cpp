@@ -1,11 +1,15 @@
 #include "csxp/atom_fmt.h"
 #include "csxp/env.h"
-#include "csxp/lib/detail/core.h"
+#include "csxp/lib/detail/analyze.h"
 #include "csxp/lib/detail/fn.h"
+#include "csxp/lib/detail/node.h"
 #include "csxp/lib/detail/util.h"
+#include "csxp/lib/detail/vm.h"
 #include "csxp/lib/lib.h"
 #include "rw/logging.h"
+#include "fmt/format.h"
 
+#include <algorithm>
 #include <map>
 
 #define LOGGER() (rw::logging::get("lib/detail/fn"))
@@ -16,103 +20,122 @@ namespace csxp::lib::detail::fn {
 
 struct CallableFn : public Callable
 {
-    // todo: move?
-    CallableFn(Scope scope,
-            std::shared_ptr<Vec> binding,
-            std::shared_ptr<Vec> body) :
-        scope(scope),
-        binding(binding),
-        body(body)
+    CallableFn(std::vector<patom> captured,
+            std::shared_ptr<const analyze::AnalyzedFn> fn) :
+        Callable(false),
+        captured(std::move(captured)),
+        fn(std::move(fn))
     {}
 
     patom operator()(csxp::Env* env, AtomIterator* args)
     {
-        // eval our args before creating the stack frame
-        // and doing the destructuring
-        std::vector<patom> evaledArgs;
-        for (std::size_t i = 0; i < binding->items.size(); ++i) {
-            if (!args->next()) {
-                throw new LibError("missing required argument");
-            }
+        return apply(env, *this, args);
+    }
 
-            auto val = env->eval(args->value());
-            evaledArgs.push_back(val);
+    patom call(csxp::Env* env, const patom* args, std::size_t nargs)
+    {
+        auto arity = fn->arities(nargs);
+        if (arity == analyze::Arities::none) {
+            badArity(fn->arities, nargs);
         }
 
-        if (args->next()) {
-            // todo: fn name in message
-            throw new LibError("too many arguments for fn");
+        auto& body = fn->bodies[arity];
+        auto& params = body.binding->items;
+        auto nparams = params.size() - body.variadic;
+
+        EnvFrame ef{env, body.framesize, &captured};
+        auto f = ef.get();
+        f->fn = this;
+
+        for (std::size_t i = 0; i < nparams; ++i) {
+            node::bind(env, params[i], args[i]);
+        }
+        if (body.variadic) {
+            node::bind(env, params[nparams],
+                    node::restArgs(args + nparams, nargs - nparams));
         }
 
-        EnvFrame es{env, scope};
-        for (std::size_t i = 0; i < binding->items.size(); ++i) {
-            env->destructure(binding->items[i], evaledArgs[i]);
+        // a recur of the fn (or a self tail call) has rebound the params
+        // in place; go round again in the same frame
+        for (;;) {
+            auto res = env->eval(body.body);
+            if (!f->recur) {
+                return res;
+            }
+
+            f->recur = false;
         }
+    }
 
-        // pass body on to do
-        auto res = core::do_(env, body->iterator().get());
-        return res;
+    void clear()
+    {
+        captured.clear();
+        fn.reset();
     }
 
-    Scope scope;
-    std::shared_ptr<Vec> binding;
-    std::shared_ptr<Vec> body;
+    // the locals of enclosing fns it uses, copied when it was created
+    std::vector<patom> captured;
+    // compiled; see node.h
+    std::shared_ptr<const analyze::AnalyzedFn> fn;
 };
 
-// this is probably oversimplistic
-static void resolveLocal(csxp::Env* env, patom a,
-        Scope& resolved)
+void badArity(const analyze::Arities& arities, std::size_t nargs)
 {
-    // try to resolve them, only in lexical scope
-    if (auto sym = get_if<SymName>(a)) {
-        if (auto val = env->lexResolve(sym.get())) {
-            resolved[sym->name] = val;
-        }
-    } else if (auto seq = get_if<Seq>(a)) {
-        auto it = seq->iterator();
-        while (it->next()) {
-            resolveLocal(env, it->value(), resolved);
-        }
+    auto& bodies = arities.bodies;
+    if (std::all_of(bodies.begin(), bodies.begin() + std::min(nargs, bodies.size()),
+                [](auto i) { return i == analyze::Arities::none; })) {
+        throw LibError("missing required argument");
+    } else if (nargs >= bodies.size()) {
+        // todo: fn name in message
+        throw LibError("too many arguments for fn");
     }
+
+    throw LibError(fmt::format("wrong number of args ({}) for fn", nargs));
 }
 
-std::shared_ptr<Callable> makefn(csxp::Env* env,
-        std::shared_ptr<Vec> binding, AtomIterator* bodyit)
+ref<Callable> makefn(csxp::Env* env,
+        const patom& first, AtomIterator* rest, const ref<Var>& self)
 {
     // TODO: metadata
 
-    // todo: verify binding!
-    // data.ValidBinding(binding);
+    // not nested in an analyzed fn, so there are no enclosing locals
+    // todo: include fn info, like METADATA, for call stack?!?!!!1
+    auto fn = analyze::fn(env, first, rest, self);
+    if (env->engine() == Engine::vm) {
+        return vm::makefn({}, fn);
+    }
+    return make_ref<CallableFn>(std::vector<patom>(),
+            std::make_shared<const analyze::AnalyzedFn>(std::move(fn)));
+}
 
-    Scope scope;
-    auto body = std::make_shared<Vec>();
-    while (bodyit->next()) {
-        resolveLocal(env, bodyit->value(), scope);
-        body->items.emplace_back(bodyit->value());
+patom closure(csxp::Env* env, const std::shared_ptr<const analyze::AnalyzedFn>& fn)
+{
+    std::vector<patom> captured;
+    captured.reserve(fn->captures.size());
+    for (auto& local : fn->captures) {
+        captured.push_back(env->eval(local));
     }
 
-    // todo: include fn info, like METADATA, for call stack?!?!!!1
-    return std::make_shared<CallableFn>(scope, binding, body);
+    return patom(make_ref<CallableFn>(std::move(captured), fn));
 }
 
 patom fn(csxp::Env* env, AtomIterator* args)
 {
     // TODO: metadata
-    auto binding = util::arg_next<Vec>(args, 0, "core/fn"sv);
-    return std::make_shared<atom>(makefn(env, binding, args));
+    auto first = util::arg_next(args, 0, "core/fn"sv);
+    return patom(makefn(env, first, args));
 }
 
 patom defn(csxp::Env* env, AtomIterator* args)
 {
-    auto name = util::arg_next(args, 0, "core/defn"sv);
-
-    auto f = fn(env, args);
+    auto sym = util::arg_next<SymName>(args, 0, "core/defn"sv);
+    // declared first, so the body can refer to the fn
+    auto var = env->internVar(sym.get());
 
-    auto defargs = std::make_shared<Vec>();
-    defargs->items.emplace_back(name);
-    defargs->items.emplace_back(f);
-
-    return core::def(env, defargs->iterator().get());
+    // TODO: metadata
+    auto first = util::arg_next(args, 1, "core/defn"sv);
+    var->val = makefn(env, first, args, var);
+    return patom(sym);
 }
 
 } // namespace lib::detail::fn
@@ -12,28 +12,28 @@ using namespace std::literals;
 
 namespace csxp::lib::detail::lazy {
 
-struct Cons : public Seq, std::enable_shared_from_this<Cons>
+struct Cons : public Seq
 {
-    Cons(patom val, std::shared_ptr<Seq> seq) :
+    Cons(patom val, ref<Seq> seq) :
         val(val), seq(seq)
     {
     }
 
-    static patom make_atom(patom val, std::shared_ptr<Seq> seq)
+    static patom make_atom(patom val, ref<Seq> seq)
     {
-        return std::make_shared<atom>(std::make_shared<Cons>(val, seq));
+        return patom(make_ref<Cons>(val, seq));
     }
 
     std::shared_ptr<AtomIterator> iterator() const;
 
     patom val;
-    std::shared_ptr<Seq> seq;
+    ref<Seq> seq;
 };
 
 struct ConsIterator : public AtomIterator
 {
 public:
-    ConsIterator(std::shared_ptr<const Cons> cons) :
+    ConsIterator(ref<const Cons> cons) :
         val(cons->val), it(cons->seq->iterator())
     {
         // we expect these to both be non-null!
@@ -79,7 +79,7 @@ private:
 
 std::shared_ptr<AtomIterator> Cons::iterator() const
 {
-    return std::make_shared<ConsIterator>(shared_from_this());
+    return std::make_shared<ConsIterator>(ref<const Cons>(this));
 }
 
 patom cons(csxp::Env* env, AtomIterator* args)
@@ -88,64 +88,65 @@ patom cons(csxp::Env* env, AtomIterator* args)
     auto seqArg = util::arg_next(env, args, 1, "core/cons"sv);
     util::check_no_args(args, "core/cons"sv);
 
-    std::shared_ptr<Seq> seq;
-    if (*seqArg != *Nil) {
-        if (seq = get_if<Seq>(seqArg); !seq) {
-            throw lib::LibError("expected core/cons arg 1 to be sequence");
-        }
-    } else {
-        seq = std::make_shared<List>();
+    // consing onto a list (or nil) is a list sharing its cells; other
+    // seqs are wrapped, so lazy ones stay lazy
+    if (seqArg == Nil) {
+        return List::make_atom({val});
+    } else if (auto lst = get_if<List>(seqArg)) {
+        return patom(make_ref<List>(lst->items.cons(val)));
+    }
+
+    auto seq = get_if<Seq>(seqArg);
+    if (!seq) {
+        throw lib::LibError("expected core/cons arg 1 to be sequence");
     }
 
     return Cons::make_atom(val, seq);
 }
 
-struct LazySeq : public Seq, std::enable_shared_from_this<LazySeq>
+struct LazySeq : public Seq
 {
     // todo: env needs to be shared or passed to next :(
-    LazySeq(csxp::Env* env, std::shared_ptr<Callable> call) :
+    LazySeq(csxp::Env* env, ref<Callable> call) :
         env(env),
         call(call)
     {
     }
 
     void runbody() {
-        // todo: need empty iterator
-        auto empty = std::make_shared<List>();
-        auto it = empty->iterator();
-        auto res = (*call)(env, it.get());
+        auto res = call->call(env, nullptr, 0);
 
         // done with these...
         env = nullptr;
         call.reset();
 
-        if (*res != *Nil) {
+        if (res != Nil) {
             if (cache = get_if<Seq>(res); !cache) {
                 throw lib::LibError("expected core/lazy-seq arg 1 to be nil or sequence");
             }
         } else {
             // todo: shared empty sequence
-            cache = std::make_shared<List>();
+            cache = make_ref<List>();
         }
     }
 
-    static patom make_atom(csxp::Env* env, std::shared_ptr<Callable> call)
+    static patom make_atom(csxp::Env* env, ref<Callable> call)
     {
-        return std::make_shared<atom>(std::make_shared<LazySeq>(env, call));
+        return patom(make_ref<LazySeq>(env, call));
     }
 
     std::shared_ptr<AtomIterator> iterator() const;
 
     csxp::Env* env;
-    std::shared_ptr<Callable> call;
+    ref<Callable> call;
 
-    std::shared_ptr<Seq> cache;
+    ref<Seq> cache;
 };
 
 struct LazySeqIterator : public AtomIterator
 {
 public:
-    LazySeqIterator(std::shared_ptr<const LazySeq> seq) :
+    LazySeqIterator(ref<const LazySeq> seq) :
         seq(seq)
     {
     }
@@ -185,24 +186,32 @@ public:
     }
 
 private:
-    std::shared_ptr<const LazySeq> seq;
+    ref<const LazySeq> seq;
     std::shared_ptr<AtomIterator> it;
     patom curr;
 };
 
 std::shared_ptr<AtomIterator> LazySeq::iterator() const
 {
-    return std::make_shared<LazySeqIterator>(shared_from_this());
+    return std::make_shared<LazySeqIterator>(ref<const LazySeq>(this));
 }
 
 patom lazy_seq(csxp::Env* env, AtomIterator* args)
 {
     // todo: need empty vec
-    auto emptyvec = std::make_shared<Vec>();
+    auto emptyvec = make_ref<Vec>();
     auto call = fn::makefn(env, emptyvec, args);
     return LazySeq::make_atom(env, call);
 }
 
+patom lazy_seq_fn(csxp::Env* env, AtomIterator* args)
+{
+    auto call = util::arg_next<Callable>(env, args, 0, "core/lazy-seq"sv);
+    util::check_no_args(args, "core/lazy-seq"sv);
+
+    return LazySeq::make_atom(env, call);
+}
+
 struct RepeatSeq : public Seq
 {
     // todo: env needs to be shared or passed to next :(
@@ -214,7 +223,7 @@ struct RepeatSeq : public Seq
 
     static patom make_atom(std::optional<int> count, patom val)
     {
-        return std::make_shared<atom>(std::make_shared<RepeatSeq>(count, val));
+        return patom(make_ref<RepeatSeq>(count, val));
     }
 
     std::shared_ptr<AtomIterator> iterator() const;
@@ -265,7 +274,7 @@ std::shared_ptr<AtomIterator> RepeatSeq::iterator() const
 patom repeat(csxp::Env* env, AtomIterator* args)
 {
     auto arg = util::arg_next(env, args, 0, "core/repeat"sv);
-    std::shared_ptr<Num> num;
+    std::optional<Num> num;
     //std::shared_ptr<AtomIterator> it;
 
     if (args->next()) {
@@ -273,7 +282,7 @@ patom repeat(csxp::Env* env, AtomIterator* args)
             throw lib::LibError("expected arg to be num");
         }
 
-        arg = env->eval(args->value());
+        arg = util::eval_curr(env, args);
 
         util::check_no_args(args, "core/repeat"sv);
     }
@@ -0,0 +1,111 @@
+#include "csxp/env.h"
+#include "csxp/lib/detail/analyze.h"
+#include "csxp/lib/detail/fn.h"
+#include "csxp/lib/detail/macro.h"
+#include "csxp/lib/detail/special.h"
+#include "csxp/lib/detail/util.h"
+#include "csxp/lib/lib.h"
+#include "fmt/format.h"
+
+#include <iterator>
+#include <vector>
+
+using namespace std::literals;
+
+namespace csxp::lib::detail::macro {
+
+patom defmacro(csxp::Env* env, AtomIterator* args)
+{
+    auto sym = util::arg_next<SymName>(args, 0, "core/defmacro"sv);
+    auto var = env->internVar(sym.get());
+
+    // skip a docstring
+    auto binding = util::arg_next(args, 1, "core/defmacro"sv);
+    if (get_if<Str>(binding)) {
+        binding = util::arg_next(args, 2, "core/defmacro"sv);
+    }
+
+    if (!get_if<Vec>(binding) && !get_if<List>(binding)) {
+        throw LibError("expected core/defmacro params to be a vec");
+    }
+
+    var->val = fn::makefn(env, binding, args);
+    var->macro = true;
+    return patom(sym);
+}
+
+patom syntax_quote(csxp::Env* env, AtomIterator* args)
+{
+    auto val = util::arg_next(args, 0, "core/syntax-quote"sv);
+    util::check_no_args(args, "core/syntax-quote"sv);
+
+    // any unquoted code in it is compiled like a top level let
+    auto head = SymName::make_atom(special::name(special::form::syntax_quote));
+    auto res = analyze::toplevel(env, List::make_atom({head, val}));
+    EnvFrame ef{env, res.framesize};
+    return env->eval(res.body);
+}
+
+namespace {
+
+// the expansion of form, if it's a call to a macro, or empty
+patom expand1(Env* env, const patom& form)
+{
+    if (auto lst = get_if<List>(form)) {
+        if (auto var = macroOf(env, *lst)) {
+            return expand(env, *var, *lst);
+        }
+    }
+
+    return {};
+}
+
+} // namespace
+
+patom macroexpand(csxp::Env* env, AtomIterator* args)
+{
+    auto form = util::arg_next(env, args, 0, "core/macroexpand"sv);
+    while (auto res = expand1(env, form)) {
+        form = std::move(res);
+    }
+
+    return form;
+}
+
+patom macroexpand_1(csxp::Env* env, AtomIterator* args)
+{
+    auto form = util::arg_next(env, args, 0, "core/macroexpand-1"sv);
+    if (auto res = expand1(env, form)) {
+        return res;
+    }
+
+    return form;
+}
+
+ref<Var> macroOf(Env* env, const List& lst)
+{
+    if (!lst.items.empty()) {
+        if (auto head = get_if<SymName>(lst.items[0])) {
+            if (auto var = env->resolveVar(head.get()); var && var->macro && var->val) {
+                return var;
+            }
+        }
+    }
+
+    return {};
+}
+
+patom expand(Env* env, const Var& var, const List& lst)
+{
+    auto call = get_if<Callable>(var.val);
+    if (!call || call->special) {
+        throw LibError(fmt::format("macro {} isn't a fn", var.sym->name));
+    }
+
+    // the args, as forms, after the macro's name
+    std::vector<patom> args(std::next(lst.items.begin()), lst.items.end());
+    auto res = call->call(env, args.data(), args.size());
+    return res ? res : Nil;
+}
+
+} // namespace csxp::lib::detail::macro
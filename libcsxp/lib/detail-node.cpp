@@ -0,0 +1,384 @@
+#include "csxp/atom_fmt.h"
+#include "csxp/env.h"
+#include "csxp/lib/detail/core.h"
+#include "csxp/lib/detail/fn.h"
+#include "csxp/lib/detail/node.h"
+#include "csxp/lib/lib.h"
+#include "fmt/format.h"
+
+namespace csxp::lib::detail::node {
+
+namespace {
+
+const Seq* bound(const patom& val)
+{
+    if (auto obj = val.get(); obj && obj->objtype == Object::type::seq) {
+        return static_cast<const Seq*>(obj);
+    }
+
+    throw EnvError("destructuring vector, unable to iterate over arg");
+}
+
+// the items of a list or vec are indexed in place; other seqs are
+// iterated
+patom nth(const Seq* seq, std::size_t idx)
+{
+    if (auto lst = seq_cast<List>(seq)) {
+        return idx < lst->items.size() ? lst->items[idx] : Nil;
+    } else if (auto vec = seq_cast<Vec>(seq)) {
+        return idx < vec->items.size() ? vec->items[idx] : Nil;
+    }
+
+    auto it = seq->iterator();
+    for (std::size_t i = 0; i <= idx; i++) {
+        if (!it->next()) {
+            return Nil;
+        }
+    }
+    return it->value();
+}
+
+patom rest(const Seq* seq, std::size_t idx)
+{
+    auto res = make_ref<Vec>();
+    if (auto lst = seq_cast<List>(seq)) {
+        if (idx < lst->items.size()) {
+            res->items.assign(std::next(lst->items.begin(), idx), lst->items.end());
+        }
+    } else if (auto vec = seq_cast<Vec>(seq)) {
+        if (idx < vec->items.size()) {
+            res->items.assign(vec->items.begin() + idx, vec->items.end());
+        }
+    } else {
+        auto it = seq->iterator();
+        for (std::size_t i = 0; it->next(); i++) {
+            if (i >= idx) {
+                res->items.push_back(it->value());
+            }
+        }
+    }
+    return res;
+}
+
+// the value of an arg of a PrimNode, as an int
+int longOf(Env* env, const patom& arg)
+{
+    if (auto obj = arg.get(); obj && obj->objtype == Object::type::node &&
+            static_cast<const Node*>(obj)->nodekind == Node::kind::prim) {
+        return static_cast<const PrimNode*>(obj)->evalLong(env);
+    }
+
+    // a num, or a ^long local, which holds one
+    return env->eval(arg).num();
+}
+
+} // namespace
+
+patom BindNode::exec(Env* env) const
+{
+    throw EnvError(fmt::format("unable to evaluate binding {}", form));
+}
+
+void BindNode::bind(Env* env, const patom& val) const
+{
+    auto slots = env->currFrame()->slots;
+    slots[slot] = val;
+    for (auto& step : steps) {
+        auto seq = bound(slots[step.src]);
+        slots[step.dst] = step.op == Op::nth ? nth(seq, step.idx) : rest(seq, step.idx);
+    }
+}
+
+void bind(Env* env, const patom& target, const patom& val)
+{
+    if (auto obj = target.get()) {
+        if (obj->objtype == Object::type::local) {
+            if (auto local = static_cast<const Local*>(obj); !local->captured) {
+                env->currFrame()->slots[local->slot] = val;
+                return;
+            }
+        } else if (obj->objtype == Object::type::node &&
+                   static_cast<const Node*>(obj)->nodekind == Node::kind::bind) {
+            static_cast<const BindNode*>(obj)->bind(env, val);
+            return;
+        }
+    }
+
+    env->destructure(target, val);
+}
+
+patom restArgs(const patom* args, std::size_t nargs)
+{
+    if (!nargs) {
+        return Nil;
+    }
+
+    return patom(make_ref<Vec>(std::vector<patom>(args, args + nargs)));
+}
+
+patom ConstNode::exec(Env* env) const
+{
+    return val;
+}
+
+patom FoldNode::exec(Env* env) const
+{
+    for (auto& guard : guards) {
+        if (guard.var->val.get() != guard.held.get()) {
+            return env->eval(code);
+        }
+    }
+
+    return val;
+}
+
+patom DoNode::exec(Env* env) const
+{
+    auto res = Nil;
+    for (auto& form : body) {
+        res = env->eval(form);
+    }
+
+    return res;
+}
+
+patom IfNode::exec(Env* env) const
+{
+    if (truthy(env->eval(test))) {
+        return env->eval(then);
+    } else if (else_) {
+        return env->eval(else_);
+    }
+
+    return Nil;
+}
+
+patom AndNode::exec(Env* env) const
+{
+    auto res = Nil;
+    for (auto& form : body) {
+        res = env->eval(form);
+        if (!truthy(res)) {
+            break;
+        }
+    }
+
+    return res;
+}
+
+patom OrNode::exec(Env* env) const
+{
+    auto res = Nil;
+    for (auto& form : body) {
+        res = env->eval(form);
+        if (truthy(res)) {
+            break;
+        }
+    }
+
+    return res;
+}
+
+patom LetNode::exec(Env* env) const
+{
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        bind(env, targets[i], env->eval(inits[i]));
+    }
+
+    return env->eval(body);
+}
+
+patom LoopNode::exec(Env* env) const
+{
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        bind(env, targets[i], env->eval(inits[i]));
+    }
+
+    auto frame = env->currFrame();
+    for (;;) {
+        auto res = env->eval(body);
+        if (!frame->recur) {
+            return res;
+        }
+
+        frame->recur = false;
+    }
+}
+
+patom RecurNode::exec(Env* env) const
+{
+    auto frame = env->currFrame();
+    for (std::size_t i = 0; i < args.size(); i++) {
+        frame->slots[scratch + i] = env->eval(args[i]);
+    }
+
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        auto val = std::move(frame->slots[scratch + i]);
+        bind(env, targets[i], val);
+    }
+
+    frame->recur = true;
+    return Nil;
+}
+
+patom SelfCallNode::exec(Env* env) const
+{
+    auto fn = env->currFrame()->fn;
+    if (fn && var->val.get() == static_cast<const Object*>(fn)) {
+        return static_cast<const RecurNode*>(recur.get())->exec(env);
+    }
+
+    return static_cast<const InvokeNode*>(invoke.get())->exec(env);
+}
+
+patom DefNode::exec(Env* env) const
+{
+    var->val = env->eval(init);
+    var->macro = macro;
+    return var->sym;
+}
+
+patom FnNode::exec(Env* env) const
+{
+    return fn::closure(env, fn);
+}
+
+patom SyntaxQuoteNode::exec(Env* env) const
+{
+    std::vector<patom> res;
+    res.reserve(items.size());
+    for (auto& item : items) {
+        auto val = env->eval(item.code);
+        if (!item.splice) {
+            res.push_back(std::move(val));
+        } else if (!is_nil(val)) {
+            auto seq = get_if<Seq>(val);
+            if (!seq) {
+                throw EnvError("unable to splice a value that isn't a seq");
+            }
+
+            auto it = seq->iterator();
+            while (it->next()) {
+                res.push_back(it->value());
+            }
+        }
+    }
+
+    if (seqkind == Seq::kind::vec) {
+        return patom(make_ref<Vec>(std::move(res)));
+    }
+    return patom(make_ref<List>(std::move(res)));
+}
+
+patom VecNode::exec(Env* env) const
+{
+    auto res = make_ref<Vec>();
+    res->items.reserve(items.size());
+    for (auto& item : items) {
+        res->items.push_back(env->eval(item));
+    }
+
+    return res;
+}
+
+patom MapNode::exec(Env* env) const
+{
+    Map::items_type res;
+    for (std::size_t i = 0; i < items.size(); i += 2) {
+        auto key = env->eval(items[i]);
+        res.set(std::move(key), env->eval(items[i + 1]));
+    }
+
+    return make_ref<Map>(std::move(res));
+}
+
+patom HintNode::exec(Env* env) const
+{
+    auto res = env->eval(code);
+    if (!res.is_num()) {
+        throw LibError(fmt::format("expected a long for ^long {}", sym->name));
+    }
+
+    return res;
+}
+
+patom PrimNode::exec(Env* env) const
+{
+    if (var->val.get() != builtin.get()) {
+        return env->eval(invoke);
+    } else if (arith()) {
+        return Num::make_atom(evalLong(env));
+    }
+
+    auto a = longOf(env, args[0]);
+    auto b = longOf(env, args[1]);
+    switch (op) {
+        case Op::lt:
+            return a < b ? True : False;
+        case Op::lteq:
+            return a <= b ? True : False;
+        case Op::gt:
+            return a > b ? True : False;
+        default:
+            return a >= b ? True : False;
+    }
+}
+
+int PrimNode::evalLong(Env* env) const
+{
+    if (var->val.get() != builtin.get()) {
+        // whatever var holds now has to give a num, as a long would be
+        auto res = env->eval(invoke);
+        if (!res.is_num()) {
+            throw LibError(fmt::format("expected a long from {}", form));
+        }
+        return res.num();
+    }
+
+    auto a = longOf(env, args[0]);
+    switch (op) {
+        case Op::add:
+            return a + longOf(env, args[1]);
+        case Op::sub:
+            return a - longOf(env, args[1]);
+        case Op::mul:
+            return a * longOf(env, args[1]);
+        default:
+            return a + 1;
+    }
+}
+
+patom InvokeNode::exec(Env* env) const
+{
+    using kind = callcache::CallCache::kind;
+
+    // the callee is only a Callable for the kinds that say so
+    auto callee = env->eval(fn);
+    auto frame = env->currFrame();
+    cache.check(callee, frame ? frame->fn : nullptr);
+    switch (cache.callkind) {
+        case kind::builtin:
+            return apply(env, cache.builtin, args.begin(), args.end());
+        case kind::form: {
+            ValuesIterator it(args.data(), args.size(), false);
+            return cache.builtin(env, &it);
+        }
+        case kind::fn:
+            return apply(env, *static_cast<Callable*>(callee.get()),
+                    args.begin(), args.end());
+        case kind::special: {
+            ValuesIterator it(args.data(), args.size(), false);
+            return (*static_cast<Callable*>(callee.get()))(env, &it);
+        }
+        case kind::keyword: {
+            ValuesIterator it(args.data(), args.size(), false);
+            return core::keyword_call(env, callee, &it);
+        }
+        case kind::none:
+            break;
+    }
+
+    throw EnvError("unable to cast first item of list to Callable");
+}
+
+} // namespace csxp::lib::detail::node
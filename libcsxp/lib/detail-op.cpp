@@ -18,9 +18,9 @@ csxp::patom eq(csxp::Env* env, AtomIterator* args)
     // todo: handle single arg
     util::arg_next(args, 1, "core/="sv);
     do {
-        auto b = env->eval(args->value());
+        auto b = util::eval_curr(env, args);
 
-        if (*a != *b) {
+        if (a != b) {
             return False;
         }
     } while (args->next());
@@ -35,9 +35,9 @@ csxp::patom neq(csxp::Env* env, AtomIterator* args)
     // todo: handle single arg
     util::arg_next(args, 1, "core/not="sv);
     do {
-        auto b = env->eval(args->value());
+        auto b = util::eval_curr(env, args);
 
-        if (*a == *b) {
+        if (a == b) {
             return False;
         }
     } while (args->next());
@@ -0,0 +1,72 @@
+#include "csxp/env.h"
+#include "csxp/lib/detail/core.h"
+#include "csxp/lib/detail/fn.h"
+#include "csxp/lib/detail/lazy.h"
+#include "csxp/lib/detail/macro.h"
+#include "csxp/lib/detail/op.h"
+#include "csxp/lib/detail/special.h"
+#include "csxp/lib/lib.h"
+
+#include <array>
+
+namespace csxp::lib::detail::special {
+
+namespace {
+
+patom recur(Env* env, AtomIterator* args)
+{
+    throw LibError("recur outside of loop or fn");
+}
+
+using Impl = patom (*)(Env*, AtomIterator*);
+
+// in form order
+constexpr Impl impls[] = {
+        nullptr,
+        op::and_,
+        core::comment,
+        core::def,
+        macro::defmacro,
+        fn::defn,
+        core::do_,
+        fn::fn,
+        core::if_,
+        lazy::lazy_seq,
+        core::let,
+        core::loop,
+        core::ns,
+        op::or_,
+        core::quote,
+        recur,
+        core::require,
+        macro::syntax_quote,
+        core::when,
+};
+
+static_assert(std::size(impls) == std::size(impl::names));
+
+} // namespace
+
+patom eval(Env* env, form f, const ref<List>& lst)
+{
+    auto it = lst->iterator();
+    it->next();
+    return impls[static_cast<std::size_t>(f)](env, it.get());
+}
+
+const patom& callable(form f)
+{
+    // shared by every env, so pinned, as interned symbols are
+    static const auto callables = [] {
+        std::array<patom, std::size(impls)> res;
+        for (std::size_t i = 1; i < res.size(); i++) {
+            res[i] = make_callable(impls[i]);
+            res[i].get()->pin();
+        }
+        return res;
+    }();
+
+    return callables[static_cast<std::size_t>(f)];
+}
+
+} // namespace csxp::lib::detail::special
@@ -28,7 +28,8 @@ patom arg_next(AtomIterator* args, int errN, std::string_view errFn)
 
 patom arg_next(csxp::Env* env, AtomIterator* args, int errN, std::string_view errFn)
 {
-    return env->eval(arg_next(args, errN, errFn));
+    arg_next(args, errN, errFn);
+    return eval_curr(env, args);
 }
 
 } // namespace csxp::lib::detail::util
@@ -0,0 +1,1121 @@
+#include "csxp/atom_fmt.h"
+#include "csxp/env.h"
+#include "csxp/lib/detail/callcache.h"
+#include "csxp/lib/detail/core.h"
+#include "csxp/lib/detail/fn.h"
+#include "csxp/lib/detail/node.h"
+#include "csxp/lib/detail/vm.h"
+#include "csxp/lib/lib.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <typeinfo>
+#include <vector>
+
+// dispatch with computed goto where the compiler has it, otherwise with
+// a plain switch
+#if defined(__GNUC__) || defined(__clang__)
+#define CSXP_VM_COMPUTED_GOTO
+#endif
+
+using namespace std::literals;
+
+namespace csxp::lib::detail::vm {
+
+namespace {
+
+// operand a is the destination register, unless noted
+enum class Op : std::uint8_t
+{
+    konst,   // a = consts[b]
+    move,    // a = register b
+    upval,   // a = captured value b of the running fn
+    var,     // a = the value of Var consts[b]
+    eval,    // a = env->eval(consts[b]), for anything not compiled
+    jump,    // go to b
+    jumpf,   // go to b if a is falsey
+    notself, // go to b unless a is the fn the frame is a call of
+    vec,     // a = vec of the c registers from b
+    map,     // a = map of the c registers from b, keys and vals in turn
+    closure, // a = fns[b], capturing its locals from the frame
+    def,     // set Var consts[b] to a, a macro if c, then a = its symbol
+    destr,   // destructure a into binding consts[b]
+    invoke,  // a = b called with calls[c], going to its skip; see Compiler::invoke
+    call,    // a = b called with the values of the registers after it, for calls[c]
+    ret,     // return a
+    // longs; see Compiler::prim. registers b and c hold nums.
+    guard,   // go to b unless Var consts[a] holds consts[c]
+    checkl,  // throw unless a is a num, bound to ^long consts[b]
+    addl,    // a = b + c
+    subl,    // a = b - c
+    mull,    // a = b * c
+    incl,    // a = b + 1
+    ltl,     // a = b < c
+    lteql,   // a = b <= c
+    gtl,     // a = b > c
+    gteql,   // a = b >= c
+};
+
+struct Instr
+{
+    Op op;
+    std::uint16_t a;
+    std::uint16_t b;
+    std::uint16_t c;
+};
+
+static_assert(sizeof(Instr) == 8);
+
+struct FnProto;
+
+// what a call passes a special callable through its call operator: its
+// args, as code. skip is where the vm resumes after.
+struct CallSite
+{
+    std::vector<patom> args;
+    std::uint16_t skip = 0;
+    // whether a call with values follows the invoke
+    bool direct = false;
+    // of what the invoke last called. for a vm fn, body is its Proto
+    // for args.size() args.
+    mutable callcache::CallCache cache;
+};
+
+struct Chunk
+{
+    std::vector<Instr> code;
+    std::vector<patom> consts;
+    std::vector<std::shared_ptr<const FnProto>> fns;
+    std::vector<CallSite> calls;
+};
+
+// a compiled body of a fn, or top level form
+struct Proto
+{
+    Chunk chunk;
+    ref<Vec> binding;
+    bool variadic = false;
+    // when every param is a plain local, args are copied straight
+    // into these slots rather than destructured
+    bool simple = true;
+    std::vector<std::uint16_t> slots;
+    // registers the frame needs: locals, then temporaries
+    std::size_t nregs = 0;
+};
+
+// a compiled fn, with a body per arity
+struct FnProto
+{
+    std::vector<Proto> bodies;
+    analyze::Arities arities;
+    // Locals of the creating frame to capture; see analyze::AnalyzedFn
+    std::vector<patom> captures;
+};
+
+patom run(Env* env, const Chunk& chunk, Frame* frame);
+
+struct Fn : public Callable
+{
+    Fn(std::vector<patom> captured, std::shared_ptr<const FnProto> fn) :
+        Callable(false), captured(std::move(captured)), fn(std::move(fn))
+    {}
+
+    patom operator()(csxp::Env* env, AtomIterator* args)
+    {
+        return apply(env, *this, args);
+    }
+
+    patom call(csxp::Env* env, const patom* args, std::size_t nargs)
+    {
+        auto proto = enter(env, body(nargs), args, nargs);
+
+        struct Leave
+        {
+            ~Leave() { env->popFrame(); }
+            Env* env;
+        } leave{env};
+
+        return run(env, proto->chunk, env->currFrame());
+    }
+
+    void clear()
+    {
+        captured.clear();
+        fn.reset();
+    }
+
+    // the body for a call with nargs args
+    const Proto* body(std::size_t nargs) const
+    {
+        auto arity = fn->arities(nargs);
+        if (arity == analyze::Arities::none) {
+            detail::fn::badArity(fn->arities, nargs);
+        }
+
+        return &fn->bodies[arity];
+    }
+
+    // pushes a frame for a call of proto, its body for nargs args, with
+    // the params bound; gives proto back, for running in it
+    const Proto* enter(csxp::Env* env, const Proto* proto,
+            const patom* args, std::size_t nargs)
+    {
+        auto& params = proto->binding->items;
+        auto nparams = params.size() - proto->variadic;
+
+        auto frame = env->pushFrame(proto->nregs, &captured);
+        frame->fn = this;
+        try {
+            bind(env, frame, proto, args, nargs, nparams);
+        } catch (...) {
+            env->popFrame();
+            throw;
+        }
+
+        return proto;
+    }
+
+    void bind(csxp::Env* env, Frame* frame, const Proto* proto,
+            const patom* args, std::size_t nargs, std::size_t nparams)
+    {
+        auto& params = proto->binding->items;
+        if (proto->simple) {
+            for (std::size_t i = 0; i < nparams; ++i) {
+                frame->slots[proto->slots[i]] = args[i];
+            }
+            if (proto->variadic) {
+                frame->slots[proto->slots[nparams]] =
+                        node::restArgs(args + nparams, nargs - nparams);
+            }
+        } else {
+            for (std::size_t i = 0; i < nparams; ++i) {
+                node::bind(env, params[i], args[i]);
+            }
+            if (proto->variadic) {
+                node::bind(env, params[nparams],
+                        node::restArgs(args + nparams, nargs - nparams));
+            }
+        }
+    }
+
+    // the locals of enclosing fns it uses, copied when it was created
+    std::vector<patom> captured;
+    std::shared_ptr<const FnProto> fn;
+};
+
+// code for a compound arg passed to something other than a vm fn. it
+// runs in the frame that's current when it's evaluated, which is the
+// caller's, as callables evaluate their args before they push frames.
+struct ArgCode : public Node
+{
+    ArgCode(patom form) :
+        Node(kind::node, std::move(form)) {}
+
+    patom exec(csxp::Env* env) const
+    {
+        auto frame = env->currFrame();
+        if (!frame || frame->size < nregs) {
+            throw EnvError(fmt::format(
+                    "no frame for compiled arg {}", form));
+        }
+
+        return run(env, chunk, frame);
+    }
+
+    Chunk chunk;
+    // registers it needs the frame to have
+    std::size_t nregs = 0;
+};
+
+std::shared_ptr<const FnProto> compileFn(const analyze::AnalyzedFn& fn);
+
+class Compiler
+{
+public:
+    // registers from base up are free for temporaries; nregs tracks
+    // the most used
+    Compiler(Chunk& chunk, std::size_t base, std::size_t& nregs) :
+        chunk(chunk), top(base), nregs(nregs)
+    {
+        this->nregs = std::max(nregs, base);
+    }
+
+    // compiles code that evaluates val and returns it
+    void body(const patom& val)
+    {
+        auto dst = temp();
+        compile(val, dst);
+        emit(Op::ret, dst);
+    }
+
+private:
+    // allocates n consecutive registers
+    std::uint16_t temp(std::size_t n = 1)
+    {
+        auto res = top;
+        top += n;
+        nregs = std::max(nregs, top);
+        return operand(res);
+    }
+
+    static std::uint16_t operand(std::size_t val)
+    {
+        if (val > std::numeric_limits<std::uint16_t>::max()) {
+            throw LibError("fn too large to compile");
+        }
+        return static_cast<std::uint16_t>(val);
+    }
+
+    std::size_t emit(Op op, std::size_t a, std::size_t b = 0, std::size_t c = 0)
+    {
+        chunk.code.push_back({op, operand(a), operand(b), operand(c)});
+        return chunk.code.size() - 1;
+    }
+
+    // points the jump at pc to the next instruction emitted
+    void patch(std::size_t pc)
+    {
+        chunk.code[pc].b = operand(chunk.code.size());
+    }
+
+    std::size_t konst(const patom& val)
+    {
+        chunk.consts.push_back(val);
+        return chunk.consts.size() - 1;
+    }
+
+    void compile(const patom& val, std::uint16_t dst)
+    {
+        auto obj = val.get();
+        if (!obj) {
+            // immediates, and empty for nil
+            emit(Op::konst, dst, konst(val ? val : Nil));
+            return;
+        }
+
+        switch (obj->objtype) {
+            case Object::type::local: {
+                auto local = static_cast<const Local*>(obj);
+                if (local->captured) {
+                    emit(Op::upval, dst, local->slot);
+                } else if (local->slot != dst) {
+                    emit(Op::move, dst, local->slot);
+                }
+                break;
+            }
+            case Object::type::var:
+                emit(Op::var, dst, konst(val));
+                break;
+            case Object::type::node:
+                node(static_cast<const Node*>(obj), val, dst);
+                break;
+            case Object::type::seq:
+            case Object::type::symname:
+                // data, or symbols with no var yet
+                emit(Op::eval, dst, konst(val));
+                break;
+            default:
+                emit(Op::konst, dst, konst(val));
+                break;
+        }
+    }
+
+    void node(const Node* n, const patom& val, std::uint16_t dst)
+    {
+        switch (n->nodekind) {
+            case Node::kind::konst:
+                emit(Op::konst, dst, konst(static_cast<const node::ConstNode*>(n)->val));
+                break;
+            case Node::kind::fold: {
+                // the value, unless a var no longer holds what it was
+                // worked out from. the outermost fold guards every var
+                // the ones in it do, so in its code they're just code.
+                auto f = static_cast<const node::FoldNode*>(n);
+                if (unfolded) {
+                    compile(f->code, dst);
+                    break;
+                }
+
+                std::vector<std::size_t> guards;
+                for (auto& guard : f->guards) {
+                    guards.push_back(emit(Op::guard, konst(guard.var), 0, konst(guard.held)));
+                }
+                emit(Op::konst, dst, konst(f->val));
+                auto end = emit(Op::jump, 0);
+
+                for (auto pc : guards) {
+                    patch(pc);
+                }
+                unfolded = true;
+                compile(f->code, dst);
+                unfolded = false;
+                patch(end);
+                break;
+            }
+            case Node::kind::do_: {
+                auto& body = static_cast<const node::DoNode*>(n)->body;
+                if (body.empty()) {
+                    emit(Op::konst, dst, konst(Nil));
+                }
+                for (auto& form : body) {
+                    compile(form, dst);
+                }
+                break;
+            }
+            case Node::kind::if_: {
+                auto ifn = static_cast<const node::IfNode*>(n);
+
+                auto mark = top;
+                auto test = temp();
+                compile(ifn->test, test);
+                top = mark;
+
+                auto jumpf = emit(Op::jumpf, test);
+                compile(ifn->then, dst);
+                auto jump = emit(Op::jump, 0);
+                patch(jumpf);
+                compile(ifn->else_, dst);
+                patch(jump);
+                break;
+            }
+            case Node::kind::and_:
+            case Node::kind::or_: {
+                // each form's value goes in dst; and stops at the first
+                // falsey one, or at the first truthy one
+                auto& body = n->nodekind == Node::kind::and_ ?
+                        static_cast<const node::AndNode*>(n)->body :
+                        static_cast<const node::OrNode*>(n)->body;
+                if (body.empty()) {
+                    emit(Op::konst, dst, konst(Nil));
+                }
+
+                std::vector<std::size_t> ends;
+                for (std::size_t i = 0; i < body.size(); i++) {
+                    compile(body[i], dst);
+                    if (i + 1 == body.size()) {
+                        break;
+                    }
+
+                    if (n->nodekind == Node::kind::and_) {
+                        ends.push_back(emit(Op::jumpf, dst));
+                    } else {
+                        auto next = emit(Op::jumpf, dst);
+                        ends.push_back(emit(Op::jump, 0));
+                        patch(next);
+                    }
+                }
+                for (auto pc : ends) {
+                    patch(pc);
+                }
+                break;
+            }
+            case Node::kind::let: {
+                auto let = static_cast<const node::LetNode*>(n);
+                bind(let->targets, let->inits);
+                compile(let->body, dst);
+                break;
+            }
+            case Node::kind::loop: {
+                auto loop = static_cast<const node::LoopNode*>(n);
+                bind(loop->targets, loop->inits);
+
+                auto outer = start;
+                start = chunk.code.size();
+                compile(loop->body, dst);
+                start = outer;
+                break;
+            }
+            case Node::kind::recur: {
+                auto recur = static_cast<const node::RecurNode*>(n);
+                auto& args = recur->args;
+
+                // every arg first, as they may use the old values
+                auto mark = top;
+                auto base = temp(args.size());
+                for (std::size_t i = 0; i < args.size(); i++) {
+                    compile(args[i], operand(base + i));
+                }
+                for (std::size_t i = 0; i < args.size(); i++) {
+                    auto& target = recur->targets[i];
+                    auto local = get_if<Local>(target);
+                    if (local && !local->captured) {
+                        emit(Op::move, local->slot, base + i);
+                    } else {
+                        emit(Op::destr, base + i, konst(target));
+                    }
+                }
+                top = mark;
+
+                emit(Op::jump, 0, start);
+                break;
+            }
+            case Node::kind::selfcall: {
+                auto self = static_cast<const node::SelfCallNode*>(n);
+
+                auto mark = top;
+                auto fn = temp();
+                compile(patom(self->var), fn);
+                auto other = emit(Op::notself, fn);
+                top = mark;
+
+                compile(self->recur, dst);
+                patch(other);
+                compile(self->invoke, dst);
+                break;
+            }
+            case Node::kind::def: {
+                auto def = static_cast<const node::DefNode*>(n);
+                compile(def->init, dst);
+                emit(Op::def, dst, konst(def->var), def->macro);
+                break;
+            }
+            case Node::kind::fn:
+                chunk.fns.push_back(compileFn(*static_cast<const node::FnNode*>(n)->fn));
+                emit(Op::closure, dst, chunk.fns.size() - 1);
+                break;
+            case Node::kind::vec: {
+                auto& items = static_cast<const node::VecNode*>(n)->items;
+
+                auto mark = top;
+                auto base = temp(items.size());
+                for (std::size_t i = 0; i < items.size(); i++) {
+                    compile(items[i], operand(base + i));
+                }
+                emit(Op::vec, dst, base, items.size());
+                top = mark;
+                break;
+            }
+            case Node::kind::map: {
+                auto& items = static_cast<const node::MapNode*>(n)->items;
+
+                auto mark = top;
+                auto base = temp(items.size());
+                for (std::size_t i = 0; i < items.size(); i++) {
+                    compile(items[i], operand(base + i));
+                }
+                emit(Op::map, dst, base, items.size());
+                top = mark;
+                break;
+            }
+            case Node::kind::invoke:
+                invoke(static_cast<const node::InvokeNode*>(n), dst);
+                break;
+            case Node::kind::hint: {
+                auto hint = static_cast<const node::HintNode*>(n);
+                compile(hint->code, dst);
+                emit(Op::checkl, dst, konst(hint->sym));
+                break;
+            }
+            case Node::kind::prim:
+                prim(static_cast<const node::PrimNode*>(n), dst);
+                break;
+            default:
+                emit(Op::eval, dst, konst(val));
+                break;
+        }
+    }
+
+    // binds let or loop targets in the current frame. plain locals get
+    // their inits compiled straight into their slots.
+    void bind(const std::vector<patom>& targets, const std::vector<patom>& inits)
+    {
+        for (std::size_t i = 0; i < targets.size(); i++) {
+            auto& target = targets[i];
+            auto local = get_if<Local>(target);
+            if (local && !local->captured) {
+                compile(inits[i], operand(local->slot));
+            } else {
+                auto mark = top;
+                auto init = temp();
+                compile(inits[i], init);
+                emit(Op::destr, init, konst(target));
+                top = mark;
+            }
+        }
+    }
+
+    // the callee isn't known until it's evaluated, so a call is compiled
+    // for what it's most likely to be, going by what its var holds now.
+    // a direct call evaluates the args into registers after the callee's
+    // and calls it with their values; invoke first calls a special
+    // callable with the analyzed args, for the tree to evaluate, and
+    // skips the rest. a call to a special callable gives it the args as
+    // code.
+    void invoke(const node::InvokeNode* n, std::uint16_t dst)
+    {
+        auto& args = n->args;
+
+        auto mark = top;
+        auto fn = temp(1 + args.size());
+        compile(n->fn, fn);
+
+        CallSite site;
+        site.direct = !special(n->fn);
+        if (site.direct) {
+            site.args = args;
+        } else {
+            site.args.reserve(args.size());
+            for (auto& arg : args) {
+                site.args.push_back(argcode(arg));
+            }
+        }
+        chunk.calls.push_back(std::move(site));
+        auto idx = chunk.calls.size() - 1;
+
+        emit(Op::invoke, dst, fn, idx);
+        if (chunk.calls[idx].direct) {
+            for (std::size_t i = 0; i < args.size(); i++) {
+                compile(args[i], operand(fn + 1 + i));
+            }
+            emit(Op::call, dst, fn, idx);
+        }
+        chunk.calls[idx].skip = operand(chunk.code.size());
+
+        top = mark;
+    }
+
+    // math on longs runs as ops on the nums in registers, once guards
+    // have checked every builtin in it is still what its var holds. if
+    // one isn't, it runs as the calls it was written as.
+    void prim(const node::PrimNode* n, std::uint16_t dst)
+    {
+        if (unguarded) {
+            compile(n->invoke, dst);
+            return;
+        }
+
+        std::vector<std::size_t> guards;
+        guard(n, guards);
+        longs(n, dst);
+        auto end = emit(Op::jump, 0);
+
+        for (auto pc : guards) {
+            patch(pc);
+        }
+        unguarded = true;
+        compile(n->invoke, dst);
+        unguarded = false;
+        patch(end);
+    }
+
+    void guard(const node::PrimNode* n, std::vector<std::size_t>& guards)
+    {
+        guards.push_back(emit(Op::guard, konst(n->var), 0, konst(n->builtin)));
+        for (auto& arg : n->args) {
+            if (auto inner = primOf(arg)) {
+                guard(inner, guards);
+            }
+        }
+    }
+
+    void longs(const node::PrimNode* n, std::uint16_t dst)
+    {
+        static constexpr Op ops[] = {
+                Op::addl, Op::subl, Op::mull, Op::incl,
+                Op::ltl, Op::lteql, Op::gtl, Op::gteql};
+
+        auto mark = top;
+        auto a = longArg(n->args[0]);
+        auto b = n->args.size() > 1 ? longArg(n->args[1]) : 0;
+        emit(ops[static_cast<std::size_t>(n->op)], dst, a, b);
+        top = mark;
+    }
+
+    // the register holding a long arg: a ^long local's own, or a
+    // temporary it's computed into
+    std::uint16_t longArg(const patom& arg)
+    {
+        if (auto local = get_if<Local>(arg); local && !local->captured) {
+            return operand(local->slot);
+        }
+
+        auto res = temp();
+        if (auto inner = primOf(arg)) {
+            longs(inner, res);
+        } else {
+            compile(arg, res);
+        }
+        return res;
+    }
+
+    static const node::PrimNode* primOf(const patom& code)
+    {
+        auto obj = code.get();
+        if (obj && obj->objtype == Object::type::node &&
+                static_cast<const Node*>(obj)->nodekind == Node::kind::prim) {
+            return static_cast<const node::PrimNode*>(obj);
+        }
+        return nullptr;
+    }
+
+    // whether fn is, for now, a special callable
+    static bool special(const patom& fn)
+    {
+        auto val = fn;
+        if (auto var = get_if<Var>(fn)) {
+            val = var->val;
+        }
+
+        auto call = get_if<Callable>(val);
+        return call && call->special;
+    }
+
+    // atoms are passed as is, since evaluating them doesn't need the
+    // vm; nodes get code of their own, using registers above ours
+    patom argcode(const patom& arg)
+    {
+        auto obj = arg.get();
+        if (!obj || obj->objtype != Object::type::node) {
+            return arg;
+        }
+
+        auto res = make_ref<ArgCode>(static_cast<const Node*>(obj)->form);
+        Compiler sub(res->chunk, top, res->nregs);
+        sub.body(arg);
+        nregs = std::max(nregs, res->nregs);
+        return res;
+    }
+
+    Chunk& chunk;
+    std::size_t top;
+    std::size_t& nregs;
+    // where a recur goes: the innermost loop's first instruction, or
+    // the start of the fn
+    std::size_t start = 0;
+    // compiling the calls a PrimNode stands for, after a guard failed
+    bool unguarded = false;
+    // compiling the code a FoldNode stands for, after a guard failed
+    bool unfolded = false;
+};
+
+void compile(Proto& res, const analyze::Analyzed& fn)
+{
+    res.binding = fn.binding;
+    res.variadic = fn.variadic;
+    for (auto& param : fn.binding->items) {
+        auto local = get_if<Local>(param);
+        if (!local || local->captured) {
+            res.simple = false;
+            res.slots.clear();
+            break;
+        }
+        res.slots.push_back(static_cast<std::uint16_t>(local->slot));
+    }
+
+    Compiler c(res.chunk, fn.framesize, res.nregs);
+    c.body(fn.body);
+}
+
+std::shared_ptr<const FnProto> compileFn(const analyze::AnalyzedFn& fn)
+{
+    auto res = std::make_shared<FnProto>();
+    res->bodies.resize(fn.bodies.size());
+    for (std::size_t i = 0; i < fn.bodies.size(); i++) {
+        compile(res->bodies[i], fn.bodies[i]);
+    }
+    res->arities = fn.arities;
+    res->captures = fn.captures;
+    return res;
+}
+
+// where a call from vm code to a vm fn goes back to: the caller's chunk,
+// and the call, whose a is where the value goes. kept here, rather than
+// on the native stack, with the frames of the calls on the env's.
+struct Return
+{
+    const Chunk* chunk;
+    const Instr* pc;
+};
+
+thread_local std::vector<Return> returns;
+
+patom run(Env* env, const Chunk& top, Frame* frame)
+{
+    // the calls from this run still running, above base; if it throws,
+    // their frames are popped here
+    struct Calls
+    {
+        ~Calls()
+        {
+            while (stack.size() > base) {
+                stack.pop_back();
+                env->popFrame();
+            }
+        }
+
+        Env* env;
+        std::vector<Return>& stack;
+        std::size_t base;
+    } calls{env, returns, returns.size()};
+
+    auto chunk = &top;
+    auto code = chunk->code.data();
+    auto consts = chunk->consts.data();
+    auto regs = frame->slots;
+    // analysis only gives captured slots to code in fns that have them
+    auto captured = frame->captured ? frame->captured->data() : nullptr;
+    auto pc = code;
+
+#ifdef CSXP_VM_COMPUTED_GOTO
+    // in Op order
+    static const void* const labels[] = {
+            &&op_konst,
+            &&op_move,
+            &&op_upval,
+            &&op_var,
+            &&op_eval,
+            &&op_jump,
+            &&op_jumpf,
+            &&op_notself,
+            &&op_vec,
+            &&op_map,
+            &&op_closure,
+            &&op_def,
+            &&op_destr,
+            &&op_invoke,
+            &&op_call,
+            &&op_ret,
+            &&op_guard,
+            &&op_checkl,
+            &&op_addl,
+            &&op_subl,
+            &&op_mull,
+            &&op_incl,
+            &&op_ltl,
+            &&op_lteql,
+            &&op_gtl,
+            &&op_gteql,
+    };
+
+// a computed goto out of a case doesn't destroy its locals, so any
+// that own something are in a block that ends before it
+#define VM_CASE(name) op_##name
+#define VM_DISPATCH() goto* labels[static_cast<std::size_t>(pc->op)]
+    VM_DISPATCH();
+#else
+#define VM_CASE(name) case Op::name
+#define VM_DISPATCH() goto dispatch
+dispatch:
+    switch (pc->op) {
+#endif
+
+    VM_CASE(konst) :
+    {
+        regs[pc->a] = consts[pc->b];
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(move) :
+    {
+        regs[pc->a] = regs[pc->b];
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(upval) :
+    {
+        regs[pc->a] = captured[pc->b];
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(var) :
+    {
+        auto var = static_cast<const Var*>(consts[pc->b].get());
+        if (!var->val) {
+            throw EnvError(fmt::format(
+                    "unable to find symbol {}", var->sym->name));
+        }
+
+        regs[pc->a] = var->val;
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(eval) :
+    {
+        regs[pc->a] = env->eval(consts[pc->b]);
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(jump) :
+    {
+        pc = code + pc->b;
+        VM_DISPATCH();
+    }
+    VM_CASE(jumpf) :
+    {
+        pc = truthy(regs[pc->a]) ? pc + 1 : code + pc->b;
+        VM_DISPATCH();
+    }
+    VM_CASE(notself) :
+    {
+        auto self = static_cast<const Object*>(frame->fn);
+        pc = regs[pc->a].get() == self ? pc + 1 : code + pc->b;
+        VM_DISPATCH();
+    }
+    VM_CASE(vec) :
+    {
+        {
+            auto res = make_ref<Vec>();
+            res->items.assign(regs + pc->b, regs + pc->b + pc->c);
+            regs[pc->a] = std::move(res);
+        }
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(map) :
+    {
+        {
+            Map::items_type res;
+            for (auto reg = regs + pc->b; reg != regs + pc->b + pc->c; reg += 2) {
+                res.set(reg[0], reg[1]);
+            }
+            regs[pc->a] = make_ref<Map>(std::move(res));
+        }
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(closure) :
+    {
+        {
+            auto& fn = chunk->fns[pc->b];
+
+            std::vector<patom> vals;
+            vals.reserve(fn->captures.size());
+            for (auto& capture : fn->captures) {
+                auto local = static_cast<const Local*>(capture.get());
+                vals.push_back(local->captured ? captured[local->slot] : regs[local->slot]);
+            }
+
+            regs[pc->a] = patom(make_ref<Fn>(std::move(vals), fn));
+        }
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(def) :
+    {
+        auto var = static_cast<Var*>(consts[pc->b].get());
+        var->val = regs[pc->a];
+        var->macro = pc->c != 0;
+        regs[pc->a] = var->sym;
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(destr) :
+    {
+        node::bind(env, consts[pc->b], regs[pc->a]);
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(invoke) :
+    {
+        using kind = callcache::CallCache::kind;
+
+        auto& site = chunk->calls[pc->c];
+        auto& cache = site.cache;
+        auto& callee = regs[pc->b];
+        if (!cache.check(callee, frame ? frame->fn : nullptr) && cache.callkind == kind::fn) {
+            // typeid through the Callable, which is polymorphic; Object isn't
+            auto call = static_cast<Callable*>(callee.get());
+            if (typeid(*call) == typeid(Fn)) {
+                auto fn = static_cast<Fn*>(call)->fn.get();
+                if (auto arity = fn->arities(site.args.size()); arity != analyze::Arities::none) {
+                    cache.body = &fn->bodies[arity];
+                }
+            }
+        }
+
+        switch (cache.callkind) {
+            case kind::builtin:
+            case kind::fn:
+                if (site.direct) {
+                    ++pc;
+                    VM_DISPATCH();
+                }
+                [[fallthrough]];
+            case kind::special: {
+                ValuesIterator it(site.args.data(), site.args.size(), false);
+                regs[pc->a] = (*static_cast<Callable*>(callee.get()))(env, &it);
+                break;
+            }
+            case kind::keyword: {
+                if (site.direct) {
+                    ++pc;
+                    VM_DISPATCH();
+                }
+
+                ValuesIterator it(site.args.data(), site.args.size(), false);
+                regs[pc->a] = core::keyword_call(env, callee, &it);
+                break;
+            }
+            case kind::form: {
+                ValuesIterator it(site.args.data(), site.args.size(), false);
+                regs[pc->a] = cache.builtin(env, &it);
+                break;
+            }
+            case kind::none:
+                throw EnvError("unable to cast first item of list to Callable");
+        }
+
+        pc = code + site.skip;
+        VM_DISPATCH();
+    }
+    VM_CASE(call) :
+    {
+        // the invoke before it has checked the callee against the cache,
+        // and left it in its register
+        auto& cache = chunk->calls[pc->c].cache;
+        auto args = regs + pc->b + 1;
+        auto nargs = chunk->calls[pc->c].args.size();
+        if (cache.callkind == callcache::CallCache::kind::keyword) {
+            ValuesIterator it(args, nargs);
+            regs[pc->a] = core::keyword_call(env, regs[pc->b], &it);
+            ++pc;
+            VM_DISPATCH();
+        } else if (cache.builtin) {
+            ValuesIterator it(args, nargs);
+            regs[pc->a] = cache.builtin(env, &it);
+            ++pc;
+            VM_DISPATCH();
+        }
+
+        // only builtins and fns are left, which are Callables
+        auto callee = static_cast<Callable*>(regs[pc->b].get());
+        if (!cache.body) {
+            regs[pc->a] = callee->call(env, args, nargs);
+            ++pc;
+            VM_DISPATCH();
+        }
+
+        // a vm fn runs here, in a frame of its own, and returns here
+        auto proto = static_cast<Fn*>(callee)->enter(env,
+                static_cast<const Proto*>(cache.body), args, nargs);
+        calls.stack.push_back({chunk, pc});
+
+        frame = env->currFrame();
+        chunk = &proto->chunk;
+        code = chunk->code.data();
+        consts = chunk->consts.data();
+        regs = frame->slots;
+        captured = frame->captured ? frame->captured->data() : nullptr;
+        pc = code;
+        VM_DISPATCH();
+    }
+    VM_CASE(ret) :
+    {
+        if (calls.stack.size() == calls.base) {
+            return regs[pc->a];
+        }
+
+        {
+            // moving in swaps, leaving res with the register's old value
+            auto res = std::move(regs[pc->a]);
+            auto ret = calls.stack.back();
+            calls.stack.pop_back();
+            env->popFrame();
+
+            frame = env->currFrame();
+            chunk = ret.chunk;
+            code = chunk->code.data();
+            consts = chunk->consts.data();
+            regs = frame->slots;
+            captured = frame->captured ? frame->captured->data() : nullptr;
+            pc = ret.pc;
+            regs[pc->a] = std::move(res);
+        }
+        ++pc;
+        VM_DISPATCH();
+    }
+
+    VM_CASE(guard) :
+    {
+        auto var = static_cast<const Var*>(consts[pc->a].get());
+        pc = var->val.get() == consts[pc->c].get() ? pc + 1 : code + pc->b;
+        VM_DISPATCH();
+    }
+    VM_CASE(checkl) :
+    {
+        if (!regs[pc->a].is_num()) {
+            throw LibError(fmt::format("expected a long for ^long {}",
+                    get<SymName>(consts[pc->b])->name));
+        }
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(addl) :
+    {
+        regs[pc->a] = patom::make_num(regs[pc->b].num() + regs[pc->c].num());
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(subl) :
+    {
+        regs[pc->a] = patom::make_num(regs[pc->b].num() - regs[pc->c].num());
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(mull) :
+    {
+        regs[pc->a] = patom::make_num(regs[pc->b].num() * regs[pc->c].num());
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(incl) :
+    {
+        regs[pc->a] = patom::make_num(regs[pc->b].num() + 1);
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(ltl) :
+    {
+        regs[pc->a] = regs[pc->b].num() < regs[pc->c].num() ? True : False;
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(lteql) :
+    {
+        regs[pc->a] = regs[pc->b].num() <= regs[pc->c].num() ? True : False;
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(gtl) :
+    {
+        regs[pc->a] = regs[pc->b].num() > regs[pc->c].num() ? True : False;
+        ++pc;
+        VM_DISPATCH();
+    }
+    VM_CASE(gteql) :
+    {
+        regs[pc->a] = regs[pc->b].num() >= regs[pc->c].num() ? True : False;
+        ++pc;
+        VM_DISPATCH();
+    }
+
+#ifndef CSXP_VM_COMPUTED_GOTO
+    }
+#endif
+
+#undef VM_CASE
+#undef VM_DISPATCH
+
+    // unreachable; every chunk ends in ret
+    return Nil;
+}
+
+} // namespace
+
+patom eval(Env* env, const patom& form)
+{
+    Proto proto;
+    compile(proto, analyze::toplevel(env, form));
+
+    EnvFrame ef{env, proto.nregs};
+    return run(env, proto.chunk, ef.get());
+}
+
+ref<Callable> makefn(std::vector<patom> captured, const analyze::AnalyzedFn& fn)
+{
+    return make_ref<Fn>(std::move(captured), compileFn(fn));
+}
+
+} // namespace csxp::lib::detail::vm
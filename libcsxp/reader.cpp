@@ -3,6 +3,7 @@
 
 #include <charconv>
 #include <stack>
+#include <vector>
 
 using namespace std::literals;
 
@@ -44,8 +45,8 @@ namespace csxp {
 //     ^Type → ^{:tag Type}
 //     ^:key → ^{:key true}
 //       e.g., ^:dynamic ^:private ^:doc ^:const
-// ~ - unquote
-// ~@ - unquote splicing
+// ~form - unquote, (unquote form)
+// ~@form - unquote splicing, (unquote-splicing form)
 //
 // #{} - set
 // #" - rx pattern
@@ -53,8 +54,7 @@ namespace csxp {
 // #(...) - (fn [args] (...)), args %, %n, %&
 // #_ - ignore next form
 //
-// ` - for forms other than sym, list, vec, set, map, `x is 'x
-//     todo
+// `form - syntax quote, (syntax-quote form); the analyzer expands it
 //
 // skipping tagged literals, reader conditional, splicing reader conditional
 //
@@ -78,6 +78,9 @@ namespace csxp {
 // & - rest
 
 const patom Quote = SymName::make_atom("quote"sv);
+const patom SyntaxQuote = SymName::make_atom("syntax-quote"sv);
+const patom Unquote = SymName::make_atom("unquote"sv);
+const patom UnquoteSplicing = SymName::make_atom("unquote-splicing"sv);
 
 constexpr bool is_word(char ch)
 {
@@ -172,38 +175,62 @@ struct ReaderFrame
 
     void push(const Position& pos, patom val)
     {
-        std::visit(
-                [&pos, &val](auto&& s) {
-                    using T = std::decay_t<decltype(s)>;
-                    if constexpr (std::is_same_v<T, std::shared_ptr<Seq>>) {
-                        if (auto m = std::dynamic_pointer_cast<Map>(s)) {
-                            // todo: map
-                            // we want to capture a key, then value,
-                            // then push, repeat. some error handling needed too
-                            // m->items.push_back(val);
-                        } else if (auto l = std::dynamic_pointer_cast<List>(s)) {
-                            l->items.push_back(val);
-                        } else if (auto v = std::dynamic_pointer_cast<Vec>(s)) {
-                            v->items.push_back(val);
-                        } else {
-                            throwError(pos, "push to unexpected seq type");
-                        }
-                    } else {
-                        // seq is expected frame to contain seq
-                        assert(false);
-                        throwError(pos, "push to unexpected stack type");
-                    }
-                },
-                seq->p);
+        if (auto s = get_if<Seq>(seq)) {
+            if (seq_cast<Map>(s.get()) || seq_cast<List>(s.get())) {
+                items.push_back(val);
+            } else if (auto v = seq_cast<Vec>(s.get())) {
+                v->items.push_back(val);
+            } else {
+                throwError(pos, "push to unexpected seq type");
+            }
+        } else {
+            // seq is expected frame to contain seq
+            assert(false);
+            throwError(pos, "push to unexpected stack type");
+        }
+    }
+
+    // the seq read, once it's done. a list's items are gathered until
+    // then, as a list can only be built from its end, and so are a map's
+    // keys and values, to be paired up.
+    patom done(const Position& pos)
+    {
+        auto s = get_if<Seq>(seq);
+        if (s && seq_cast<List>(s.get())) {
+            return List::make_atom(std::move(items));
+        } else if (s && seq_cast<Map>(s.get())) {
+            if (items.size() % 2) {
+                throwError(pos, "map literal must have an even number of forms");
+            }
+
+            Map::items_type res;
+            for (std::size_t i = 0; i < items.size(); i += 2) {
+                res.set(std::move(items[i]), std::move(items[i + 1]));
+                if (res.size() != i / 2 + 1) {
+                    throwError(pos, "duplicate key in map literal");
+                }
+            }
+            return patom(make_ref<Map>(std::move(res)));
+        }
+        return seq;
     }
 
     patom seq;
-    bool quoteNext = false;
+    std::vector<patom> items;
+    // the symbols of the prefixes (quote, syntax quote, unquote) read
+    // for the next item, outermost first
+    std::vector<patom> prefixes;
 };
 
-static patom quoteAtom(patom val)
+// wraps val in a form for each prefix, innermost first, and clears
+// them; `~x is (syntax-quote (unquote x))
+static patom wrapPrefixes(std::vector<patom>& prefixes, patom val)
 {
-    return List::make_atom({Quote, val});
+    for (auto it = prefixes.rbegin(); it != prefixes.rend(); it++) {
+        val = List::make_atom({*it, val});
+    }
+    prefixes.clear();
+    return val;
 }
 
 struct Handler
@@ -269,6 +296,10 @@ struct Handler
         if constexpr (std::is_same_v<Atom, SymName>) {
             if (str == "nil"sv) {
                 return push_atom(Nil);
+            } else if (str == "true"sv) {
+                return push_atom(True);
+            } else if (str == "false"sv) {
+                return push_atom(False);
             } else {
                 return push_atom(SymName::make_atom(str));
             }
@@ -366,16 +397,19 @@ struct Handler
                 }
                 break;
 
+            // tilde is an unquote prefix, or unquote
+            // splicing when followed by @
             case '~':
-                // todo: unquote, unquote splice
-                // tilde can stand on its own or
-                // be followed by @
-                assert(build.empty());
-                build.push_back(ch);
+                if (res = sep_emit(ch); res) {
+                    break;
+                }
                 if (peek_next() == '@') {
-                    build.push_back(get_next());
+                    get_next();
+                    res = emit_prefix(ch, UnquoteSplicing);
+                } else {
+                    res = emit_prefix(ch, Unquote);
                 }
-                return {state, makeAtom<SymName>()};
+                break;
 
             // brackets, curly brackets, and parens are all tokens,
             // as well as separators. emit any symbol we might have,
@@ -401,21 +435,16 @@ struct Handler
                 res = emit_end_frame(ch);
                 break;
 
-            // quote is a separator and a special symbol.
+            // quote and backtick are separators, and
+            // prefix the next item
             case '\'':
-                res = emit_quote(ch);
+                res = emit_prefix(ch, Quote);
                 break;
-
-            // backtick is a separator, so we may need
-            // to emit a symbol before emitting the
-            // symbol for the backtick itself. the rest
-            // of the chars here just emit their symbol.
             case '`':
-                // todo: syntax quote
-                if (res = sep_emit(ch); res) {
-                    break;
-                }
-                [[fallthrough]];
+                res = emit_prefix(ch, SyntaxQuote);
+                break;
+
+            // the rest of the chars here just emit their symbol.
             case '^':
             case '@':
                 // todo: @form -> (deref form)
@@ -843,15 +872,12 @@ struct Handler
         } else {
             build.clear();
 
-            // TODO: error on map with leftover keys!
-
             if (m_stack.size() == 1) {
                 auto& frame = m_stack.top();
-                auto seq = frame.seq;
-                if (m_quoteNext) {
-                    seq = quoteAtom(seq);
-                    m_quoteNext = false;
-                } else if (frame.quoteNext) {
+                auto seq = frame.done(m_pos);
+                if (!m_prefixes.empty()) {
+                    seq = wrapPrefixes(m_prefixes, seq);
+                } else if (!frame.prefixes.empty()) {
                     throwError("unexpected quote");
                 }
 
@@ -863,16 +889,15 @@ struct Handler
                 return seq;
             } else if (m_stack.size() > 1) {
                 // get the top sequence and pop it off
-                auto seq = m_stack.top().seq;
+                auto seq = m_stack.top().done(m_pos);
                 m_stack.pop();
 
                 // prefix quote if needed, and push the
                 // accumulated sequence or item to the
                 // next stack level
                 auto& frame = m_stack.top();
-                if (frame.quoteNext) {
-                    seq = quoteAtom(seq);
-                    frame.quoteNext = false;
+                if (!frame.prefixes.empty()) {
+                    seq = wrapPrefixes(frame.prefixes, seq);
                 }
 
                 frame.push(m_pos, seq);
@@ -884,10 +909,10 @@ struct Handler
         }
     }
 
-    // emit a quote if one has accumulated, or emit a
-    // token if not (this can be called twice, to flush
-    // then emit some single char token)
-    [[nodiscard]] patom emit_quote(char ch)
+    // emit a symbol if one has accumulated, or add a
+    // prefix for the next item if not (this can be called
+    // twice, to flush then add the prefix)
+    [[nodiscard]] patom emit_prefix(char ch, const patom& sym)
     {
         if (auto atom = sep_emit(ch); atom) {
             return atom;
@@ -895,9 +920,9 @@ struct Handler
             build.clear();
 
             if (!m_stack.empty()) {
-                m_stack.top().quoteNext = true;
+                m_stack.top().prefixes.push_back(sym);
             } else {
-                m_quoteNext = true;
+                m_prefixes.push_back(sym);
             }
             return {};
         }
@@ -909,17 +934,15 @@ struct Handler
             // quote if needed, and add it to the
             // accumulating sequence or item
             auto& frame = m_stack.top();
-            if (frame.quoteNext) {
-                atom = quoteAtom(atom);
-                frame.quoteNext = false;
+            if (!frame.prefixes.empty()) {
+                atom = wrapPrefixes(frame.prefixes, atom);
             }
 
             frame.push(m_pos, atom);
             return {};
         } else {
-            if (m_quoteNext) {
-                atom = quoteAtom(atom);
-                m_quoteNext = false;
+            if (!m_prefixes.empty()) {
+                atom = wrapPrefixes(m_prefixes, atom);
             }
 
             return atom;
@@ -935,7 +958,7 @@ struct Handler
     State state;
 
     std::stack<ReaderFrame> m_stack;
-    bool m_quoteNext = false;
+    std::vector<patom> m_prefixes;
 };
 
 patom Handler::findAtom()
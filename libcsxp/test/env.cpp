@@ -1,7 +1,20 @@
 #include "doctest.h"
 #include "csxp/env.h"
+#include "csxp/lib/lib.h"
+#include "csxp/lib/detail/special.h"
+#include "csxp/reader.h"
+#include "fmt/format.h"
+
+#include <pthread.h>
 
 #include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std::literals;
 
 TEST_SUITE_BEGIN("env");
 
@@ -17,7 +30,374 @@ TEST_CASE("can eval basic items")
     for (auto a : atoms) {
         auto env = csxp::createEnv();
         auto res = env->eval(a);
-        REQUIRE(*res == *a);
+        REQUIRE(res == a);
+    }
+}
+
+TEST_CASE("literal vecs are shared")
+{
+    auto env = csxp::createEnv();
+    for (auto val : csxp::reader("[1 [:a \"b\"] []] [1 true]"sv, "internal-test"sv)) {
+        REQUIRE(env->eval(val).get() == val.get());
+    }
+
+    for (auto val : csxp::reader("[1 [true x]]"sv, "internal-test"sv)) {
+        REQUIRE_THROWS(env->eval(val));
+    }
+}
+
+TEST_CASE("immediates are values")
+{
+    REQUIRE(csxp::Num::make_atom(7) == csxp::Num::make_atom(7));
+    REQUIRE(csxp::Num::make_atom(-7) != csxp::Num::make_atom(7));
+    REQUIRE(csxp::Num::make_atom(97) != csxp::Char::make_atom('a'));
+    REQUIRE(csxp::get<csxp::Num>(csxp::Num::make_atom(-30920))->val == -30920);
+    REQUIRE(!csxp::get_if<csxp::Char>(csxp::Num::make_atom(1)));
+
+    REQUIRE(csxp::Const::make_atom("nil") == csxp::Nil);
+    REQUIRE(csxp::is_nil(csxp::Nil));
+    REQUIRE(!csxp::truthy(csxp::False));
+    REQUIRE(csxp::truthy(csxp::True));
+    REQUIRE(csxp::truthy(csxp::Num::make_atom(0)));
+}
+
+TEST_CASE("heap atoms share their payload")
+{
+    auto str = csxp::make_ref<csxp::Str>("alice");
+    csxp::patom a(str);
+    auto b = a;
+
+    REQUIRE(a.get() == str.get());
+    REQUIRE(b.get() == str.get());
+    REQUIRE(csxp::get<csxp::Str>(b) == str);
+
+    a.reset();
+    str.reset();
+    REQUIRE(csxp::get<csxp::Str>(b)->val == "alice");
+}
+
+TEST_CASE("seqs know their kind")
+{
+    auto lst = csxp::List::make_atom();
+    auto vec = csxp::Vec::make_atom();
+    auto map = csxp::Map::make_atom();
+
+    REQUIRE(csxp::get<csxp::Seq>(lst)->seqkind == csxp::Seq::kind::list);
+    REQUIRE(csxp::get<csxp::Seq>(vec)->seqkind == csxp::Seq::kind::vec);
+    REQUIRE(csxp::get<csxp::Seq>(map)->seqkind == csxp::Seq::kind::map);
+
+    REQUIRE(csxp::get_if<csxp::List>(lst));
+    REQUIRE(!csxp::get_if<csxp::List>(vec));
+    REQUIRE(!csxp::get_if<csxp::Vec>(map));
+    REQUIRE(!csxp::get_if<csxp::Map>(csxp::Str::make_atom("map")));
+}
+
+TEST_CASE("equal values hash the same")
+{
+    auto read = [](std::string_view str) {
+        return *csxp::reader(str, "internal-test"sv).begin();
+    };
+
+    std::pair<std::string_view, std::string_view> same[] = {
+            {"[1 2 [3]]", "(1 2 [3])"},
+            {"[]", "()"},
+            {"\"a long string, past the short cases\"", "\"a long string, past the short cases\""},
+            {"{:a 1 :b [2]}", "{:b [2] :a 1}"},
+            {"{[1] :x}", "{(1) :x}"},
+    };
+    for (auto& [lhs, rhs] : same) {
+        auto l = read(lhs);
+        auto r = read(rhs);
+        REQUIRE(l == r);
+        REQUIRE(csxp::hash(l) == csxp::hash(r));
+    }
+
+    std::pair<std::string_view, std::string_view> differ[] = {
+            {"[1 2]", "[2 1]"},
+            {"[1]", "[1 1]"},
+            {"\"ab\"", "\"ba\""},
+            {"{:a 1}", "[:a 1]"},
+            {"{:a 1 :b 2}", "{:a 2 :b 1}"},
+    };
+    for (auto& [lhs, rhs] : differ) {
+        auto l = read(lhs);
+        auto r = read(rhs);
+        REQUIRE(l != r);
+        REQUIRE(csxp::hash(l) != csxp::hash(r));
+    }
+
+    // kept, and still equal when both are known
+    auto vec = read("[1 2 3]");
+    auto h = csxp::hash(vec);
+    REQUIRE(csxp::get<csxp::Vec>(vec)->hashval == h);
+    REQUIRE(csxp::hash(read("(1 2 3)")) == h);
+    REQUIRE(vec == read("(1 2 3)"));
+}
+
+TEST_CASE("symbols and keywords are interned")
+{
+    auto a = csxp::SymName::intern("ns/abc");
+    auto b = csxp::get<csxp::SymName>(csxp::SymName::make_atom("ns/abc"));
+    REQUIRE(a == b);
+    REQUIRE(a->nspart() == "ns"sv);
+    REQUIRE(a->basename() == "abc"sv);
+    REQUIRE(a->nssym == csxp::SymName::intern("ns").get());
+    REQUIRE(a->basesym == csxp::SymName::intern("abc").get());
+    REQUIRE(a->hash == csxp::hashString("ns/abc"sv));
+
+    auto div = csxp::SymName::intern("/");
+    REQUIRE(!div->nssym);
+    REQUIRE(div->basesym == div.get());
+    REQUIRE(div->basename() == "/"sv);
+
+    REQUIRE(csxp::Keyword::make_atom(":k") == csxp::Keyword::make_atom(":k"));
+    REQUIRE(csxp::Keyword::make_atom(":k").get() == csxp::Keyword::make_atom(":k").get());
+    REQUIRE(csxp::Keyword::make_atom(":k") != csxp::SymName::make_atom(":k"));
+
+    for (auto val : csxp::reader("(abc abc)"sv, "internal-test"sv)) {
+        auto lst = csxp::get<csxp::List>(val);
+        REQUIRE(lst->items[0].get() == lst->items[1].get());
+        REQUIRE(lst->items[0].get() == csxp::SymName::intern("abc").get());
+    }
+}
+
+TEST_CASE("special forms are known when interned")
+{
+    using csxp::lib::detail::special::form;
+    namespace special = csxp::lib::detail::special;
+
+    for (auto f = form::and_; f <= form::when;
+            f = static_cast<form>(static_cast<int>(f) + 1)) {
+        INFO(special::name(f));
+        REQUIRE(special::lookup(special::name(f)) == f);
+        REQUIRE(special::of(csxp::SymName::intern(special::name(f)).get()) == f);
+    }
+
+    REQUIRE(special::lookup("iff"sv) == form::none);
+    REQUIRE(special::lookup("f"sv) == form::none);
+    REQUIRE(special::lookup(""sv) == form::none);
+    REQUIRE(special::of(csxp::SymName::intern("user/if").get()) == form::none);
+}
+
+TEST_CASE("frames are a stack")
+{
+    auto env = csxp::createEnv();
+    env->maxDepth(20000);
+    REQUIRE(env->currFrame() == nullptr);
+
+    // enough, and big enough, to take more than one block of each
+    std::vector<std::unique_ptr<csxp::EnvFrame>> frames;
+    for (int i = 0; i < 10000; i++) {
+        auto& ef = frames.emplace_back(std::make_unique<csxp::EnvFrame>(
+                env.get(), i % 1000 == 0 ? 5000 : 3));
+        REQUIRE(env->currFrame() == ef->get());
+        ef->get()->slots[2] = csxp::Num::make_atom(i);
+    }
+
+    while (!frames.empty()) {
+        auto frame = frames.back()->get();
+        REQUIRE(frame->slots[0] == csxp::patom());
+        REQUIRE(frame->slots[2] == csxp::Num::make_atom(frames.size() - 1));
+        frames.pop_back();
+        REQUIRE(env->currFrame() == (frames.empty() ? nullptr : frames.back()->get()));
+    }
+
+    // popped slots are emptied for reuse
+    csxp::EnvFrame ef{env.get(), 3};
+    REQUIRE(ef->slots[2] == csxp::patom());
+}
+
+TEST_CASE("depth is limited")
+{
+    // nested vecs, and nested calls
+    auto shallow = fmt::format("{}{}", std::string(50, '['), std::string(50, ']'));
+    auto deep = fmt::format("{}{}", std::string(200, '['), std::string(200, ']'));
+    auto recursive = "(defn f [n] (if (= n 0) 0 (+ 0 (f (- n 1))))) (f 200)"sv;
+
+    for (auto engine : {csxp::Engine::tree, csxp::Engine::vm}) {
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+        env->maxDepth(100);
+        for (auto val : csxp::reader(shallow, "internal-test"sv)) {
+            REQUIRE(env->eval(val));
+        }
+        for (auto val : csxp::reader(deep, "internal-test"sv)) {
+            REQUIRE_THROWS_AS(env->eval(val), csxp::EnvError);
+        }
+
+        auto res = csxp::patom();
+        auto run = [&] {
+            for (auto val : csxp::reader(recursive, "internal-test"sv)) {
+                res = env->eval(val);
+            }
+        };
+        REQUIRE_THROWS_AS(run(), csxp::EnvError);
+
+        // and the env is still usable
+        env->maxDepth(1000);
+        run();
+        REQUIRE(res == csxp::Num::make_atom(0));
+    }
+}
+
+TEST_CASE("vm recursion doesn't nest on the native stack")
+{
+    // deep, and not in tail position, on a thread with a small stack;
+    // each call nesting natively would overflow it long before the end
+    struct Run
+    {
+        static void* run(void* arg)
+        {
+            auto res = static_cast<csxp::patom*>(arg);
+            auto env = csxp::createEnv(csxp::Engine::vm);
+            csxp::lib::addCore(env.get());
+            csxp::lib::addMath(env.get());
+            env->maxDepth(1000000);
+            for (auto val : csxp::reader(
+                         "(defn f [n] (if (= n 0) 0 (+ 1 (f (- n 1))))) (f 100000)"sv,
+                         "internal-test"sv)) {
+                *res = env->eval(val);
+            }
+            return nullptr;
+        }
+    };
+
+    csxp::patom res;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    REQUIRE(pthread_create(&thread, &attr, Run::run, &res) == 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    REQUIRE(res == csxp::Num::make_atom(100000));
+}
+
+TEST_CASE("tree recursion stops before the native stack runs out")
+{
+    // nesting natively for every call, on a thread with a small stack,
+    // with no depth limit to stop it first
+    struct Run
+    {
+        static void* run(void* arg)
+        {
+            auto res = static_cast<std::pair<bool, csxp::patom>*>(arg);
+            auto env = csxp::createEnv(csxp::Engine::tree);
+            csxp::lib::addCore(env.get());
+            csxp::lib::addMath(env.get());
+            env->maxDepth(1000000);
+            auto run = [&](std::string_view code) {
+                for (auto val : csxp::reader(code, "internal-test"sv)) {
+                    res->second = env->eval(val);
+                }
+            };
+
+            run("(defn f [n] (if (= n 0) 0 (+ 1 (f (- n 1)))))"sv);
+            try {
+                run("(f 100000)"sv);
+            } catch (const csxp::EnvError&) {
+                res->first = true;
+            }
+
+            // and the env is still usable
+            run("(f 10)"sv);
+            return nullptr;
+        }
+    };
+
+    std::pair<bool, csxp::patom> res;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    REQUIRE(pthread_create(&thread, &attr, Run::run, &res) == 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    REQUIRE(res.first);
+    REQUIRE(res.second == csxp::Num::make_atom(10));
+}
+
+TEST_CASE("destroying an env frees its fns")
+{
+    for (auto engine : {csxp::Engine::tree, csxp::Engine::vm}) {
+        auto vm = engine == csxp::Engine::vm;
+        CAPTURE(vm);
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        // recursive, mutually recursive, and folded into constants
+        // guarded on their vars
+        for (auto val : csxp::reader(R"-(
+                (defn f [n] (if (= n 0) 0 (+ 1 (f (- n 1)))))
+                (defn g [n] (if (= n 0) 0 (h (- n 1))))
+                (defn h [n] (g n))
+                (defn k [] [(+ 1 2) (f 3) (g 3)])
+                (def v [1 2])
+                (k)
+                )-"sv,
+                     "internal-test"sv)) {
+            env->eval(val);
+        }
+
+        std::vector<csxp::patom> vals;
+        for (auto name : {"f"sv, "g"sv, "h"sv, "k"sv, "v"sv}) {
+            vals.push_back(env->resolve(csxp::SymName::intern(name).get()));
+        }
+
+        env.reset();
+        for (auto& val : vals) {
+            REQUIRE(val.get()->use_count() == 1);
+        }
+    }
+}
+
+TEST_CASE("vm code leaves no extra references")
+{
+    auto env = csxp::createEnv(csxp::Engine::vm);
+    csxp::lib::addCore(env.get());
+    csxp::lib::addMath(env.get());
+
+    // made by ops, and returned from a vm fn into a register that held
+    // something already
+    csxp::patom res;
+    for (auto val : csxp::reader(
+                 "(defn f [a] [a {:a a} (fn [] a)]) (let [a 1 b (f a) b (f b)] [a b])"sv,
+                 "internal-test"sv)) {
+        res = env->eval(val);
+    }
+
+    env.reset();
+    REQUIRE(res.get()->use_count() == 1);
+    auto b = csxp::get<csxp::Vec>(res)->items[1];
+    REQUIRE(b.get()->use_count() == 2);
+}
+
+TEST_CASE("call sites don't hold the fn they're in")
+{
+    for (auto engine : {csxp::Engine::tree, csxp::Engine::vm}) {
+        auto vm = engine == csxp::Engine::vm;
+        CAPTURE(vm);
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        auto run = [&](std::string_view code) {
+            for (auto val : csxp::reader(code, "internal-test"sv)) {
+                env->eval(val);
+            }
+        };
+
+        // so the old one is freed when it's redefined, with the env
+        // still going
+        auto f = csxp::SymName::intern("f"sv);
+        run("(defn f [n] (if (= n 0) 0 (+ 1 (f (- n 1))))) (f 3)"sv);
+        auto old = env->resolve(f.get());
+        run("(defn f [n] n)"sv);
+        REQUIRE(old.get()->use_count() == 1);
     }
 }
 
@@ -163,6 +163,10 @@ TEST_CASE("destructure vec")
                  [a b c v])
                [5 6 [7 8 9 10] [5 6 7 8 9 10]])
             )-"},
+            {"nested vec after rest", "(= (let [[a & [b c]] [1 2 3 4]] [a b c]) [1 2 3])"},
+            {"nested vec with as", "(= (let [[a [b :as v]] [1 [2 3]]] [a b v]) [1 2 [2 3]])"},
+            {"vec destructure lazy seq", "(= (let [[a b & c] (take 3 (repeat 7))] [a b c]) [7 7 [7]])"},
+            {"nested fn params", "(= ((fn [[a [b c]] d] [a b c d]) [1 [2 3]] 4) [1 2 3 4])"},
 
             /* todo: this is broken too, need iterate str
         // binding string, nested, & and :as, aliasing str
@@ -173,6 +177,12 @@ TEST_CASE("destructure vec")
         )-"},
             */
     });
+
+    testStringsLibError({
+            {"as without a symbol", "(let [[a :as] [1]] a)"},
+            {"rest without a symbol", "(let [[a &] [1]] a)"},
+            {"unknown keyword", "(let [[a :or b] [1 2]] a)"},
+    });
 }
 
 /*
@@ -172,6 +172,7 @@ TEST_CASE("seq")
             {"one item sequence", "(= (seq '(1)) '(1))"},
             {"two item sequence", "(= (seq '(1 2)) '(1 2))"},
             {"two item vec", "(= (seq [1 2]) '(1 2))"},
+            {"items not evaluated again", "(= (seq '(a b)) '(a b))"},
             // todo: string sequence
             //{"string sequence", "(= (seq \"abc\") '(\\a \\b \\c))"},
             //{"empty string", "(= (seq "") nil)"},
@@ -225,6 +226,11 @@ TEST_CASE("rest")
             {"two item sequence", "(= (rest '(1 2)) '(2))"},
             {"two item vec", "(= (rest [1 2]) '(2))"},
             {"three item sequence", "(= (rest '(1 2 3)) '(2 3))"},
+            {"walked to the end", R"-(
+                (= (loop [xs '(1 2 3 4 5) acc 0]
+                     (if (seq xs) (recur (rest xs) (+ acc (first xs))) acc))
+                   15)
+                )-"},
             // todo: string sequence
             //{"string sequence", "(= (rest \"abc\") '(\\b \\c))"},
             //{"empty string", "(= (rest "") '())"},
@@ -281,6 +287,8 @@ TEST_CASE("cons")
             {"vec", "(= (cons 1 [2 3 4 5 6]) '(1 2 3 4 5 6))"},
             {"two item sequence", "(= (cons '(3 4) '(1 2)) '((3 4) 1 2))"},
             {"two item vec", "(= (cons [3 4] '(1 2)) '([3 4] 1 2))"},
+            {"rest of cons", "(= (rest (cons 1 '(2 3))) '(2 3))"},
+            {"count of cons", "(= (count (cons 1 '(2 3))) 3)"},
     });
 
     // todo: verify that seq arg is not evaluated!
@@ -320,6 +328,7 @@ TEST_CASE("reduce")
             {"two items with val", "(= (reduce + 1 [2 3]) 6)"},
             {"eval seq", "(= (reduce + [(+ 2 3) 1]) 6)"},
             {"eval seq with eval val", "(= (reduce + (inc 1) [(+ 2 3) 1]) 8)"},
+            {"vals aren't evaluated again", "(= (reduce (fn [acc x] (cons x acc)) '() [1 2 3]) '(3 2 1))"},
     });
 }
 
@@ -456,12 +465,161 @@ TEST_CASE("repeatedly")
 
 TEST_CASE("conj")
 {
-    // todo
+    testStringsTrue({
+            {"vec", "(= (conj [1 2] 3 4) [1 2 3 4])"},
+            {"list", "(= (conj '(1 2) 3 4) '(4 3 1 2))"},
+            {"nil", "(= (conj nil 1) '(1))"},
+            {"original unchanged", R"-(
+            (def a [1 2])
+            (def b (conj a 3))
+            (= [a b] [[1 2] [1 2 3]])
+            )-"},
+            {"past a leaf", R"-(
+            (def a (loop [i 0 v []] (if (= i 100) v (recur (inc i) (conj v i)))))
+            (def b (conj a 100))
+            (= [(count a) (count b) (nth a 99) (nth b 100) (nth b 31) (nth b 32)]
+               [100 101 99 100 31 32])
+            )-"},
+    });
+    testStringLibError({"not a collection", "(conj 1 2)"});
 }
 
 TEST_CASE("assoc")
 {
-    // todo
+    testStringsTrue({
+            {"replace", "(= (assoc [1 2 3] 1 :a) [1 :a 3])"},
+            {"append", "(= (assoc [1 2] 2 3) [1 2 3])"},
+            {"several", "(= (assoc [1 2 3] 0 :a 2 :c) [:a 2 :c])"},
+            {"deep, original unchanged", R"-(
+            (def a (loop [i 0 v []] (if (= i 2000) v (recur (inc i) (conj v i)))))
+            (def b (assoc a 1500 :x))
+            (= [(nth a 1500) (nth b 1500) (nth b 1499) (count b)] [1500 :x 1499 2000])
+            )-"},
+    });
+    testStringsLibError({
+            {"out of bounds", "(assoc [1 2] 3 3)"},
+            {"negative", "(assoc [1 2] -1 3)"},
+            {"missing val", "(assoc [1 2] 0)"},
+    });
+}
+
+TEST_CASE("maps")
+{
+    testStringsTrue({
+            {"literal", "(= {:a 1 :b 2} {:b 2 :a 1})"},
+            {"evaluated", "(= (let [x 1] {:a x (inc x) :b}) {:a 1 2 :b})"},
+            {"in a fn", "(= ((fn [x] {:a x}) 1) {:a 1})"},
+            {"count", "(= (count {:a 1 :b 2}) 2)"},
+            {"not equal", "(not (= {:a 1} {:a 2}))"},
+            {"not a vec", "(not (= {} []))"},
+            {"entries", "(= (seq {:a 1}) '([:a 1]))"},
+            {"conj", "(= (conj {:a 1} [:b 2]) {:a 1 :b 2})"},
+            {"past an array map", R"-(
+            (def m (loop [i 0 m {}] (if (= i 1000) m (recur (inc i) (assoc m i (* i i))))))
+            (= [(count m) (get m 0) (get m 31) (get m 999) (get m 1000)]
+               [1000 0 961 998001 nil])
+            )-"},
+    });
+}
+
+TEST_CASE("get")
+{
+    testStringsTrue({
+            {"map", "(= (get {:a 1} :a) 1)"},
+            {"missing", "(= (get {:a 1} :b) nil)"},
+            {"default", "(= (get {:a 1} :b :none) :none)"},
+            {"vec", "(= (get [1 2] 1) 2)"},
+            {"nil", "(= (get nil :a :none) :none)"},
+            {"keyword", "(= (:a {:a 1}) 1)"},
+            {"keyword default", "(= (:b {:a 1} 2) 2)"},
+            {"keyword in a fn", "(= ((fn [m] (:a m)) {:a 1}) 1)"},
+            {"keyword as an arg", R"-(
+            (defn f [k m] (k m))
+            (= [(f :a {:a 1}) (f :b {:a 1})] [1 nil])
+            )-"},
+            {"keyword in a local", "(= (let [k :b] (k {:a 1} 3)) 3)"},
+            {"keyword to a builtin", "(= (some :a [{:b 1} {:a 2}]) 2)"},
+    });
+}
+
+TEST_CASE("map updates")
+{
+    testStringsTrue({
+            {"assoc", "(= (assoc {:a 1} :b 2 :a 3) {:a 3 :b 2})"},
+            {"assoc nil", "(= (assoc nil :a 1) {:a 1})"},
+            {"dissoc", "(= (dissoc {:a 1 :b 2} :a :c) {:b 2})"},
+            {"contains?", "(= [(contains? {:a nil} :a) (contains? {:a 1} :b)] [true false])"},
+            {"original unchanged", R"-(
+            (def a {:a 1})
+            (def b (assoc a :b 2))
+            (def c (dissoc b :a))
+            (= [a b c] [{:a 1} {:a 1 :b 2} {:b 2}])
+            )-"},
+    });
+    testStringsLibError({
+            {"assoc missing val", "(assoc {:a 1} :b)"},
+            {"conj not an entry", "(conj {:a 1} 2)"},
+    });
+}
+
+TEST_CASE("transients")
+{
+    testStringsTrue({
+            {"vec", R"-(
+            (def t (loop [i 0 t (transient [])] (if (= i 100) t (recur (inc i) (conj! t i)))))
+            (def v (persistent! t))
+            (= [(count v) (nth v 0) (nth v 99)] [100 0 99])
+            )-"},
+            {"map", "(= (persistent! (conj! (assoc! (transient {:a 1}) :b 2) [:c 3])) {:a 1 :b 2 :c 3})"},
+            {"assoc! vec", "(= (persistent! (assoc! (transient [1 2]) 0 :a 2 :c)) [:a 2 :c])"},
+            {"count", "(= (count (conj! (transient [1]) 2)) 2)"},
+            {"original unchanged", R"-(
+            (def a (loop [i 0 v []] (if (= i 1000) v (recur (inc i) (conj v i)))))
+            (def t (transient a))
+            (conj! t 1000)
+            (assoc! t 500 :x)
+            (def b (persistent! t))
+            (= [(count a) (nth a 500) (count b) (nth b 500) (nth b 1000)]
+               [1000 500 1001 :x 1000])
+            )-"},
+    });
+    testStringsLibError({
+            {"used after persistent!", "(def t (transient [])) (persistent! t) (conj! t 1)"},
+            {"not a transient", "(conj! [] 1)"},
+            {"not a vec or map", "(transient '(1))"},
+    });
+}
+
+TEST_CASE("nth")
+{
+    testStringsTrue({
+            {"vec", "(= (nth [1 2 3] 2) 3)"},
+            {"list", "(= (nth '(1 2 3) 0) 1)"},
+            {"not found", "(= (nth [1 2 3] 3 :none) :none)"},
+            {"nil", "(= (nth nil 0 :none) :none)"},
+    });
+    testStringsLibError({
+            {"out of bounds", "(nth [1 2 3] 3)"},
+            {"negative", "(nth [1 2 3] -1)"},
+    });
+}
+
+TEST_CASE("pop")
+{
+    testStringsTrue({
+            {"vec", "(= (pop [1 2 3]) [1 2])"},
+            {"list", "(= (pop '(1 2 3)) '(2 3))"},
+            {"back past a leaf", R"-(
+            (def a (loop [i 0 v []] (if (= i 1057) v (recur (inc i) (conj v i)))))
+            (def b (loop [i 0 v a] (if (= i 1030) v (recur (inc i) (pop v)))))
+            (def c (loop [i 0 v []] (if (= i 27) v (recur (inc i) (conj v i)))))
+            (= [(count a) (count b) (nth b 26) (nth a 1056) (conj b :x)]
+               [1057 27 26 1056 (conj c :x)])
+            )-"},
+    });
+    testStringsLibError({
+            {"empty vec", "(pop [])"},
+    });
 }
 
 TEST_SUITE_END();
@@ -1,5 +1,13 @@
 #include "doctest.h"
 #include "run-helpers.h"
+#include "csxp/lib/detail/analyze.h"
+#include "csxp/lib/detail/callcache.h"
+#include "csxp/lib/lib.h"
+#include "csxp/reader.h"
+
+#include <string>
+
+using namespace std::literals;
 
 TEST_SUITE_BEGIN("lib-fn");
 
@@ -9,6 +17,9 @@ TEST_CASE("fn")
 {
     testStringsTrue({
             {"inline call fn", "(= ((fn [a] [a a]) 3) [3 3])"},
+            {"many args", "(= ((fn [a b c d e f g h i j] [a j]) 1 2 3 4 5 6 7 8 9 10) [1 10])"},
+            {"many args to builtin", "(= (+ 1 2 3 4 5 6 7 8 9 10) 55)"},
+            {"variadic", "(= [((fn [a & r] r) 1) ((fn [a & r] [a r]) 1 2 3)] [nil [1 [2 3]]])"},
             {"let fn", R"-(
             (= (let [f (fn [a] [a a])]
                  (f 4)
@@ -21,6 +32,285 @@ TEST_CASE("fn")
                  (if true (f 33) (f 44)))
                [33 33])
             )-"},
+            {"multi-arity", R"-(
+            (defn argcount ([] 0) ([x] 1) ([x y] 2) ([x y & more]
+              (+ (argcount x y) (count more))))
+            (= [(argcount) (argcount 1) (argcount 1 2) (argcount 1 2 3 4 5)] [0 1 2 5])
+            )-"},
+            {"multi-arity closure", R"-(
+            (defn f [a] (fn ([] a) ([b] [a b])))
+            (= [((f 1)) ((f 1) 2)] [1 [1 2]])
+            )-"},
+            {"multi-arity self call", R"-(
+            (defn f ([n] (f n 0)) ([n acc] (if (= n 0) acc (f (- n 1) (+ acc 1)))))
+            (= (f 100000) 100000)
+            )-"},
+    });
+
+    testStringsLibError({
+            {"no arity", "((fn ([] 0) ([a b] 2)) 1)"},
+            {"too many args", "((fn ([] 0) ([a] 1)) 1 2)"},
+            {"missing arg", "((fn ([a b] 0)) 1)"},
+            {"same arity twice", "(fn ([a] 0) ([b] 1))"},
+            {"two variadic arities", "(fn ([& a] 0) ([b & c] 1))"},
+            {"fixed arity past variadic", "(fn ([a b] 0) ([& c] 1))"},
+    });
+}
+
+TEST_CASE("locals")
+{
+    testStringsTrue({
+            {"shadowed let", "(= (let [x 1 x (inc x)] x) 2)"},
+            {"let init can't see its binding", R"-(
+            (def x 10)
+            (= (let [x (inc x)] x) 11)
+            )-"},
+            {"nested let in fn", R"-(
+            (defn f [a]
+              (let [b (inc a)]
+                (let [c (+ a b)]
+                  [a b c])))
+            (= (f 1) [1 2 3])
+            )-"},
+            {"closure sees let in fn", R"-(
+            (defn f [a]
+              (let [g (let [b (inc a)] (fn [] b))
+                    c 9]
+                (g)))
+            (= (f 1) 2)
+            )-"},
+            {"local shadows special form", "(= (let [quote inc] (quote 1)) 2)"},
+            {"quoted local is a symbol", "(= (let [x 1] 'x) 'x)"},
+            {"lazy-seq closes over fn", R"-(
+            (defn f [n] (lazy-seq (cons n nil)))
+            (= (first (f 5)) 5)
+            )-"},
+            {"closure captures through fns", "(= ((((fn [a] (fn [] (fn [] a))) 7))) 7)"},
+            {"closures in loop keep their iteration", R"-(
+            (= (loop [i 0 fs nil]
+                 (if (= i 3)
+                   [((first fs)) ((first (rest fs))) ((first (rest (rest fs))))]
+                   (recur (+ i 1) (cons (fn [] i) fs))))
+               [2 1 0])
+            )-"},
+    });
+}
+
+TEST_CASE("vars")
+{
+    testStringsTrue({
+            {"redefinition is visible", R"-(
+            (defn g [] 1)
+            (defn f [] (g))
+            (defn g [] 2)
+            (= (f) 2)
+            )-"},
+            {"defn refers to itself", R"-(
+            (defn f [n] (if (= n 0) 0 (+ 2 (f (- n 1)))))
+            (= (f 3) 6)
+            )-"},
+            {"def refers to itself", R"-(
+            (def f (fn [n] (if (= n 0) 0 (+ 2 (f (- n 1))))))
+            (= (f 3) 6)
+            )-"},
+            {"defined after fn", R"-(
+            (defn f [] (h))
+            (defn h [] 4)
+            (= (f) 4)
+            )-"},
+    });
+}
+
+TEST_CASE("call site caches")
+{
+    testStringsTrue({
+            {"callee changes between calls", R"-(
+            (defn f [g x] (g x))
+            (= [(f inc 1) (f inc 2) (f count [1]) (f (fn [a] [a]) 1) (f (fn [a & r] r) 1)]
+               [2 3 1 [1] nil])
+            )-"},
+            {"builtin and fn at one site", R"-(
+            (defn f [g] (g 1 2))
+            (= [(f +) (f (fn [a b] b)) (f +)] [3 2 3])
+            )-"},
+            {"arity changes with the callee", R"-(
+            (defn h ([a] 1) ([a b] 2))
+            (defn f [] (h 1))
+            (f)
+            (defn h ([a] 3))
+            (= (f) 3)
+            )-"},
+    });
+
+    testStringsLibError({
+            {"no arity for the site", R"-(
+            (defn f [g] (g 1))
+            (f inc)
+            (f (fn [] 0))
+            )-"},
+    });
+
+    namespace callcache = csxp::lib::detail::callcache;
+    forEachEngine([](csxp::Engine engine) {
+        auto env = csxp::createEnv(engine);
+        csxp::lib::addCore(env.get());
+        csxp::lib::addMath(env.get());
+
+        std::string_view defs = "(defn g [x] x) (defn f [] (g 1))";
+        for (auto val : csxp::reader(defs, "test"sv)) {
+            env->eval(val);
+        }
+
+        // called as is, so the only site is the one in f
+        std::string_view name = "f";
+        auto f = csxp::get_if<csxp::Callable>(env->eval(*csxp::reader(name, "test"sv).begin()));
+        REQUIRE(f);
+        callcache::resetStats();
+        for (int i = 0; i < 10; i++) {
+            f->call(env.get(), nullptr, 0);
+        }
+
+        // the first call of g misses, the rest hit
+        auto stats = callcache::stats();
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.hits == 9);
+    });
+}
+
+TEST_CASE("compiled forms")
+{
+    testStringsTrue({
+            {"if without else", "(= ((fn [x] (if x 1)) false) nil)"},
+            {"do", "(= ((fn [x] (do (inc x) (inc (inc x)))) 1) 3)"},
+            {"quoted list", "(= ((fn [] '(a b))) '(a b))"},
+            {"vec of locals", "(= ((fn [a b] [a [b a]]) 1 2) [1 [2 1]])"},
+            {"builtin gets compiled args", R"-(
+            (defn f [a b] (and (when a b) (count [a b])))
+            (= (f 1 2) 2)
+            )-"},
+            {"local shadows if", "(= (let [if (fn [a b c] c)] (if true 1 2)) 2)"},
+            {"global doesn't shadow if", R"-(
+            (def if (fn [a b c] c))
+            (= (if true 1 2) ((fn [] (if true 1 2))) 1)
+            )-"},
+            {"and, or, when", R"-(
+            (defn f [a b] [(and a b) (or a b) (when a b b)])
+            (= [(f nil 1) (f 2 false)] [[nil 1 nil] [false 2 false]])
+            )-"},
+            {"def in fn", R"-(
+            (defn f [x] (def y (inc x)))
+            (f 4)
+            (= y 5)
+            )-"},
+            {"fn created per call", R"-(
+            (defn adder [n] (fn [x] (+ x n)))
+            (= ((adder 1) 1) ((adder 0) 2) 2)
+            )-"},
+    });
+}
+
+TEST_CASE("constant folding")
+{
+    testStringsTrue({
+            {"folded values", R"-(
+            (defn f [] [(* (+ 1 2) 3) (if true :a :b) (if nil 1) [1 '(2 3)] (not= 1 (inc 0))])
+            (= (f) [9 :a nil [1 '(2 3)] false])
+            )-"},
+            {"errors wait for the call", R"-(
+            (defn f [x] (if x (+ 1 :a) 2))
+            (= (f false) 2)
+            )-"},
+            {"marked pure", R"-(
+            (def n 0)
+            (defn sq [x] (def n (+ n 1)) (* x x))
+            (mark-pure sq)
+            (defn f [] (sq 3))
+            (f)
+            (= [(f) n] [9 1])
+            )-"},
+            {"redefined callee", R"-(
+            (defn f [] (+ 1 2))
+            (defn g [] [(* (+ 1 2) 3) {:a (+ 1 1)}])
+            (def + -)
+            (= [(f) (g)] [-1 [-3 {:a 0}]])
+            )-"},
+            {"redefined pure fn", R"-(
+            (defn sq [x] (* x x))
+            (mark-pure sq)
+            (defn f [] (sq 3))
+            (defn sq [x] (+ x x))
+            (= (f) 6)
+            )-"},
+    });
+
+    namespace analyze = csxp::lib::detail::analyze;
+    analyze::resetFoldStats();
+    runString("(defn f [a] [(+ 1 2) (if true 1 2) [a]])");
+    auto stats = analyze::foldStats();
+    REQUIRE(stats.calls == 1);
+    REQUIRE(stats.branches == 1);
+    REQUIRE(stats.vecs == 0);
+
+    analyze::resetFoldStats();
+    runString("(defn f [] [(+ 1 2) :a])");
+    REQUIRE(analyze::foldStats().vecs == 1);
+
+    // deeply nested folds guard each var once, rather than once for
+    // every fold it's in
+    std::string nested = "0";
+    for (int i = 0; i < 300; i++) {
+        nested = "(+ 1 " + nested + ")";
+    }
+    testStringsTrue({
+            {"deeply nested folds", "(defn f [] " + nested + ") (= (f) 300)"},
+            {"deeply nested, redefined",
+                    "(defn f [] " + nested + ") (def + *) (= (f) 0)"},
+    });
+}
+
+TEST_CASE("loop and recur")
+{
+    testStringsTrue({
+            {"loop", R"-(
+            (= (loop [i 0 acc 0]
+                 (if (= i 100000) acc (recur (inc i) (+ acc 2))))
+               200000)
+            )-"},
+            {"recur sees old values", R"-(
+            (= (loop [a 1 b 2 n 0]
+                 (if (= n 3) [a b] (recur b a (inc n))))
+               [2 1])
+            )-"},
+            {"destructuring loop", R"-(
+            (= (loop [[a b] [0 1] n 0]
+                 (if (= n 10) a (recur [b (+ a b)] (inc n))))
+               55)
+            )-"},
+            {"loop in fn", R"-(
+            (defn f [n] (let [x 2] (loop [i n acc x] (if (= i 0) acc (recur (- i 1) (* acc 2))))))
+            (= (f 3) 16)
+            )-"},
+            {"recur fn", R"-(
+            (defn f [n acc] (if (= n 0) acc (recur (- n 1) (inc acc))))
+            (= (f 100000 0) 100000)
+            )-"},
+            {"self tail call", R"-(
+            (defn count-down [n] (if (= n 0) :done (do (count-down (- n 1)))))
+            (= (count-down 100000) :done)
+            )-"},
+            {"self call after redefinition", R"-(
+            (defn f [n] (if (= n 0) 0 (f (- n 1))))
+            (def g f)
+            (defn f [n] 42)
+            (= (g 3) 42)
+            )-"},
+    });
+
+    testStringsLibError({
+            {"recur not in tail position", "(loop [i 0] (inc (recur i)))"},
+            {"recur arg count", "(loop [i 0] (recur 1 2))"},
+            {"recur in fn arg count", "(defn f [a] (recur))"},
+            {"recur outside loop", "(let [x 1] (recur x))"},
     });
 }
 
@@ -0,0 +1,81 @@
+#include "doctest.h"
+#include "run-helpers.h"
+
+TEST_SUITE_BEGIN("lib-macro");
+
+TEST_CASE("defmacro")
+{
+    testStringsTrue({
+            {"macro", R"-(
+            (defmacro unless [test then else] `(if ~test ~else ~then))
+            (= (unless false 1 2) 1)
+            )-"},
+            {"docstring", R"-(
+            (defmacro same "gives its arg" [x] x)
+            (= (same 3) 3)
+            )-"},
+            {"splicing", R"-(
+            (defmacro my-do [& body] `(do ~@body))
+            (= (my-do 1 2 3) 3)
+            )-"},
+            {"gensym", R"-(
+            (defmacro twice [x] `(let [v# ~x] [v# v#]))
+            (= (twice (+ 1 2)) [3 3])
+            )-"},
+            {"macro in fn", R"-(
+            (defmacro unless [test then else] `(if ~test ~else ~then))
+            (defn f [a] (unless a :no :yes))
+            (= [(f nil) (f 1)] [:no :yes])
+            )-"},
+            {"expanded once per call site", R"-(
+            (def n 0)
+            (defmacro counted [x] (def n (+ n 1)) x)
+            (defn f [] (counted 5))
+            (f)
+            (f)
+            (= (f) 5)
+            (= n 1)
+            )-"},
+            {"local shadows macro", R"-(
+            (defmacro unless [test then else] `(if ~test ~else ~then))
+            (= (let [unless (fn [a b c] c)] (unless false 1 2)) 2)
+            )-"},
+            {"def clears macro", R"-(
+            (defmacro m [x] 'x)
+            (def m (fn [x] x))
+            (= (m 4) 4)
+            )-"},
+    });
+}
+
+TEST_CASE("macroexpand")
+{
+    testStringsTrue({
+            {"macroexpand-1", R"-(
+            (defmacro unless [test then else] `(if ~test ~else ~then))
+            (= (macroexpand-1 '(unless a 1 2)) '(if a 2 1))
+            )-"},
+            {"macroexpand", R"-(
+            (defmacro m1 [x] `(m2 ~x))
+            (defmacro m2 [x] `(+ ~x 1))
+            (= [(macroexpand-1 '(m1 3)) (macroexpand '(m1 3))] ['(m2 3) '(+ 3 1)])
+            )-"},
+            {"not a macro", "(= (macroexpand '(+ 1 2)) '(+ 1 2))"},
+    });
+}
+
+TEST_CASE("syntax-quote")
+{
+    testStringsTrue({
+            {"symbols", "(= `(a b) '(a b))"},
+            {"unquote", "(= (let [x 1] `(a ~x [~x])) '(a 1 [1]))"},
+            {"splice", "(= `[1 ~@[2 3] 4 ~@nil] [1 2 3 4])"},
+            {"in fn", "(= ((fn [a & more] `(~a ~@more)) 1 2 3) '(1 2 3))"},
+    });
+
+    testStringsLibError({
+            {"splice outside of a list", "`~@[1 2]"},
+    });
+}
+
+TEST_SUITE_END();
@@ -111,4 +111,43 @@ TEST_CASE("op gte")
     });
 }
 
+TEST_CASE("long hints")
+{
+    testStringsTrue({
+            {"hinted loop", R"-(
+            (defn sum [^long n]
+              (loop [^long i 0 ^long acc 0]
+                (if (< i n) (recur (inc i) (+ acc i)) acc)))
+            (= (sum 1000) 499500)
+            )-"},
+            {"nested math", R"-(
+            (defn f [^long a ^long b] (let [^long c (* a b)] [(+ (* a b) c 1) (- c a b) (<= a b) (>= a b) (> c a)]))
+            (= (f 3 4) [25 5 true false true])
+            )-"},
+            {"captured hinted local", R"-(
+            (defn f [^long a] (fn [^long b] (+ a b)))
+            (= ((f 1) 2) 3)
+            )-"},
+            {"other metadata is dropped", "(= (let [^String s \"a\" ^:private n 1] [s n]) [\"a\" 1])"},
+            {"redefined builtin", R"-(
+            (defn f [^long a] (+ a 1))
+            (f 1)
+            (def + (fn [a b] [a b]))
+            (= (f 1) [1 1])
+            )-"},
+    });
+
+    testStringsLibError({
+            {"hinted param", "((fn [^long a] a) :a)"},
+            {"hinted let", "(let [^long a nil] a)"},
+            {"hinted recur", "(loop [^long i 0] (if (< i 1) (recur :a) i))"},
+            {"redefined builtin gives a non-num", R"-(
+            (defn f [^long a] (+ (* a 2) 1))
+            (def * (fn [a b] :a))
+            (f 1)
+            )-"},
+            {"metadata without a binding", "(let [^long] 1)"},
+    });
+}
+
 TEST_SUITE_END();
@@ -51,12 +51,15 @@ TEST_CASE("op and")
         // when f returns true, it should be called twice,
         // as and should check both of them, and the whole
         // and expression should return true
-        testExpTrue({"counting exp returning true", form});
-        REQUIRE(num_calls == 2);
+        forEachEngine([&](csxp::Engine engine) {
+            INFO("counting exp returning true");
+            num_calls = 0;
+            REQUIRE(csxp::truthy(runExp(form, engine)));
+            REQUIRE(num_calls == 2);
+        });
 
         // (let [f ([]...)]
         //   (= (and true (f) (f)) false))
-        num_calls = 0;
         form = builder::let(
                 builder::binding("f",
                         [&num_calls](csxp::Env* env, csxp::AtomIterator* args) -> csxp::patom {
@@ -68,8 +71,12 @@ TEST_CASE("op and")
         // when f returns false, it should only be called once,
         // as and should stop checking when it hits a falsy value,
         // and expression should return false
-        testExpTrue({"counting exp returning false", form});
-        REQUIRE(num_calls == 1);
+        forEachEngine([&](csxp::Engine engine) {
+            INFO("counting exp returning false");
+            num_calls = 0;
+            REQUIRE(csxp::truthy(runExp(form, engine)));
+            REQUIRE(num_calls == 1);
+        });
     }
 
     SUBCASE("various args")
@@ -108,12 +115,15 @@ TEST_CASE("op or")
         // when f returns true, it should be called once,
         // as or should stop once it gets a truthy value,
         // and the whole or expression should return true
-        testExpTrue({"counting exp returning true", form});
-        REQUIRE(num_calls == 1);
+        forEachEngine([&](csxp::Engine engine) {
+            INFO("counting exp returning true");
+            num_calls = 0;
+            REQUIRE(csxp::truthy(runExp(form, engine)));
+            REQUIRE(num_calls == 1);
+        });
 
         // (let [f ([]...)]
         //   (= (or false (f) (f)) false))
-        num_calls = 0;
         form = builder::let(
                 builder::binding("f",
                         [&num_calls](csxp::Env* env, csxp::AtomIterator* args) -> csxp::patom {
@@ -125,8 +135,12 @@ TEST_CASE("op or")
         // when f returns false, it should be called twice,
         // as or should keep checking until it hits a truthy value,
         // and the whole or expression should return false
-        testExpTrue({"counting exp returning false", form});
-        REQUIRE(num_calls == 2);
+        forEachEngine([&](csxp::Engine engine) {
+            INFO("counting exp returning false");
+            num_calls = 0;
+            REQUIRE(csxp::truthy(runExp(form, engine)));
+            REQUIRE(num_calls == 2);
+        });
     }
 
     SUBCASE("various args")
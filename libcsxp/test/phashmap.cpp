@@ -0,0 +1,134 @@
+#include "doctest.h"
+#include "csxp/phashmap.h"
+
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+TEST_SUITE_BEGIN("phashmap");
+
+namespace {
+
+// keeps only a few bits, so that many keys collide all the way down
+struct BadHash
+{
+    std::size_t operator()(int key) const { return static_cast<std::size_t>(key) & 0x3f; }
+};
+
+template <typename Map>
+void requireSame(const Map& map, const std::unordered_map<int, int>& expected)
+{
+    REQUIRE(map.size() == expected.size());
+    for (auto& [key, val] : expected) {
+        auto res = map.find(key);
+        REQUIRE(res);
+        REQUIRE(*res == val);
+    }
+
+    // and every entry once, through the iterator
+    std::size_t n = 0;
+    for (auto& [key, val] : map) {
+        auto it = expected.find(key);
+        REQUIRE(it != expected.end());
+        REQUIRE(it->second == val);
+        n++;
+    }
+    REQUIRE(n == expected.size());
+}
+
+template <typename Map>
+void setAndErase()
+{
+    constexpr int n = 5000;
+
+    Map map;
+    std::unordered_map<int, int> expected;
+    std::mt19937 rng(1);
+    for (int i = 0; i < n; i++) {
+        auto key = static_cast<int>(rng() % (n * 2));
+        map.set(key, i);
+        expected[key] = i;
+        if (i < 20) {
+            requireSame(map, expected);
+        }
+    }
+    requireSame(map, expected);
+    REQUIRE(!map.find(n * 2));
+
+    for (int i = 0; i < n * 2; i += 3) {
+        REQUIRE(map.erase(i) == (expected.erase(i) == 1));
+    }
+    requireSame(map, expected);
+
+    for (int i = 0; i < n * 2; i++) {
+        map.erase(i);
+    }
+    REQUIRE(map.empty());
+    REQUIRE(map.begin() == map.end());
+}
+
+} // namespace
+
+TEST_CASE("set and erase")
+{
+    setAndErase<csxp::phashmap<int, int>>();
+}
+
+TEST_CASE("set and erase, colliding")
+{
+    setAndErase<csxp::phashmap<int, int, BadHash>>();
+}
+
+TEST_CASE("copies are unchanged by updates")
+{
+    csxp::phashmap<int, int> map;
+    std::unordered_map<int, int> expected;
+    for (int i = 0; i < 2000; i++) {
+        map.set(i, i);
+        expected[i] = i;
+    }
+
+    auto assoced = map.assoc(1000, -1);
+    auto added = map.assoc(2000, 2000);
+    auto dissoced = map.dissoc(500);
+    requireSame(map, expected);
+
+    REQUIRE(*assoced.find(1000) == -1);
+    REQUIRE(assoced.size() == 2000);
+    REQUIRE(added.size() == 2001);
+    REQUIRE(*added.find(2000) == 2000);
+    REQUIRE(dissoced.size() == 1999);
+    REQUIRE(!dissoced.contains(500));
+
+    // equal whatever order the entries went in
+    csxp::phashmap<int, int> reversed;
+    for (int i = 2000; i-- > 0;) {
+        reversed.set(i, i);
+    }
+    REQUIRE(reversed == map);
+    REQUIRE(!(assoced == map));
+    REQUIRE(dissoced.assoc(500, 500) == map);
+
+    // and small ones the same, as arrays
+    csxp::phashmap<int, int> small{{1, 1}, {2, 2}};
+    REQUIRE(small == (csxp::phashmap<int, int>{{2, 2}, {1, 1}}));
+    REQUIRE(!(small == small.assoc(3, 3)));
+}
+
+TEST_CASE("values are released")
+{
+    auto val = std::make_shared<int>(1);
+    {
+        csxp::phashmap<int, std::shared_ptr<int>> map;
+        for (int i = 0; i < 100; i++) {
+            map.set(i, val);
+        }
+        auto copy = map.assoc(50, nullptr);
+        map.erase(0);
+        REQUIRE(val.use_count() > 100);
+    }
+    REQUIRE(val.use_count() == 1);
+}
+
+TEST_SUITE_END();
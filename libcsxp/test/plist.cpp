@@ -0,0 +1,82 @@
+#include "doctest.h"
+#include "csxp/plist.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+TEST_SUITE_BEGIN("plist");
+
+namespace {
+
+template <typename T>
+void requireSame(const csxp::plist<T>& lst, const std::vector<T>& expected)
+{
+    REQUIRE(lst.size() == expected.size());
+
+    std::size_t i = 0;
+    for (auto& val : lst) {
+        REQUIRE(val == expected[i++]);
+    }
+    REQUIRE(i == expected.size());
+}
+
+} // namespace
+
+TEST_CASE("cons and rest share cells")
+{
+    csxp::plist<int> lst{2, 3, 4};
+    auto consed = lst.cons(1);
+    auto rest = consed.rest();
+
+    requireSame(lst, {2, 3, 4});
+    requireSame(consed, {1, 2, 3, 4});
+    requireSame(rest, {2, 3, 4});
+
+    // the same cells, not copies of them
+    REQUIRE(&rest.front() == &lst.front());
+    REQUIRE(&consed[1] == &lst.front());
+
+    REQUIRE(consed.drop(4).empty());
+    REQUIRE(consed.drop(10).empty());
+    requireSame(consed.drop(2), {3, 4});
+}
+
+TEST_CASE("push and pop in place")
+{
+    csxp::plist<int> lst;
+    for (int i = 0; i < 5; i++) {
+        lst.push_front(i);
+    }
+    auto copy = lst;
+
+    lst.pop_front();
+    lst.pop_front();
+    requireSame(lst, {2, 1, 0});
+    requireSame(copy, {4, 3, 2, 1, 0});
+
+    REQUIRE(lst == copy.drop(2));
+    REQUIRE(lst != copy);
+    REQUIRE(lst == csxp::plist<int>{2, 1, 0});
+}
+
+TEST_CASE("long lists are released")
+{
+    auto item = std::make_shared<int>(1);
+    {
+        // long enough that releasing cell by cell, recursively, would
+        // run out of stack
+        csxp::plist<std::shared_ptr<int>> lst;
+        for (int i = 0; i < 1000000; i++) {
+            lst.push_front(item);
+        }
+        auto rest = lst.drop(10);
+        REQUIRE(item.use_count() == 1 + 1000000);
+
+        lst.clear();
+        REQUIRE(item.use_count() == 1 + 1000000 - 10);
+    }
+    REQUIRE(item.use_count() == 1);
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,111 @@
+#include "doctest.h"
+#include "csxp/pvector.h"
+
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <vector>
+
+TEST_SUITE_BEGIN("pvector");
+
+namespace {
+
+template <typename T>
+void requireSame(const csxp::pvector<T>& vec, const std::vector<T>& expected)
+{
+    REQUIRE(vec.size() == expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        REQUIRE(vec[i] == expected[i]);
+    }
+
+    // through the iterator, a leaf at a time
+    std::size_t i = 0;
+    for (auto& val : vec) {
+        REQUIRE(val == expected[i++]);
+    }
+    REQUIRE(i == expected.size());
+}
+
+} // namespace
+
+TEST_CASE("push, set and pop across levels")
+{
+    // past a root of leaves (1056), and of branches (33824)
+    constexpr std::size_t n = 40000;
+
+    csxp::pvector<int> vec;
+    std::vector<int> expected;
+    for (std::size_t i = 0; i < n; i++) {
+        vec.push_back(static_cast<int>(i));
+        expected.push_back(static_cast<int>(i));
+    }
+    requireSame(vec, expected);
+
+    std::mt19937 rng(1);
+    for (int i = 0; i < 1000; i++) {
+        auto idx = rng() % n;
+        vec.set(idx, -i);
+        expected[idx] = -i;
+    }
+    requireSame(vec, expected);
+
+    while (vec.size() > 20) {
+        vec.pop_back();
+        expected.pop_back();
+        if (vec.size() % 997 == 0) {
+            requireSame(vec, expected);
+        }
+    }
+    requireSame(vec, expected);
+}
+
+TEST_CASE("copies are unchanged by updates")
+{
+    csxp::pvector<int> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < 2000; i++) {
+        vec.push_back(i);
+        expected.push_back(i);
+    }
+
+    auto conjed = vec.conj(2000);
+    auto assoced = vec.assoc(1000, -1);
+    auto popped = vec.pop();
+    requireSame(vec, expected);
+
+    REQUIRE(conjed.size() == 2001);
+    REQUIRE(conjed.back() == 2000);
+    REQUIRE(assoced[1000] == -1);
+    REQUIRE(assoced[999] == 999);
+    REQUIRE(popped.size() == 1999);
+    REQUIRE(popped.back() == 1998);
+
+    // an update of a copy leaves the original as it was
+    auto copy = vec;
+    for (int i = 0; i < 2000; i += 7) {
+        copy.set(i, 0);
+    }
+    while (!copy.empty()) {
+        copy.pop_back();
+    }
+    requireSame(vec, expected);
+}
+
+TEST_CASE("items are released")
+{
+    auto item = std::make_shared<int>(1);
+    {
+        csxp::pvector<std::shared_ptr<int>> vec;
+        for (int i = 0; i < 100; i++) {
+            vec.push_back(item);
+        }
+        auto copy = vec.assoc(50, nullptr);
+        vec.pop_back();
+        // leaves 0 and 2 and the old tail are shared, only leaf 1 and
+        // vec's new tail were copied
+        REQUIRE(item.use_count() == 1 + 32 + 32 + 4 + (32 + 31) + 3);
+    }
+    REQUIRE(item.use_count() == 1);
+}
+
+TEST_SUITE_END();
@@ -7,8 +7,6 @@
 
 #include <string_view>
 
-// todo: map parsing tests
-
 extern const std::string_view arbitrary_clj;
 extern const std::string_view arbitrary_long_clj;
 
@@ -80,7 +78,7 @@ TEST_CASE("can read list")
     auto s = csxp::get<csxp::Seq>(val);
     REQUIRE(s);
 
-    auto lst = std::dynamic_pointer_cast<csxp::List>(s);
+    auto lst = csxp::dynamic_ref_cast<csxp::List>(s);
     REQUIRE(lst);
     REQUIRE(lst->items.size() == 1);
 
@@ -99,7 +97,7 @@ TEST_CASE("can read vec")
     auto s = csxp::get<csxp::Seq>(val);
     REQUIRE(s);
 
-    auto vec = std::dynamic_pointer_cast<csxp::Vec>(s);
+    auto vec = csxp::dynamic_ref_cast<csxp::Vec>(s);
     REQUIRE(vec);
     REQUIRE(vec->items.size() == 1);
 
@@ -108,6 +106,30 @@ TEST_CASE("can read vec")
     REQUIRE(k->name == ":abc"sv);
 }
 
+TEST_CASE("can read map")
+{
+    auto str = "{:abc 1, :def [2]}"sv;
+    auto val = testReadToAtom(str);
+
+    auto map = csxp::get<csxp::Map>(val);
+    REQUIRE(map);
+    REQUIRE(map->items.size() == 2);
+
+    for (auto& [k, v] : map->items) {
+        auto kw = csxp::get<csxp::Keyword>(k);
+        REQUIRE(kw);
+        if (kw->name == ":abc"sv) {
+            REQUIRE(csxp::get<csxp::Num>(v));
+        } else {
+            REQUIRE(kw->name == ":def"sv);
+            REQUIRE(csxp::get<csxp::Vec>(v));
+        }
+    }
+
+    REQUIRE_THROWS_AS(testReadToAtom("{:a 1 :b}"sv), csxp::ReaderError);
+    REQUIRE_THROWS_AS(testReadToAtom("{:a 1 :a 2}"sv), csxp::ReaderError);
+}
+
 TEST_CASE("can read quote")
 {
     SUBCASE("single quoted sym")
@@ -122,7 +144,7 @@ TEST_CASE("can read quote")
         auto s = csxp::get<csxp::Seq>(val);
         REQUIRE(s);
 
-        auto lst = std::dynamic_pointer_cast<csxp::List>(s);
+        auto lst = csxp::dynamic_ref_cast<csxp::List>(s);
         REQUIRE(lst);
         REQUIRE(lst->items.size() == 2);
 
@@ -149,7 +171,7 @@ TEST_CASE("can read quote")
         auto s = csxp::get<csxp::Seq>(val);
         REQUIRE(s);
 
-        auto vec = std::dynamic_pointer_cast<csxp::Vec>(s);
+        auto vec = csxp::dynamic_ref_cast<csxp::Vec>(s);
         REQUIRE(vec);
         REQUIRE(vec->items.size() == 2);
 
@@ -158,7 +180,7 @@ TEST_CASE("can read quote")
         auto q = csxp::get<csxp::Seq>(vec->items[0]);
         REQUIRE(q);
 
-        auto qlst = std::dynamic_pointer_cast<csxp::List>(q);
+        auto qlst = csxp::dynamic_ref_cast<csxp::List>(q);
         REQUIRE(qlst);
         REQUIRE(qlst->items.size() == 2);
 
@@ -175,7 +197,7 @@ TEST_CASE("can read quote")
         q = csxp::get<csxp::Seq>(vec->items[1]);
         REQUIRE(q);
 
-        qlst = std::dynamic_pointer_cast<csxp::List>(q);
+        qlst = csxp::dynamic_ref_cast<csxp::List>(q);
         REQUIRE(qlst);
         REQUIRE(qlst->items.size() == 2);
 
@@ -251,6 +273,23 @@ TEST_CASE("can read quote")
     }
 }
 
+TEST_CASE("can read syntax quote")
+{
+    // prefixes read as forms wrapping the next item
+    REQUIRE(testReadToAtom("`(a ~b ~@c)"sv) ==
+            testReadToAtom("(syntax-quote (a (unquote b) (unquote-splicing c)))"sv));
+    REQUIRE(testReadToAtom("`[~'a]"sv) ==
+            testReadToAtom("(syntax-quote [(unquote (quote a))])"sv));
+    REQUIRE(testReadToAtom("''a"sv) == testReadToAtom("(quote (quote a))"sv));
+
+    // symbols end at a tilde
+    auto vals = testReadToAtoms("(a~b)"sv);
+    REQUIRE(vals.size() == 1);
+    REQUIRE(vals[0] == testReadToAtom("(a (unquote b))"sv));
+
+    REQUIRE(testReadToAtoms(arbitrary_clj).size() > 0);
+}
+
 TEST_CASE("can read chars")
 {
     auto str = R"-(
@@ -4,20 +4,29 @@
 #include "csxp/reader.h"
 #include "run-helpers.h"
 
-csxp::patom runExp(csxp::patom exp)
+void forEachEngine(const std::function<void(csxp::Engine)>& fn)
+{
+    // the tree evaluator is the reference the vm is checked against
+    for (auto engine : {csxp::Engine::tree, csxp::Engine::vm}) {
+        INFO((engine == csxp::Engine::vm ? "vm" : "tree"));
+        fn(engine);
+    }
+}
+
+csxp::patom runExp(csxp::patom exp, csxp::Engine engine)
 {
     // set up basic env
-    auto env = csxp::createEnv();
+    auto env = csxp::createEnv(engine);
     csxp::lib::addCore(env.get());
     csxp::lib::addMath(env.get());
 
     return env->eval(exp);
 }
 
-csxp::patom runString(std::string_view str)
+csxp::patom runString(std::string_view str, csxp::Engine engine)
 {
     // set up basic env
-    auto env = csxp::createEnv();
+    auto env = csxp::createEnv(engine);
     csxp::lib::addCore(env.get());
     csxp::lib::addMath(env.get());
 
@@ -42,16 +51,22 @@ csxp::patom parseString(std::string_view str)
 csxp::patom testExpTrue(const cloexptest& test)
 {
     INFO(test.name);
-    auto res = runExp(test.exp);
-    REQUIRE(csxp::truthy(res));
+    csxp::patom res;
+    forEachEngine([&](csxp::Engine engine) {
+        res = runExp(test.exp, engine);
+        REQUIRE(csxp::truthy(res));
+    });
     return res;
 }
 
 csxp::patom testStringTrue(const clostringtest& test)
 {
     INFO(test.name);
-    auto res = runString(test.code);
-    REQUIRE(csxp::truthy(res));
+    csxp::patom res;
+    forEachEngine([&](csxp::Engine engine) {
+        res = runString(test.code, engine);
+        REQUIRE(csxp::truthy(res));
+    });
     return res;
 }
 
@@ -67,7 +82,9 @@ csxp::patom testStringsTrue(const std::vector<clostringtest>& tests)
 void testStringLibError(const clostringtest& test)
 {
     INFO(test.name);
-    CHECK_THROWS_AS(runString(test.code), csxp::lib::LibError);
+    forEachEngine([&](csxp::Engine engine) {
+        CHECK_THROWS_AS(runString(test.code, engine), csxp::lib::LibError);
+    });
 }
 
 void testStringsLibError(const std::vector<clostringtest>& tests)
@@ -2,12 +2,21 @@
 #define CSXP_RUN_HELPERS_H
 
 #include "csxp/atom.h"
+#include "csxp/env.h"
 
-csxp::patom runExp(csxp::patom exp);
+#include <functional>
+
+// runs fn once for each engine
+void forEachEngine(const std::function<void(csxp::Engine)>& fn);
+
+csxp::patom runExp(csxp::patom exp,
+        csxp::Engine engine = csxp::Engine::tree);
 
 csxp::patom parseString(std::string_view str);
-csxp::patom runString(std::string_view str);
+csxp::patom runString(std::string_view str,
+        csxp::Engine engine = csxp::Engine::tree);
 
+// these run on both engines, so the vm is checked against the tree
 struct cloexptest
 {
     std::string name;